@@ -0,0 +1,155 @@
+// Cache-affinity routing of connections between workers via SCM_RIGHTS
+
+#define _GNU_SOURCE
+#include "affinity.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// ============================================================================
+// Initialize Router (master)
+// ============================================================================
+int affinity_init(affinity_router_t* router, int num_workers) {
+    router->num_workers = num_workers;
+    router->recv_fds = malloc(sizeof(int) * num_workers);
+    router->send_fds = malloc(sizeof(int) * num_workers);
+    if (!router->recv_fds || !router->send_fds) {
+        free(router->recv_fds);
+        free(router->send_fds);
+        return -1;
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        int sv[2];
+        // Datagrams keep one socket per message even with many senders
+        if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sv) < 0) {
+            log_message("Affinity: socketpair failed: %s", strerror(errno));
+            router->num_workers = i;
+            affinity_destroy(router);
+            return -1;
+        }
+        router->recv_fds[i] = sv[0];
+        router->send_fds[i] = sv[1];
+    }
+
+    log_message("Affinity: cache-affinity routing enabled across %d workers", num_workers);
+    return 0;
+}
+
+// ============================================================================
+// Setup Worker Ends (worker, after fork)
+// ============================================================================
+int affinity_setup_worker(affinity_router_t* router, int worker_id) {
+    for (int i = 0; i < router->num_workers; i++) {
+        if (i == worker_id) continue;
+        close(router->recv_fds[i]);
+        router->recv_fds[i] = -1;
+    }
+    return router->recv_fds[worker_id];
+}
+
+// ============================================================================
+// Path Ownership (FNV-1a hash)
+// ============================================================================
+int affinity_owner(const affinity_router_t* router, const char* path) {
+    // Hash the same key the cache sees: no query string, "/" is index.html
+    size_t len = strcspn(path, "?");
+    if (len == 1 && path[0] == '/') {
+        path = "/index.html";
+        len = strlen(path);
+    }
+
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 16777619u;
+    }
+    return (int)(hash % (uint32_t)router->num_workers);
+}
+
+// ============================================================================
+// Send Socket to Owner
+// ============================================================================
+int affinity_send(const affinity_router_t* router, int target, int client_fd) {
+    if (target < 0 || target >= router->num_workers) {
+        return -1;
+    }
+
+    char marker = 'C';
+    struct iovec iov = { .iov_base = &marker, .iov_len = 1 };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &client_fd, sizeof(int));
+
+    // Never block the acceptor: if the owner is backed up, serve locally
+    if (sendmsg(router->send_fds[target], &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// Receive Socket from Peer
+// ============================================================================
+int affinity_recv(int recv_fd) {
+    char marker;
+    struct iovec iov = { .iov_base = &marker, .iov_len = 1 };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if (recvmsg(recv_fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC) <= 0) {
+        return -1;
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+
+    int client_fd;
+    memcpy(&client_fd, CMSG_DATA(cmsg), sizeof(int));
+    return client_fd;
+}
+
+// ============================================================================
+// Destroy Router
+// ============================================================================
+void affinity_destroy(affinity_router_t* router) {
+    for (int i = 0; i < router->num_workers; i++) {
+        if (router->recv_fds[i] >= 0) close(router->recv_fds[i]);
+        if (router->send_fds[i] >= 0) close(router->send_fds[i]);
+    }
+    free(router->recv_fds);
+    free(router->send_fds);
+    router->recv_fds = NULL;
+    router->send_fds = NULL;
+    router->num_workers = 0;
+}
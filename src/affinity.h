@@ -0,0 +1,56 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+// ============================================================================
+// Cache-Affinity Router
+// ============================================================================
+// Each request path hashes to one owner worker. When enabled, the acceptor
+// that picked up a connection passes the socket (SCM_RIGHTS) to the owner, so
+// every file lives in exactly one worker's cache and the aggregate cache
+// capacity becomes NUM_WORKERS x CACHE_SIZE_MB of distinct files.
+
+typedef struct {
+    int num_workers;
+    int* recv_fds;      // recv_fds[i]: worker i receives handed-off sockets here
+    int* send_fds;      // send_fds[i]: other workers send to worker i here
+} affinity_router_t;
+
+// ============================================================================
+// Affinity Router Functions
+// ============================================================================
+
+/**
+ * Create one datagram socketpair per worker (call in master, before fork)
+ * Returns: 0 on success, -1 on error
+ */
+int affinity_init(affinity_router_t* router, int num_workers);
+
+/**
+ * Keep only the ends a worker needs (call in the worker, after fork)
+ * Returns: the worker's receive fd
+ */
+int affinity_setup_worker(affinity_router_t* router, int worker_id);
+
+/**
+ * Map a request path to the worker that owns its cache bucket
+ */
+int affinity_owner(const affinity_router_t* router, const char* path);
+
+/**
+ * Pass client_fd to the target worker without blocking
+ * Returns: 0 on success (caller closes its copy), -1 if it must be served locally
+ */
+int affinity_send(const affinity_router_t* router, int target, int client_fd);
+
+/**
+ * Receive a handed-off socket
+ * Returns: client fd, or -1 if nothing was received
+ */
+int affinity_recv(int recv_fd);
+
+/**
+ * Close all router sockets and free resources
+ */
+void affinity_destroy(affinity_router_t* router);
+
+#endif // AFFINITY_H
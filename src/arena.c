@@ -0,0 +1,107 @@
+// Bump arena allocator for the request path
+
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static arena_chunk_t* chunk_new(size_t size) {
+    arena_chunk_t* chunk = malloc(sizeof(arena_chunk_t) + size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+
+int arena_init(arena_t* arena, size_t chunk_size) {
+    if (!arena || chunk_size == 0) {
+        return -1;
+    }
+
+    arena->chunk_size = align_up(chunk_size);
+    arena->head = chunk_new(arena->chunk_size);
+    if (!arena->head) {
+        return -1;
+    }
+    arena->current = arena->head;
+    arena->used = 0;
+    arena->high_water = 0;
+    arena->reserved = arena->chunk_size;
+    return 0;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = align_up(size ? size : 1);
+
+    // Bump in the current chunk, then in chunks kept from earlier requests
+    arena_chunk_t* chunk = arena->current;
+    while (chunk && chunk->size - chunk->used < size) {
+        chunk = chunk->next;
+    }
+
+    if (!chunk) {
+        // Grow: oversized requests (e.g. a file read on cache miss) get a
+        // dedicated chunk that is reused by later requests of the same size
+        size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+        chunk = chunk_new(chunk_size);
+        if (!chunk) {
+            return NULL;
+        }
+        arena_chunk_t* last = arena->current;
+        while (last->next) last = last->next;
+        last->next = chunk;
+        arena->reserved += chunk_size;
+    }
+
+    arena->current = chunk;
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    if (arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+    }
+    return ptr;
+}
+
+char* arena_strndup(arena_t* arena, const char* str, size_t len) {
+    char* copy = arena_alloc(arena, len + 1);
+    if (copy) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+void arena_reset(arena_t* arena) {
+    for (arena_chunk_t* chunk = arena->head; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    arena->current = arena->head;
+    arena->used = 0;
+}
+
+void arena_destroy(arena_t* arena) {
+    arena_chunk_t* chunk = arena->head;
+    while (chunk) {
+        arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->reserved = 0;
+}
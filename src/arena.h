@@ -0,0 +1,62 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// ============================================================================
+// Per-Thread Request Arena
+// ============================================================================
+// Bump allocator owned by one pool thread and reset after every request.
+// Chunks are kept across resets, so once a thread has seen its largest
+// request the steady-state request path does no malloc/free at all.
+
+#define ARENA_ALIGN 16
+
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    size_t size;                    // Usable bytes in data[]
+    size_t used;
+    _Alignas(ARENA_ALIGN) char data[];  // malloc'd chunks are at least this aligned
+} arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t* head;            // First chunk (reset rewinds here)
+    arena_chunk_t* current;         // Chunk currently being bumped
+    size_t chunk_size;              // Default size for new chunks
+    size_t used;                    // Bytes handed out since the last reset
+    size_t high_water;              // Largest `used` seen across requests
+    size_t reserved;                // Total bytes held by all chunks
+} arena_t;
+
+// ============================================================================
+// Arena Functions
+// ============================================================================
+
+/**
+ * Initialize an arena with one chunk of chunk_size bytes
+ * Returns: 0 on success, -1 on error
+ */
+int arena_init(arena_t* arena, size_t chunk_size);
+
+/**
+ * Allocate size bytes (ARENA_ALIGN aligned), valid until the next reset
+ * Returns: pointer, or NULL if a new chunk could not be allocated
+ */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/**
+ * Copy a string into the arena
+ */
+char* arena_strndup(arena_t* arena, const char* str, size_t len);
+
+/**
+ * Release everything allocated since the last reset (chunks are kept)
+ */
+void arena_reset(arena_t* arena);
+
+/**
+ * Free all chunks
+ */
+void arena_destroy(arena_t* arena);
+
+#endif // ARENA_H
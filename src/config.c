@@ -2,10 +2,80 @@
 // base code from templates provided by university
 
 #include "config.h"
+#include "logger.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+static const char* queue_class_names[NUM_QUEUE_CLASSES] = {
+    "control", "interactive", "bulk"
+};
+
+// ============================================================================
+// Queue Class Helpers
+// ============================================================================
+const char* queue_class_name(int class_id) {
+    if (class_id < 0 || class_id >= NUM_QUEUE_CLASSES) return "unknown";
+    return queue_class_names[class_id];
+}
+
+static int parse_queue_class(const char* name) {
+    for (int i = 0; i < NUM_QUEUE_CLASSES; i++) {
+        if (strcmp(name, queue_class_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static void add_queue_rule(server_config_t* config, const char* prefix, int class_id) {
+    if (config->queue_rule_count >= MAX_QUEUE_RULES) {
+        fprintf(stderr, "Too many QUEUE_RULE entries (max %d), ignoring '%s'\n",
+                MAX_QUEUE_RULES, prefix);
+        return;
+    }
+    queue_rule_t* rule = &config->queue_rules[config->queue_rule_count++];
+    snprintf(rule->prefix, sizeof(rule->prefix), "%s", prefix);
+    rule->class_id = class_id;
+}
+
+// QUEUE_RULE=<path-prefix>:<class>
+static void parse_queue_rule(server_config_t* config, const char* value) {
+    const char* sep = strrchr(value, ':');
+    if (!sep || sep == value) {
+        fprintf(stderr, "Invalid QUEUE_RULE '%s' (expected /prefix:class)\n", value);
+        return;
+    }
+
+    char prefix[QUEUE_RULE_PREFIX_LEN];
+    size_t len = sep - value;
+    if (len >= sizeof(prefix)) len = sizeof(prefix) - 1;
+    memcpy(prefix, value, len);
+    prefix[len] = '\0';
+
+    int class_id = parse_queue_class(sep + 1);
+    if (class_id < 0) {
+        fprintf(stderr, "Unknown queue class in QUEUE_RULE '%s'\n", value);
+        return;
+    }
+    add_queue_rule(config, prefix, class_id);
+}
+
+// QUEUE_<CLASS>=<capacity>,<weight>,<reject|drop-oldest>
+static void parse_queue_class_config(queue_class_config_t* cls, const char* value) {
+    int capacity, weight;
+    char shed[32] = "";
+    int n = sscanf(value, "%d,%d,%31s", &capacity, &weight, shed);
+    if (n < 2) {
+        fprintf(stderr, "Invalid queue class setting '%s' (expected capacity,weight[,shed])\n", value);
+        return;
+    }
+    cls->capacity = capacity;
+    cls->weight = weight > 0 ? weight : 1;
+    if (n == 3) {
+        if (strcmp(shed, "drop-oldest") == 0) cls->shed_policy = SHED_DROP_OLDEST;
+        else cls->shed_policy = SHED_REJECT;
+    }
+}
+
 // ============================================================================
 // Configuration Loader
 // ============================================================================
@@ -15,12 +85,43 @@ int load_config(const char* filename, server_config_t* config) {
     strncpy(config->document_root, "/var/www/html", sizeof(config->document_root));
     config->num_workers = 4;
     config->timeout_seconds = 30;
+    config->header_timeout_seconds = 10;
+    config->write_timeout_seconds = -1;     // defaults to TIMEOUT_SECONDS
+    config->keepalive_timeout_seconds = 5;
+    config->drain_timeout_seconds = 30;
+    config->write_offload = 1;
+    config->disk_io_threads = 2;
+    config->coroutines = 1;
+    config->co_stack_kb = 64;
     config->cache_size_mb = 10;
     config->threads_per_worker = 10;
+    config->arena_size_kb = 64;
+    config->cache_affinity = 0;
+    config->stats_shm_name[0] = '\0';
+    config->slow_request_ms = 100;
+    config->perf_counters = 0;
+    config->log_overflow = LOG_OVERFLOW_DROP;
+    config->log_max_size_mb = 10;
+    config->log_rotate_seconds = 0;
+    config->log_compress = 0;
+
+    config->execution_mode = EXEC_MODE_PREFORK;
+    config->queue_scheduling = QUEUE_SCHED_WEIGHTED;
+    config->queue_default_class = QUEUE_CLASS_INTERACTIVE;
+    config->queue_classes[QUEUE_CLASS_CONTROL] = (queue_class_config_t){ 16, 8, SHED_REJECT };
+    config->queue_classes[QUEUE_CLASS_INTERACTIVE] = (queue_class_config_t){ 100, 4, SHED_REJECT };
+    config->queue_classes[QUEUE_CLASS_BULK] = (queue_class_config_t){ 50, 1, SHED_DROP_OLDEST };
+    config->queue_rule_count = 0;
+    config->queue_spin_us = 50;
+    add_queue_rule(config, "/health", QUEUE_CLASS_CONTROL);
+    add_queue_rule(config, "/metrics", QUEUE_CLASS_CONTROL);
+    add_queue_rule(config, "/stats", QUEUE_CLASS_CONTROL);
+    add_queue_rule(config, "/debug", QUEUE_CLASS_CONTROL);
 
     FILE* fp = fopen(filename, "r");
     if (!fp) {
         fprintf(stderr, "Could not open config '%s', using defaults\n", filename);
+        config->write_timeout_seconds = config->timeout_seconds;
         return -1;
     }
 
@@ -50,12 +151,55 @@ int load_config(const char* filename, server_config_t* config) {
             if (strcmp(k, "PORT") == 0) config->port = atoi(v);
             else if (strcmp(k, "NUM_WORKERS") == 0) config->num_workers = atoi(v);
             else if (strcmp(k, "TIMEOUT_SECONDS") == 0) config->timeout_seconds = atoi(v);
+            else if (strcmp(k, "HEADER_TIMEOUT_SECONDS") == 0) config->header_timeout_seconds = atoi(v);
+            else if (strcmp(k, "WRITE_TIMEOUT_SECONDS") == 0) config->write_timeout_seconds = atoi(v);
+            else if (strcmp(k, "KEEPALIVE_TIMEOUT_SECONDS") == 0) config->keepalive_timeout_seconds = atoi(v);
+            else if (strcmp(k, "DRAIN_TIMEOUT_SECONDS") == 0) config->drain_timeout_seconds = atoi(v);
+            else if (strcmp(k, "WRITE_OFFLOAD") == 0) config->write_offload = atoi(v);
+            else if (strcmp(k, "DISK_IO_THREADS") == 0) config->disk_io_threads = atoi(v);
+            else if (strcmp(k, "COROUTINES") == 0) config->coroutines = atoi(v);
+            else if (strcmp(k, "CO_STACK_KB") == 0) config->co_stack_kb = atoi(v);
             else if (strcmp(k, "CACHE_SIZE_MB") == 0) config->cache_size_mb = atoi(v);
             else if (strcmp(k, "THREADS_PER_WORKER") == 0) config->threads_per_worker = atoi(v);
+            else if (strcmp(k, "ARENA_SIZE_KB") == 0) config->arena_size_kb = atoi(v);
+            else if (strcmp(k, "CACHE_AFFINITY") == 0) config->cache_affinity = atoi(v);
+            else if (strcmp(k, "SLOW_REQUEST_MS") == 0) config->slow_request_ms = atoi(v);
+            else if (strcmp(k, "PERF_COUNTERS") == 0) config->perf_counters = atoi(v);
+            else if (strcmp(k, "LOG_OVERFLOW") == 0)
+                config->log_overflow = (strcmp(v, "block") == 0) ? LOG_OVERFLOW_BLOCK : LOG_OVERFLOW_DROP;
+            else if (strcmp(k, "LOG_MAX_SIZE_MB") == 0) config->log_max_size_mb = atoi(v);
+            else if (strcmp(k, "LOG_ROTATE_SECONDS") == 0) config->log_rotate_seconds = atoi(v);
+            else if (strcmp(k, "LOG_COMPRESS") == 0) config->log_compress = atoi(v);
+            else if (strcmp(k, "STATS_SHM_NAME") == 0)
+                snprintf(config->stats_shm_name, sizeof(config->stats_shm_name), "%s", v);
             else if (strcmp(k, "DOCUMENT_ROOT") == 0) 
                 strncpy(config->document_root, v, sizeof(config->document_root) - 1);
+            else if (strcmp(k, "EXECUTION_MODE") == 0)
+                config->execution_mode = (strcmp(v, "per-core") == 0) ? EXEC_MODE_PER_CORE : EXEC_MODE_PREFORK;
+            else if (strcmp(k, "QUEUE_SCHEDULING") == 0)
+                config->queue_scheduling = (strcmp(v, "strict") == 0) ? QUEUE_SCHED_STRICT : QUEUE_SCHED_WEIGHTED;
+            else if (strcmp(k, "QUEUE_DEFAULT_CLASS") == 0) {
+                int class_id = parse_queue_class(v);
+                if (class_id >= 0) config->queue_default_class = class_id;
+            }
+            else if (strcmp(k, "QUEUE_CONTROL") == 0)
+                parse_queue_class_config(&config->queue_classes[QUEUE_CLASS_CONTROL], v);
+            else if (strcmp(k, "QUEUE_INTERACTIVE") == 0)
+                parse_queue_class_config(&config->queue_classes[QUEUE_CLASS_INTERACTIVE], v);
+            else if (strcmp(k, "QUEUE_BULK") == 0)
+                parse_queue_class_config(&config->queue_classes[QUEUE_CLASS_BULK], v);
+            else if (strcmp(k, "QUEUE_RULE") == 0) parse_queue_rule(config, v);
+            else if (strcmp(k, "QUEUE_SPIN_US") == 0) config->queue_spin_us = atoi(v);
         }
     }
     fclose(fp);
+
+    // Documented range; also keeps queue_spin_us * 1000 within an int
+    if (config->queue_spin_us < 0) config->queue_spin_us = 0;
+    if (config->queue_spin_us > 1000) config->queue_spin_us = 1000;
+
+    if (config->write_timeout_seconds < 0) {
+        config->write_timeout_seconds = config->timeout_seconds;
+    }
     return 0;
 }
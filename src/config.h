@@ -1,21 +1,83 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+// ============================================================================
+// Queue Class Configuration
+// ============================================================================
+#define NUM_QUEUE_CLASSES 3
+#define MAX_QUEUE_RULES 16
+#define QUEUE_RULE_PREFIX_LEN 128
+
+// Traffic classes, lower index = higher priority
+#define QUEUE_CLASS_CONTROL 0       // /health, /metrics, /stats
+#define QUEUE_CLASS_INTERACTIVE 1   // pages, API calls (default)
+#define QUEUE_CLASS_BULK 2          // large downloads
+
+// Dequeue scheduling between classes
+#define QUEUE_SCHED_WEIGHTED 0      // weighted round-robin by class weight
+#define QUEUE_SCHED_STRICT 1        // always serve the highest class first
+
+// What to do when a class queue is full
+#define SHED_REJECT 0               // 503 the new connection
+#define SHED_DROP_OLDEST 1          // 503 the oldest queued connection, admit the new one
+
+typedef struct {
+    int capacity;
+    int weight;
+    int shed_policy;
+} queue_class_config_t;
+
+typedef struct {
+    char prefix[QUEUE_RULE_PREFIX_LEN];
+    int class_id;
+} queue_rule_t;
+
+// Process/thread architecture
+#define EXEC_MODE_PREFORK 0         // master + prefork workers + thread pool per worker
+#define EXEC_MODE_PER_CORE 1        // one single-threaded, CPU-pinned worker per core
+
 // ============================================================================
 // Configuration Structure
 // ============================================================================
 typedef struct {
     int port;
     char document_root[256];
+    int execution_mode;
     int num_workers;
     int timeout_seconds;
+    int header_timeout_seconds;     // Deadline for a client to send its request headers
+    int write_timeout_seconds;      // Deadline for sending one response
+    int keepalive_timeout_seconds;  // Idle time allowed between requests (0 = no keep-alive)
+    int drain_timeout_seconds;      // Graceful shutdown deadline before forcing exit
+    int write_offload;              // Finish slow-client responses on a per-worker writer thread
+    int disk_io_threads;            // Per-worker threads loading cache misses (0 = read inline)
+    int coroutines;                 // per-core: run each request as a coroutine on the loop
+    int co_stack_kb;                // Stack size of each request coroutine
     int cache_size_mb;
     int threads_per_worker;
+    int arena_size_kb;              // Per-thread request arena chunk size
+    int cache_affinity;             // Route each path to the worker owning its cache bucket
+    char stats_shm_name[64];        // Named shm segment for the stats block ("" = anonymous)
+    int slow_request_ms;            // Flight recorder threshold (0 = record only 5xx)
+    int perf_counters;              // Per-thread perf_event counters per request class
+    int log_overflow;               // LOG_OVERFLOW_* (logger.h): full log buffer policy
+    int log_max_size_mb;            // Rotate server.log past this size (0 = never by size)
+    int log_rotate_seconds;         // Rotate server.log this often (0 = never by time)
+    int log_compress;               // gzip rotated logs in the background
+
+    // Connection queue classes
+    int queue_scheduling;
+    int queue_default_class;
+    queue_class_config_t queue_classes[NUM_QUEUE_CLASSES];
+    queue_rule_t queue_rules[MAX_QUEUE_RULES];
+    int queue_rule_count;
+    int queue_spin_us;              // Max consumer spin before parking (0 = park immediately)
 } server_config_t;
 
 // ============================================================================
 // Configuration Functions
 // ============================================================================
 int load_config(const char* filename, server_config_t* config);
+const char* queue_class_name(int class_id);
 
 #endif // CONFIG_H
@@ -1,121 +1,338 @@
-// producer-Consumer connection queue with semaphores
+// producer-Consumer connection queue with semaphores and traffic classes
 
 #include "connection_queue.h"
+#include "lock_stats.h"
 #include "logger.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <time.h>
+
+#define SPIN_CLOCK_CHECK 64     // pause iterations between clock reads
+#define GAP_EWMA_SHIFT 3        // avg += (sample - avg) / 8
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static int wakeup_bucket(long long latency_ns) {
+    long long us = latency_ns / 1000;
+    int bucket = 0;
+    while (us > 0 && bucket < WAKEUP_HIST_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * Track the arrival rate and derive the consumer spin budget: spinning only
+ * pays off when the next connection is expected within max_spin_ns.
+ * Caller holds queue->mutex.
+ */
+static void note_arrival(connection_queue_t* queue, long long now) {
+    if (queue->max_spin_ns <= 0) {
+        return;
+    }
+
+    if (queue->last_arrival_ns > 0) {
+        long long gap = now - queue->last_arrival_ns;
+        queue->avg_gap_ns += (gap - queue->avg_gap_ns) >> GAP_EWMA_SHIFT;
+    }
+    queue->last_arrival_ns = now;
+
+    int spin = 0;
+    if (queue->avg_gap_ns <= queue->max_spin_ns) {
+        long long budget = queue->avg_gap_ns * 2;
+        spin = budget > queue->max_spin_ns ? queue->max_spin_ns : (int)budget;
+    }
+    __atomic_store_n(&queue->spin_ns, spin, __ATOMIC_RELAXED);
+}
+
+/**
+ * Spin on filled_slots for up to the current budget before parking
+ * Returns: 1 if a slot was acquired while spinning, 0 otherwise
+ */
+static int spin_for_slot(connection_queue_t* queue) {
+    int budget = __atomic_load_n(&queue->spin_ns, __ATOMIC_RELAXED);
+    if (budget <= 0) {
+        return 0;
+    }
+
+    long long deadline = monotonic_ns() + budget;
+    for (;;) {
+        for (int i = 0; i < SPIN_CLOCK_CHECK; i++) {
+            if (sem_trywait(&queue->filled_slots) == 0) {
+                return 1;
+            }
+            cpu_relax();
+        }
+        if (monotonic_ns() >= deadline) {
+            return 0;
+        }
+    }
+}
+
+// Caller holds queue->mutex for the functions below
+
+static void class_push(connection_class_queue_t* cls, int client_fd, long long now) {
+    cls->enqueue_ns[cls->tail] = now;
+    cls->connections[cls->tail] = client_fd;
+    cls->tail = (cls->tail + 1) % cls->capacity;
+    cls->count++;
+}
+
+static int class_pop(connection_class_queue_t* cls, long long* enqueued_ns) {
+    int client_fd = cls->connections[cls->head];
+    if (enqueued_ns) *enqueued_ns = cls->enqueue_ns[cls->head];
+    cls->connections[cls->head] = -1;
+    cls->head = (cls->head + 1) % cls->capacity;
+    cls->count--;
+    return client_fd;
+}
+
+/**
+ * Connections waiting across all classes
+ */
+static int queue_total(const connection_queue_t* queue) {
+    int total = 0;
+    for (int c = 0; c < NUM_QUEUE_CLASSES; c++) {
+        total += queue->classes[c].count;
+    }
+    return total;
+}
+
+/**
+ * Raise the peak depth reported by connection_queue_take_peak()
+ * Caller holds queue->mutex.
+ */
+static void note_depth(connection_queue_t* queue) {
+    int depth = queue_total(queue);
+    if (depth > queue->peak_depth) {
+        queue->peak_depth = depth;
+    }
+}
+
+/**
+ * Choose the class to serve next.
+ * Strict: lowest non-empty class index wins.
+ * Weighted: each class gets `weight` turns per round; the round is refilled
+ * once every non-empty class has used its credit.
+ */
+static int pick_class(connection_queue_t* queue) {
+    if (queue->scheduling == QUEUE_SCHED_STRICT) {
+        for (int c = 0; c < NUM_QUEUE_CLASSES; c++) {
+            if (queue->classes[c].count > 0) return c;
+        }
+        return -1;
+    }
+
+    for (int round = 0; round < 2; round++) {
+        for (int c = 0; c < NUM_QUEUE_CLASSES; c++) {
+            connection_class_queue_t* cls = &queue->classes[c];
+            if (cls->count > 0 && cls->credit > 0) {
+                cls->credit--;
+                return c;
+            }
+        }
+        // Round exhausted - refill credits
+        for (int c = 0; c < NUM_QUEUE_CLASSES; c++) {
+            queue->classes[c].credit = queue->classes[c].weight;
+        }
+    }
+    return -1;
+}
 
 // ============================================================================
 // Initialize Connection Queue
 // ============================================================================
-int connection_queue_init(connection_queue_t* queue) {
-    if (!queue) {
+int connection_queue_init(connection_queue_t* queue, const server_config_t* config) {
+    if (!queue || !config) {
         return -1;
     }
-    
-    // init circular buffer indices
-    queue->head = 0;
-    queue->tail = 0;
+
     queue->shutdown = 0;
-    
-    memset(queue->connections, -1, sizeof(queue->connections));
-    
-    // init semaphores
-    // empty_slots: initially QUEUE_SIZE (all slots are empty)
-    if (sem_init(&queue->empty_slots, 0, QUEUE_SIZE) != 0) {
-        log_message("Failed to initialize empty_slots semaphore: %s", strerror(errno));
-        return -1;
+    queue->scheduling = config->queue_scheduling;
+    queue->max_spin_ns = config->queue_spin_us * 1000;
+    queue->spin_ns = 0;
+    queue->last_arrival_ns = 0;
+    queue->avg_gap_ns = queue->max_spin_ns + 1;   // start parked until traffic shows up
+    queue->peak_depth = 0;
+    memset(queue->wake_spin_hist, 0, sizeof(queue->wake_spin_hist));
+    memset(queue->wake_park_hist, 0, sizeof(queue->wake_park_hist));
+
+    // init per-class circular buffers
+    for (int c = 0; c < NUM_QUEUE_CLASSES; c++) {
+        connection_class_queue_t* cls = &queue->classes[c];
+        const queue_class_config_t* cfg = &config->queue_classes[c];
+
+        cls->head = 0;
+        cls->tail = 0;
+        cls->count = 0;
+        cls->capacity = cfg->capacity;
+        if (cls->capacity < 1) cls->capacity = 1;
+        if (cls->capacity > QUEUE_MAX_CAPACITY) cls->capacity = QUEUE_MAX_CAPACITY;
+        cls->weight = cfg->weight > 0 ? cfg->weight : 1;
+        cls->credit = cls->weight;
+        cls->shed_policy = cfg->shed_policy;
+        cls->shed_count = 0;
+        memset(cls->connections, -1, sizeof(cls->connections));
+
+        // empty_slots: initially capacity (all slots are empty)
+        if (sem_init(&cls->empty_slots, 0, cls->capacity) != 0) {
+            log_message("Failed to initialize empty_slots semaphore: %s", strerror(errno));
+            for (int j = 0; j < c; j++) sem_destroy(&queue->classes[j].empty_slots);
+            return -1;
+        }
     }
-    
+
     // filled_slots: initially 0 (no slots are filled)
     if (sem_init(&queue->filled_slots, 0, 0) != 0) {
         log_message("Failed to initialize filled_slots semaphore: %s", strerror(errno));
-        sem_destroy(&queue->empty_slots);
+        for (int c = 0; c < NUM_QUEUE_CLASSES; c++) sem_destroy(&queue->classes[c].empty_slots);
         return -1;
     }
-    
+
     // mutex: binary semaphore for mutual exclusion (initialized to 1)
     if (sem_init(&queue->mutex, 0, 1) != 0) {
         log_message("Failed to initialize mutex semaphore: %s", strerror(errno));
-        sem_destroy(&queue->empty_slots);
+        for (int c = 0; c < NUM_QUEUE_CLASSES; c++) sem_destroy(&queue->classes[c].empty_slots);
         sem_destroy(&queue->filled_slots);
         return -1;
     }
-    
-    log_message("Connection queue initialized (size: %d)", QUEUE_SIZE);
+
+    log_message("Connection queue initialized (%s scheduling, control=%d/w%d, interactive=%d/w%d, bulk=%d/w%d)",
+                queue->scheduling == QUEUE_SCHED_STRICT ? "strict" : "weighted",
+                queue->classes[QUEUE_CLASS_CONTROL].capacity, queue->classes[QUEUE_CLASS_CONTROL].weight,
+                queue->classes[QUEUE_CLASS_INTERACTIVE].capacity, queue->classes[QUEUE_CLASS_INTERACTIVE].weight,
+                queue->classes[QUEUE_CLASS_BULK].capacity, queue->classes[QUEUE_CLASS_BULK].weight);
     return 0;
 }
 
+// ============================================================================
+// Classify Request Path
+// ============================================================================
+int connection_queue_classify(const server_config_t* config, const char* path) {
+    int best_class = config->queue_default_class;
+    size_t best_len = 0;
+
+    // Longest prefix wins; later rules override earlier ones of equal length
+    for (int i = 0; i < config->queue_rule_count; i++) {
+        const queue_rule_t* rule = &config->queue_rules[i];
+        size_t len = strlen(rule->prefix);
+        if (len >= best_len && strncmp(path, rule->prefix, len) == 0) {
+            best_class = rule->class_id;
+            best_len = len;
+        }
+    }
+
+    return best_class;
+}
+
 // ============================================================================
 // Enqueue Connection (Producer - Blocking)
 // ============================================================================
-int connection_queue_enqueue(connection_queue_t* queue, int client_fd) {
-    if (!queue || client_fd < 0) {
+int connection_queue_enqueue(connection_queue_t* queue, int client_fd, int class_id) {
+    if (!queue || client_fd < 0 || class_id < 0 || class_id >= NUM_QUEUE_CLASSES) {
         return -1;
     }
-    
+    connection_class_queue_t* cls = &queue->classes[class_id];
+
     // Wait for an empty slot
-    if (sem_wait(&queue->empty_slots) != 0) {
+    if (timed_sem_wait(&cls->empty_slots, LOCK_QUEUE_EMPTY) != 0) {
         return -1;
     }
-    
+
     // Check if shutdown was signaled
     if (queue->shutdown) {
-        sem_post(&queue->empty_slots);  // Release the slot
+        sem_post(&cls->empty_slots);  // Release the slot
         return -1;
     }
-    
+
     // Enter critical section
-    sem_wait(&queue->mutex);
-    
-    // Add connection to the queue
-    queue->connections[queue->tail] = client_fd;
-    queue->tail = (queue->tail + 1) % QUEUE_SIZE;
-    
-    // Exit critical section
+    long long now = monotonic_ns();
+    timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+    class_push(cls, client_fd, now);
+    note_arrival(queue, now);
+    note_depth(queue);
     sem_post(&queue->mutex);
-    
+
     // Signal that a slot is now filled
     sem_post(&queue->filled_slots);
-    
+
     return 0;
 }
 
 // ============================================================================
 // Try Enqueue Without Blocking (for 503 handling)
 // ============================================================================
-int connection_queue_try_enqueue(connection_queue_t* queue, int client_fd) {
-    if (!queue || client_fd < 0) {
-        return -1;
+int connection_queue_try_enqueue(connection_queue_t* queue, int client_fd,
+                                 int class_id, int* evicted_fd) {
+    if (evicted_fd) {
+        *evicted_fd = -1;
     }
-    
-    // Try to acquire an empty slot without blocking
-    if (sem_trywait(&queue->empty_slots) != 0) {
-        // queue is full
+    if (!queue || client_fd < 0 || class_id < 0 || class_id >= NUM_QUEUE_CLASSES) {
         return -1;
     }
-    
+    connection_class_queue_t* cls = &queue->classes[class_id];
+
     // need to check if shutdown was signaled
     if (queue->shutdown) {
-        sem_post(&queue->empty_slots);  // Release the slot
         return -1;
     }
-    
+
+    // Try to acquire an empty slot without blocking
+    if (sem_trywait(&cls->empty_slots) != 0) {
+        // class is full - apply its shed policy
+        if (cls->shed_policy != SHED_DROP_OLDEST || !evicted_fd) {
+            timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+            cls->shed_count++;
+            sem_post(&queue->mutex);
+            return -1;
+        }
+
+        // Replace the oldest queued connection; filled_slots is unchanged
+        long long now = monotonic_ns();
+        timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+        if (cls->count == 0) {
+            // A consumer drained it meanwhile, treat as rejected
+            cls->shed_count++;
+            sem_post(&queue->mutex);
+            return -1;
+        }
+        *evicted_fd = class_pop(cls, NULL);
+        class_push(cls, client_fd, now);
+        cls->shed_count++;
+        sem_post(&queue->mutex);
+        return 0;
+    }
+
     // Enter critical section
-    sem_wait(&queue->mutex);
-    
-    // Add connection to the queue
-    queue->connections[queue->tail] = client_fd;
-    queue->tail = (queue->tail + 1) % QUEUE_SIZE;
-    
-    // Exit critical section
+    long long now = monotonic_ns();
+    timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+    class_push(cls, client_fd, now);
+    note_arrival(queue, now);
+    note_depth(queue);
     sem_post(&queue->mutex);
-    
+
     // Signal that a slot is now filled
     sem_post(&queue->filled_slots);
-    
+
     return 0;
 }
 
@@ -123,35 +340,66 @@ int connection_queue_try_enqueue(connection_queue_t* queue, int client_fd) {
 // Dequeue Connection (Consumer - Blocking)
 // ============================================================================
 int connection_queue_dequeue(connection_queue_t* queue) {
+    return connection_queue_dequeue_timed(queue, NULL);
+}
+
+int connection_queue_dequeue_timed(connection_queue_t* queue, long long* queued_ns) {
     if (!queue) {
         return -1;
     }
-    
-    // Wait for a filled slot
-    if (sem_wait(&queue->filled_slots) != 0) {
+
+    // Wait for a filled slot: take one if ready, else spin briefly, else park
+    int waited = 0;
+    int spun = 0;
+    long long wait_start = 0;
+    if (sem_trywait(&queue->filled_slots) != 0) {
+        waited = 1;
+        LOCK_WAIT_START(wait_start);
+        spun = spin_for_slot(queue);
+        if (!spun && sem_wait(&queue->filled_slots) != 0) {
+            return -1;
+        }
+    }
+    LOCK_RECORD(LOCK_QUEUE_FILLED, waited, wait_start);
+
+    // Enter critical section
+    timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+
+    // On shutdown, consumers keep draining queued connections and only
+    // leave once every class is empty
+    if (queue->shutdown && queue_total(queue) == 0) {
+        sem_post(&queue->mutex);
+        sem_post(&queue->filled_slots);  // Pass the wakeup on to the next consumer
         return -1;
     }
-    
-    // Check if shutdown was signaled
-    if (queue->shutdown) {
-        sem_post(&queue->filled_slots);  // Keep the semaphore count correct
+
+    int class_id = pick_class(queue);
+    if (class_id < 0) {
+        // Cannot happen while filled_slots matches the class counts
+        sem_post(&queue->mutex);
         return -1;
     }
-    
-    // Enter critical section
-    sem_wait(&queue->mutex);
-    
-    // Remove connection from the queue
-    int client_fd = queue->connections[queue->head];
-    queue->connections[queue->head] = -1;
-    queue->head = (queue->head + 1) % QUEUE_SIZE;
-    
+    long long enqueued_ns;
+    int client_fd = class_pop(&queue->classes[class_id], &enqueued_ns);
+
+    long long in_queue_ns = monotonic_ns() - enqueued_ns;
+    if (queued_ns) {
+        *queued_ns = in_queue_ns;
+    }
+
+    // An idle consumer picked this up: arrival -> dequeue is its wakeup latency
+    if (waited) {
+        int bucket = wakeup_bucket(in_queue_ns);
+        if (spun) queue->wake_spin_hist[bucket]++;
+        else queue->wake_park_hist[bucket]++;
+    }
+
     // Exit critical section
     sem_post(&queue->mutex);
-    
-    // Signal that a slot is now empty
-    sem_post(&queue->empty_slots);
-    
+
+    // Signal that a slot is now empty in that class
+    sem_post(&queue->classes[class_id].empty_slots);
+
     return client_fd;
 }
 
@@ -162,21 +410,48 @@ int connection_queue_size(connection_queue_t* queue) {
     if (!queue) {
         return -1;
     }
-    
-    int size;
-    sem_wait(&queue->mutex);
-    
-    // Calculate size from head and tail
-    if (queue->tail >= queue->head) {
-        size = queue->tail - queue->head;
-    } else {
-        size = QUEUE_SIZE - queue->head + queue->tail;
-    }
-    
+
+    timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+    int size = queue_total(queue);
+    sem_post(&queue->mutex);
+    return size;
+}
+
+int connection_queue_take_peak(connection_queue_t* queue) {
+    if (!queue) {
+        return -1;
+    }
+
+    timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+    int peak = queue->peak_depth;
+    queue->peak_depth = queue_total(queue);
+    sem_post(&queue->mutex);
+    return peak;
+}
+
+int connection_queue_class_size(connection_queue_t* queue, int class_id) {
+    if (!queue || class_id < 0 || class_id >= NUM_QUEUE_CLASSES) {
+        return -1;
+    }
+
+    timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+    int size = queue->classes[class_id].count;
     sem_post(&queue->mutex);
     return size;
 }
 
+void connection_queue_wakeup_stats(connection_queue_t* queue,
+                                   unsigned long* spin_hist, unsigned long* park_hist) {
+    if (!queue) {
+        return;
+    }
+
+    timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+    memcpy(spin_hist, queue->wake_spin_hist, sizeof(queue->wake_spin_hist));
+    memcpy(park_hist, queue->wake_park_hist, sizeof(queue->wake_park_hist));
+    sem_post(&queue->mutex);
+}
+
 // ============================================================================
 // Shutdown Queue
 // ============================================================================
@@ -184,17 +459,15 @@ void connection_queue_shutdown(connection_queue_t* queue) {
     if (!queue) {
         return;
     }
-    
-    sem_wait(&queue->mutex);
+
+    timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
     queue->shutdown = 1;
     sem_post(&queue->mutex);
-    
-    // Wake up all waiting consumers by posting to filled_slots
-    // This ensures threads waiting on dequeue will wake up and check shutdown flag
-    for (int i = 0; i < QUEUE_SIZE; i++) {
-        sem_post(&queue->filled_slots);
-    }
-    
+
+    // Wake up waiting consumers by posting to filled_slots
+    // Each consumer re-posts on shutdown, so the wakeup propagates to all of them
+    sem_post(&queue->filled_slots);
+
     log_message("Connection queue shutdown signaled");
 }
 
@@ -205,21 +478,23 @@ void connection_queue_destroy(connection_queue_t* queue) {
     if (!queue) {
         return;
     }
-    
-    // Close any remaining connections
-    sem_wait(&queue->mutex);
-    for (int i = 0; i < QUEUE_SIZE; i++) {
-        if (queue->connections[i] >= 0) {
-            close(queue->connections[i]);
-            queue->connections[i] = -1;
+
+    // Close any remaining connections (only left behind by a forced shutdown)
+    timed_sem_wait(&queue->mutex, LOCK_QUEUE_MUTEX);
+    for (int c = 0; c < NUM_QUEUE_CLASSES; c++) {
+        connection_class_queue_t* cls = &queue->classes[c];
+        while (cls->count > 0) {
+            close(class_pop(cls, NULL));
         }
     }
     sem_post(&queue->mutex);
-    
+
     // Destroy semaphores
-    sem_destroy(&queue->empty_slots);
+    for (int c = 0; c < NUM_QUEUE_CLASSES; c++) {
+        sem_destroy(&queue->classes[c].empty_slots);
+    }
     sem_destroy(&queue->filled_slots);
     sem_destroy(&queue->mutex);
-    
+
     log_message("Connection queue destroyed");
 }
@@ -2,26 +2,56 @@
 #define CONNECTION_QUEUE_H
 
 #include <semaphore.h>
+#include "config.h"
+#include "stats.h"
 
 // ============================================================================
 // Connection Queue Configuration
 // ============================================================================
-#define QUEUE_SIZE 100  // Bounded circular buffer size
+#define QUEUE_SIZE 100            // Default capacity of the interactive class
+#define QUEUE_MAX_CAPACITY 1024   // Upper bound for any single class
 
 // ============================================================================
-// Connection Queue Structure
+// Connection Queue Structures
 // ============================================================================
+
+// One bounded circular buffer per traffic class
 typedef struct {
-    int connections[QUEUE_SIZE];
+    int connections[QUEUE_MAX_CAPACITY];
+    long long enqueue_ns[QUEUE_MAX_CAPACITY];   // Monotonic arrival time per slot
     int head;
     int tail;
-    
-    // Semaphores for synchronization
+    int count;
+    int capacity;
+    int weight;
+    int credit;                   // Remaining turns in the current WRR round
+    int shed_policy;
+    unsigned long shed_count;     // Connections answered with 503 for this class
+
     sem_t empty_slots;
-    sem_t filled_slots;
+} connection_class_queue_t;
+
+typedef struct {
+    connection_class_queue_t classes[NUM_QUEUE_CLASSES];
+    int scheduling;
+
+    // Semaphores for synchronization
+    sem_t filled_slots;           // Total connections queued across all classes
     sem_t mutex;
-    
+
     int shutdown;
+
+    // Spin-then-park consumer waiting
+    int max_spin_ns;              // Configured upper bound (0 = always park)
+    int spin_ns;                  // Current budget, adapted to the arrival rate
+    long long last_arrival_ns;
+    long long avg_gap_ns;         // EWMA of inter-arrival time
+
+    int peak_depth;               // Highest total depth since the last take_peak
+
+    // Wakeup latency (arrival -> idle consumer running), split by how it waited
+    unsigned long wake_spin_hist[WAKEUP_HIST_BUCKETS];
+    unsigned long wake_park_hist[WAKEUP_HIST_BUCKETS];
 } connection_queue_t;
 
 // ============================================================================
@@ -29,31 +59,47 @@ typedef struct {
 // ============================================================================
 
 /**
- * Initialize the connection queue
+ * Initialize the connection queue with the class layout from config
  * Returns: 0 on success, -1 on error
  */
-int connection_queue_init(connection_queue_t* queue);
+int connection_queue_init(connection_queue_t* queue, const server_config_t* config);
 
 /**
- * Enqueue a connection (producer)
- * Returns: 0 on success, -1 if queue is full
+ * Enqueue a connection into a class (producer)
+ * Returns: 0 on success, -1 on shutdown
  */
-int connection_queue_enqueue(connection_queue_t* queue, int client_fd);
+int connection_queue_enqueue(connection_queue_t* queue, int client_fd, int class_id);
 
 /**
- * Dequeue a connection (consumer)
+ * Dequeue a connection (consumer), picking the class by the scheduling policy
  * Returns: client_fd on success, -1 if shutdown
  */
 int connection_queue_dequeue(connection_queue_t* queue);
 
+/**
+ * connection_queue_dequeue() that also reports how long the connection
+ * waited in the queue (queued_ns may be NULL)
+ */
+int connection_queue_dequeue_timed(connection_queue_t* queue, long long* queued_ns);
+
 /**
  * Try to enqueue without blocking (for handling 503)
- * Returns: 0 on success, -1 if queue is full
+ * When the class is full and its policy is drop-oldest, the oldest queued
+ * connection is removed and returned in *evicted_fd so the caller can 503 it.
+ * Returns: 0 on success, -1 if the class is full and the new connection is rejected
+ */
+int connection_queue_try_enqueue(connection_queue_t* queue, int client_fd,
+                                 int class_id, int* evicted_fd);
+
+/**
+ * Map a request path to a traffic class using the longest matching rule
+ * Returns: class id
  */
-int connection_queue_try_enqueue(connection_queue_t* queue, int client_fd);
+int connection_queue_classify(const server_config_t* config, const char* path);
 
 /**
  * Signal shutdown and wake up all waiting consumers
+ * Producers are refused from now on; consumers return -1 once the queue is empty.
  */
 void connection_queue_shutdown(connection_queue_t* queue);
 
@@ -68,4 +114,23 @@ void connection_queue_destroy(connection_queue_t* queue);
  */
 int connection_queue_size(connection_queue_t* queue);
 
+/**
+ * Highest total size since the previous call (or init), so bursts between
+ * two monitoring samples still show; restarts from the current size
+ * Returns: the peak number of connections queued
+ */
+int connection_queue_take_peak(connection_queue_t* queue);
+
+/**
+ * Get current size of a single class (for monitoring)
+ * Returns: number of connections queued in that class
+ */
+int connection_queue_class_size(connection_queue_t* queue, int class_id);
+
+/**
+ * Copy the wakeup latency histograms (WAKEUP_HIST_BUCKETS entries each)
+ */
+void connection_queue_wakeup_stats(connection_queue_t* queue,
+                                   unsigned long* spin_hist, unsigned long* park_hist);
+
 #endif // CONNECTION_QUEUE_H
@@ -0,0 +1,331 @@
+// Thread-per-core shared-nothing worker
+
+#define _GNU_SOURCE
+#include "core_worker.h"
+#include "server.h"
+#include "http.h"
+#include "logger.h"
+#include "stats.h"
+#include "file_cache.h"
+#include "arena.h"
+#include "event_loop.h"
+#include "response_writer.h"
+#include "disk_io.h"
+#include "coroutine.h"
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t keep_running = 1;
+
+// ============================================================================
+// Core Context (everything the core's single thread owns)
+// ============================================================================
+typedef struct core_task core_task_t;
+
+typedef struct {
+    int core_id;
+    const server_config_t* config;
+    file_cache_t* cache;
+    arena_t arena;
+    size_t published_high_water;
+    event_loop_t loop;
+    response_writer_t writer;
+    disk_io_pool_t disk;
+    int has_disk;
+    co_scheduler_t sched;
+    int has_coroutines;
+    core_task_t* free_tasks;
+    unsigned long served;
+} core_context_t;
+
+// One request running as a coroutine; kept (with its arena) for reuse
+struct core_task {
+    arena_t arena;
+    int fd;
+    core_context_t* core;
+    core_task_t* next_free;
+};
+
+static void core_signal_handler(int signum) {
+    (void)signum;
+    keep_running = 0;
+}
+
+// ============================================================================
+// Serve a Request on the Loop Thread
+// ============================================================================
+static void serve_request(core_context_t* core, int client_fd, arena_t* arena) {
+    http_conn_t conn = {
+        .fd = client_fd,
+        .config = core->config,
+        .cache = core->cache,
+        .arena = arena,
+        .writer = &core->writer,
+        .disk = core->has_disk ? &core->disk : NULL,
+        .loop = &core->loop,
+    };
+    if (handle_client_connection(&conn)) {
+        event_loop_add_idle(&core->loop, client_fd);
+    }
+    core->served++;
+
+    if (arena->high_water > core->published_high_water) {
+        core->published_high_water = arena->high_water;
+        update_arena_high_water((long long)core->published_high_water);
+    }
+    arena_reset(arena);
+}
+
+static void core_task_run(void* arg) {
+    core_task_t* task = arg;
+    core_context_t* core = task->core;
+    serve_request(core, task->fd, &task->arena);
+
+    task->next_free = core->free_tasks;
+    core->free_tasks = task;
+}
+
+static core_task_t* take_task(core_context_t* core) {
+    core_task_t* task = core->free_tasks;
+    if (task) {
+        core->free_tasks = task->next_free;
+        return task;
+    }
+    task = calloc(1, sizeof(core_task_t));
+    if (!task) {
+        return NULL;
+    }
+    if (arena_init(&task->arena, (size_t)core->config->arena_size_kb * 1024) != 0) {
+        free(task);
+        return NULL;
+    }
+    task->core = core;
+    return task;
+}
+
+static void core_dispatch(void* arg, int client_fd, const char* request, size_t len) {
+    core_context_t* core = arg;
+    (void)request;
+    (void)len;
+
+    // Each request gets its own coroutine (and arena) so it can park on a
+    // slow socket or a disk load while the loop serves the others
+    if (core->has_coroutines) {
+        core_task_t* task = take_task(core);
+        if (task) {
+            task->fd = client_fd;
+            if (co_spawn(&core->sched, core_task_run, task) == 0) {
+                return;
+            }
+            task->next_free = core->free_tasks;
+            core->free_tasks = task;
+        }
+    }
+
+    serve_request(core, client_fd, &core->arena);
+}
+
+/**
+ * Publish this core's gauges to its stats block (loop ticker)
+ */
+static void core_publish_gauges(void* arg) {
+    core_context_t* core = arg;
+    worker_stats_t gauges = {
+        .busy_threads = core->has_coroutines ? core->sched.live : 0,
+        .threads = 1,
+    };
+    listen_queue_info(core->loop.listen_fd, &gauges.listen_backlog,
+                      &gauges.listen_backlog_limit, &gauges.listener_id);
+    if (core->cache) {
+        int entries;
+        size_t total_size;
+        file_cache_stats(core->cache, &entries, &total_size);
+        gauges.cache_entries = entries;
+        gauges.cache_bytes = (long long)total_size;
+    }
+    publish_worker_stats(&gauges);
+}
+
+static int core_drain_done(void* arg) {
+    core_context_t* core = arg;
+    return response_writer_pending(&core->writer) == 0 &&
+           (!core->has_disk || disk_io_pending(&core->disk) == 0) &&
+           (!core->has_coroutines || core->sched.live == 0);
+}
+
+static void pin_to_core(int core_id) {
+    // Worker i takes the i-th CPU of the inherited affinity mask, so a
+    // taskset or cpuset restricted to CPUs 4-7 yields workers on 4..7
+    cpu_set_t allowed;
+    int cpu = -1;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int i = 0, seen = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &allowed) && seen++ == core_id) {
+                cpu = i;
+                break;
+            }
+        }
+    }
+    if (cpu < 0) {
+        log_message("Core %d: No allowed CPU to pin to, running unpinned", core_id);
+        return;
+    }
+
+    cpu_set_t set; CPU_ZERO(&set); CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        log_message("Core %d: Failed to pin to CPU %d, running unpinned", core_id, cpu);
+    }
+}
+
+int core_worker_count(void) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        int n = CPU_COUNT(&allowed);
+        if (n > 0) return n;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+// ============================================================================
+// Core Worker Process
+// ============================================================================
+void core_worker_process(int core_id, const server_config_t* config) {
+    signal(SIGTERM, core_signal_handler);
+    signal(SIGINT, core_signal_handler);
+
+    pin_to_core(core_id);
+    stats_set_worker(core_id);
+    stats_bind_thread();
+
+    log_message("Core %d started (PID: %d)", core_id, getpid());
+
+    // Own listener: SO_REUSEPORT lets the kernel balance connections per core
+    int listen_fd = create_server_socket(config->port);
+    if (listen_fd < 0) {
+        log_message("Core %d: Failed to create listener", core_id);
+        return;
+    }
+
+    core_context_t* core = calloc(1, sizeof(core_context_t));
+    if (!core) {
+        close(listen_fd);
+        return;
+    }
+    core->core_id = core_id;
+    core->config = config;
+
+    file_cache_t cache;
+    if (config->cache_size_mb > 0) {
+        if (file_cache_init(&cache, config->cache_size_mb) != 0) {
+            log_message("Core %d: Failed to initialize file cache", core_id);
+            free(core);
+            close(listen_fd);
+            return;
+        }
+        file_cache_set_single_owner(&cache);
+        core->cache = &cache;
+    }
+
+    if (arena_init(&core->arena, (size_t)config->arena_size_kb * 1024) != 0 ||
+        event_loop_init(&core->loop, listen_fd, config, core_dispatch, core) != 0) {
+        log_message("Core %d: Failed to initialize request path", core_id);
+        if (core->cache) file_cache_destroy(core->cache);
+        free(core);
+        close(listen_fd);
+        return;
+    }
+
+    // Slow clients are finished by the same loop, not a second thread
+    if (response_writer_init(&core->writer, &core->loop, 0) != 0) {
+        log_message("Core %d: Failed to attach response writer", core_id);
+        event_loop_destroy(&core->loop);
+        arena_destroy(&core->arena);
+        if (core->cache) file_cache_destroy(core->cache);
+        free(core);
+        close(listen_fd);
+        return;
+    }
+
+    // Cache misses are the one thing that may block this thread: load them
+    // on helper threads and finish them from the loop
+    if (config->disk_io_threads > 0) {
+        if (disk_io_init(&core->disk, config->disk_io_threads) == 0) {
+            core->has_disk = 1;
+            event_loop_add_poller(&core->loop, disk_io_fd(&core->disk), disk_io_poll,
+                                  NULL, &core->disk);
+        } else {
+            log_message("Core %d: Disk I/O pool disabled: cannot start disk threads", core_id);
+        }
+    }
+
+    if (config->coroutines) {
+        if (co_scheduler_init(&core->sched, &core->loop, config->co_stack_kb) == 0) {
+            core->has_coroutines = 1;
+        } else {
+            log_message("Core %d: Coroutines disabled: cannot attach scheduler", core_id);
+        }
+    }
+
+    if (event_loop_set_ticker(&core->loop, WORKER_STATS_INTERVAL_MS, core_publish_gauges) != 0) {
+        log_message("Core %d: Per-core gauges disabled: cannot create timer", core_id);
+    }
+    core_publish_gauges(core);
+
+    event_loop_run(&core->loop, &keep_running);
+
+    // Graceful drain: the loop is the only producer, so in-flight work is
+    // just connections still waiting for headers, disk loads and offloaded responses
+    set_draining();
+    unsigned long served_before = core->served;
+    int drain_result = event_loop_drain(&core->loop, config->drain_timeout_seconds * 1000,
+                                        core_drain_done, core);
+    long long drained = (long long)(core->served - served_before);
+    long long dropped = drain_result != 0 ?
+        core->loop.live_count + response_writer_pending(&core->writer) +
+        (core->has_disk ? disk_io_pending(&core->disk) : 0) +
+        (core->has_coroutines ? core->sched.live : 0) : 0;
+    record_drain(drained, dropped);
+
+    log_message("Core %d: Shutting down (accepted: %lu, served: %lu, header timeouts: %lu, idle timeouts: %lu)",
+                core_id, core->loop.accepted, core->served,
+                core->loop.header_timeouts, core->loop.idle_timeouts);
+    log_message("Core %d: Drain %s - drained %lld requests (%lu taken from the accept queue), dropped %lld connections",
+                core_id, drain_result == 0 ? "complete" : "deadline reached", drained,
+                core->loop.drain_accepted, dropped);
+
+    // Disk completions wake coroutines, and both may hand work to the writer
+    if (core->has_disk) {
+        disk_io_destroy(&core->disk);
+    }
+    if (core->has_coroutines) {
+        log_message("Core %d: Coroutines - %lu spawned, peak %d in flight, %lu switches, %lu wait timeouts",
+                    core_id, core->sched.spawned, core->sched.peak_live,
+                    core->sched.switches, core->sched.timeouts);
+        co_scheduler_destroy(&core->sched);
+    }
+    while (core->free_tasks) {
+        core_task_t* task = core->free_tasks;
+        core->free_tasks = task->next_free;
+        arena_destroy(&task->arena);
+        free(task);
+    }
+    response_writer_destroy(&core->writer);
+    event_loop_destroy(&core->loop);
+    arena_destroy(&core->arena);
+
+    if (core->cache) {
+        int entries;
+        size_t total_size;
+        file_cache_stats(core->cache, &entries, &total_size);
+        log_message("Core %d: Final cache stats - %d entries, %zu bytes",
+                    core_id, entries, total_size);
+        file_cache_destroy(core->cache);
+    }
+    free(core);
+
+    log_message("Core %d exiting", core_id);
+}
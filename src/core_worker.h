@@ -0,0 +1,26 @@
+#ifndef CORE_WORKER_H
+#define CORE_WORKER_H
+
+#include "config.h"
+
+// ============================================================================
+// Thread-per-Core Worker
+// ============================================================================
+// EXECUTION_MODE=per-core: the master forks one worker per CPU it may run on
+// (its affinity mask, which also reflects a cgroup cpuset). Each
+// is a single thread pinned to its core that owns everything on its request
+// path - its own SO_REUSEPORT listener (the kernel spreads connections across
+// cores), event loop, file cache and stats shard - and serves requests
+// inline in the loop. Nothing on the hot path is shared, so nothing is locked.
+
+/**
+ * Number of per-core workers: the CPUs in the master's affinity mask
+ */
+int core_worker_count(void);
+
+/**
+ * Run the worker for core_id until SIGTERM, then drain and return
+ */
+void core_worker_process(int core_id, const server_config_t* config);
+
+#endif // CORE_WORKER_H
@@ -0,0 +1,320 @@
+// Stackful coroutines driven by the worker event loop
+
+#define _GNU_SOURCE
+#include "coroutine.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+
+#define CO_MAX_EVENTS 64
+#define CO_MAX_FREE 256             // Finished coroutines kept for reuse
+#define CO_STACK_DEFAULT_KB 64
+#define CO_STACK_MIN_KB 16          // Headroom for the request path and libc calls
+#define CO_STACK_MAX_KB 1024        // Bounds the address space per in-flight request
+
+// The scheduler of the loop running on this thread
+static __thread co_scheduler_t* thread_sched = NULL;
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
+static void make_ready(co_scheduler_t* sched, coroutine_t* co) {
+    if (co->ready) {
+        return;
+    }
+    co->ready = 1;
+    co->next = NULL;
+    if (sched->ready_tail) sched->ready_tail->next = co;
+    else sched->ready_head = co;
+    sched->ready_tail = co;
+}
+
+static void on_deadline(timer_node_t* node, void* ctx) {
+    co_scheduler_t* sched = ctx;
+    coroutine_t* co = (coroutine_t*)node;
+    if (co->ready) {
+        return;     // Its fd fired first
+    }
+    sched->timeouts++;
+    co->wait_result = -1;
+    make_ready(sched, co);
+}
+
+static void free_coroutine(coroutine_t* co) {
+    munmap(co->stack, co->stack_size);
+    free(co);
+}
+
+/**
+ * New coroutine with a stack; reuses a finished one when possible
+ */
+static coroutine_t* alloc_coroutine(co_scheduler_t* sched) {
+    if (sched->free_list) {
+        coroutine_t* co = sched->free_list;
+        sched->free_list = co->next;
+        sched->free_count--;
+        return co;
+    }
+
+    coroutine_t* co = calloc(1, sizeof(coroutine_t));
+    if (!co) {
+        return NULL;
+    }
+    // One PROT_NONE page below the stack turns an overflow into a crash
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    co->stack_size = sched->stack_size + page;
+    co->stack = mmap(NULL, co->stack_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (co->stack == MAP_FAILED) {
+        free(co);
+        return NULL;
+    }
+    mprotect(co->stack, page, PROT_NONE);
+    return co;
+}
+
+static void release_coroutine(co_scheduler_t* sched, coroutine_t* co) {
+    if (co->live_prev) co->live_prev->live_next = co->live_next;
+    else sched->live_list = co->live_next;
+    if (co->live_next) co->live_next->live_prev = co->live_prev;
+    sched->live--;
+
+    if (sched->free_count < CO_MAX_FREE) {
+        co->next = sched->free_list;
+        sched->free_list = co;
+        sched->free_count++;
+    } else {
+        free_coroutine(co);
+    }
+}
+
+static void coroutine_entry(void);
+
+/**
+ * Point co's context at coroutine_entry on its own stack. Kept out of line:
+ * getcontext() is treated like setjmp, which trips -Wclobbered in co_spawn.
+ */
+static __attribute__((noinline)) void prepare_context(co_scheduler_t* sched, coroutine_t* co) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    ucontext_t* ctx = &co->ctx;
+    getcontext(ctx);
+    ctx->uc_stack.ss_sp = (char*)co->stack + page;
+    ctx->uc_stack.ss_size = co->stack_size - page;
+    ctx->uc_link = &sched->main_ctx;
+    makecontext(ctx, coroutine_entry, 0);
+}
+
+static void coroutine_entry(void) {
+    co_scheduler_t* sched = thread_sched;
+    coroutine_t* co = sched->current;
+    co->fn(co->arg);
+    co->finished = 1;
+    // uc_link switches back to the loop
+}
+
+/**
+ * Switch from the loop into co until it parks or finishes (loop context only)
+ */
+static void resume(co_scheduler_t* sched, coroutine_t* co) {
+    sched->current = co;
+    sched->switches++;
+    swapcontext(&sched->main_ctx, &co->ctx);
+    sched->current = NULL;
+
+    if (co->finished) {
+        release_coroutine(sched, co);
+    }
+}
+
+/**
+ * Switch from the running coroutine back to the loop
+ */
+static int park(co_scheduler_t* sched) {
+    coroutine_t* co = sched->current;
+    swapcontext(&co->ctx, &sched->main_ctx);
+    return co->wait_result;
+}
+
+static void run_ready(co_scheduler_t* sched) {
+    while (sched->ready_head) {
+        coroutine_t* co = sched->ready_head;
+        sched->ready_head = co->next;
+        if (!sched->ready_head) sched->ready_tail = NULL;
+        co->ready = 0;
+        resume(sched, co);
+    }
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+int co_scheduler_init(co_scheduler_t* sched, event_loop_t* loop, int stack_kb) {
+    memset(sched, 0, sizeof(*sched));
+    sched->loop = loop;
+    int kb = stack_kb > 0 ? stack_kb : CO_STACK_DEFAULT_KB;
+    if (kb < CO_STACK_MIN_KB) kb = CO_STACK_MIN_KB;
+    if (kb > CO_STACK_MAX_KB) kb = CO_STACK_MAX_KB;
+    if (stack_kb > 0 && kb != stack_kb) {
+        log_message("Coroutines: CO_STACK_KB=%d out of range %d-%d, using %d",
+                    stack_kb, CO_STACK_MIN_KB, CO_STACK_MAX_KB, kb);
+    }
+    sched->stack_size = (size_t)kb * 1024;
+    timer_wheel_init(&sched->timers, LOOP_TICK_MS, monotonic_ms());
+
+    sched->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (sched->epoll_fd < 0) {
+        log_message("Coroutines: epoll_create1 failed: %s", strerror(errno));
+        return -1;
+    }
+    if (event_loop_add_poller(loop, sched->epoll_fd, co_scheduler_poll,
+                              co_scheduler_next_timeout_ms, sched) != 0) {
+        log_message("Coroutines: cannot attach to the event loop");
+        close(sched->epoll_fd);
+        return -1;
+    }
+
+    thread_sched = sched;
+    return 0;
+}
+
+int co_spawn(co_scheduler_t* sched, void (*fn)(void*), void* arg) {
+    coroutine_t* co = alloc_coroutine(sched);
+    if (!co) {
+        return -1;
+    }
+
+    prepare_context(sched, co);
+    co->fn = fn;
+    co->arg = arg;
+    co->wait_fd = -1;
+    co->wait_result = 0;
+    co->finished = 0;
+    co->ready = 0;
+    co->next = NULL;
+
+    co->live_prev = NULL;
+    co->live_next = sched->live_list;
+    if (sched->live_list) sched->live_list->live_prev = co;
+    sched->live_list = co;
+    sched->live++;
+    if (sched->live > sched->peak_live) sched->peak_live = sched->live;
+    sched->spawned++;
+
+    if (sched->current) {
+        // Spawned from inside another coroutine: start it from the loop
+        make_ready(sched, co);
+    } else {
+        resume(sched, co);
+    }
+    return 0;
+}
+
+coroutine_t* co_current(void) {
+    return thread_sched ? thread_sched->current : NULL;
+}
+
+unsigned long co_switch_count(void) {
+    return thread_sched ? thread_sched->switches : 0;
+}
+
+int co_wait_fd(int fd, unsigned int events, long long timeout_ms) {
+    co_scheduler_t* sched = thread_sched;
+    coroutine_t* co = sched->current;
+    if (sched->stopping) {
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = co;
+    if (epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        return -1;
+    }
+    co->wait_fd = fd;
+
+    if (timeout_ms >= 0) {
+        // Bring the wheel's clock up to date before arming the deadline
+        timer_wheel_advance(&sched->timers, monotonic_ms(), on_deadline, sched);
+        timer_wheel_add(&sched->timers, &co->timer, timeout_ms);
+    }
+
+    int result = park(sched);
+
+    timer_wheel_cancel(&sched->timers, &co->timer);
+    epoll_ctl(sched->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    co->wait_fd = -1;
+    return result;
+}
+
+int co_suspend(void) {
+    return park(thread_sched);
+}
+
+void co_wake(coroutine_t* co) {
+    co->wait_result = 0;
+    make_ready(thread_sched, co);
+}
+
+void co_scheduler_poll(void* arg) {
+    co_scheduler_t* sched = arg;
+    struct epoll_event events[CO_MAX_EVENTS];
+
+    int n = epoll_wait(sched->epoll_fd, events, CO_MAX_EVENTS, 0);
+    for (int i = 0; i < n; i++) {
+        coroutine_t* co = events[i].data.ptr;
+        if (!co->ready) {
+            co->wait_result = (events[i].events & (EPOLLERR | EPOLLHUP)) &&
+                              !(events[i].events & (EPOLLIN | EPOLLOUT)) ? -1 : 0;
+            make_ready(sched, co);
+        }
+    }
+
+    timer_wheel_advance(&sched->timers, monotonic_ms(), on_deadline, sched);
+    run_ready(sched);
+}
+
+int co_scheduler_next_timeout_ms(void* arg) {
+    co_scheduler_t* sched = arg;
+    if (sched->ready_head) {
+        return 0;
+    }
+    return timer_wheel_next_timeout_ms(&sched->timers, monotonic_ms());
+}
+
+void co_scheduler_destroy(co_scheduler_t* sched) {
+    sched->stopping = 1;
+
+    // Every wait now fails, so the handlers unwind and release their connections
+    while (sched->live_list) {
+        for (coroutine_t* co = sched->live_list; co; co = co->live_next) {
+            if (!co->ready) {
+                co->wait_result = -1;
+                make_ready(sched, co);
+            }
+        }
+        run_ready(sched);
+    }
+
+    while (sched->free_list) {
+        coroutine_t* co = sched->free_list;
+        sched->free_list = co->next;
+        free_coroutine(co);
+    }
+
+    close(sched->epoll_fd);
+    if (thread_sched == sched) {
+        thread_sched = NULL;
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <stddef.h>
+#include <ucontext.h>
+#include "event_loop.h"
+#include "timer_wheel.h"
+
+// ============================================================================
+// Stackful Coroutines on the Event Loop
+// ============================================================================
+// Lets request handlers stay straight-line code while running non-blocking on
+// an event loop thread. Each request runs on its own small stack (ucontext);
+// where the code would block - a socket that is not writable yet, a file load
+// on the disk pool - it parks the coroutine and returns to the loop, which
+// resumes it once the fd is ready, the deadline passes or co_wake() is called.
+// Thousands of requests can be in flight per thread, one stack each.
+
+typedef struct coroutine {
+    timer_node_t timer;             // Must be first: timer callbacks cast back to coroutine_t
+    ucontext_t ctx;
+    void* stack;                    // mmap'ed, with a guard page below
+    size_t stack_size;
+
+    void (*fn)(void* arg);
+    void* arg;
+
+    int wait_fd;                    // fd registered while parked in co_wait_fd(), or -1
+    int wait_result;                // 0 = ready/woken, -1 = deadline passed or cancelled
+    int finished;
+    int ready;                      // On the ready list
+    struct coroutine* next;         // Ready list / free list
+    struct coroutine* live_prev;    // Every started, unfinished coroutine
+    struct coroutine* live_next;
+} coroutine_t;
+
+typedef struct {
+    event_loop_t* loop;
+    int epoll_fd;                   // fds parked coroutines are waiting on
+    timer_wheel_t timers;           // Wait deadlines
+    ucontext_t main_ctx;            // The loop's own context
+    coroutine_t* current;
+    coroutine_t* ready_head;        // Woken, waiting to be resumed
+    coroutine_t* ready_tail;
+    coroutine_t* live_list;
+    coroutine_t* free_list;         // Finished coroutines kept with their stacks
+    int free_count;
+    size_t stack_size;
+    int stopping;
+
+    // Counters (loop thread only)
+    int live;
+    int peak_live;
+    unsigned long spawned;
+    unsigned long switches;
+    unsigned long timeouts;
+} co_scheduler_t;
+
+// ============================================================================
+// Coroutine Functions
+// ============================================================================
+
+/**
+ * Attach a scheduler to loop's thread; stacks are stack_kb each, clamped
+ * to 16-1024 (0 or less selects the 64 KB default)
+ * Returns: 0 on success, -1 on error
+ */
+int co_scheduler_init(co_scheduler_t* sched, event_loop_t* loop, int stack_kb);
+
+/**
+ * Run fn(arg) as a coroutine; it runs right away until it first parks or returns
+ * Returns: 0 on success, -1 if no stack could be allocated
+ */
+int co_spawn(co_scheduler_t* sched, void (*fn)(void*), void* arg);
+
+/**
+ * The coroutine running on this thread, or NULL outside any coroutine
+ */
+coroutine_t* co_current(void);
+
+/**
+ * Coroutines resumed so far on this thread (0 without a scheduler): if it
+ * has not moved, no other coroutine ran in between
+ */
+unsigned long co_switch_count(void);
+
+/**
+ * Park the current coroutine until fd has events (EPOLLIN/EPOLLOUT) or
+ * timeout_ms passes (< 0 = no deadline)
+ * Returns: 0 when ready, -1 on timeout, error or shutdown
+ */
+int co_wait_fd(int fd, unsigned int events, long long timeout_ms);
+
+/**
+ * Park the current coroutine until someone calls co_wake() on it.
+ * Shutdown also resumes it (returning -1); callers waiting for a specific
+ * event check for it and park again.
+ * Returns: 0 when woken, -1 on shutdown
+ */
+int co_suspend(void);
+
+/**
+ * Make a suspended coroutine runnable again (loop thread only)
+ */
+void co_wake(coroutine_t* co);
+
+/**
+ * Resume ready coroutines and those whose fd or deadline fired.
+ * Signature matches the event loop poller hook.
+ */
+void co_scheduler_poll(void* sched);
+
+/**
+ * Loop sleep bound: 0 while coroutines are ready, else the next deadline
+ */
+int co_scheduler_next_timeout_ms(void* sched);
+
+/**
+ * Cancel every parked coroutine (its wait returns -1), let all of them run
+ * to completion and free the stacks. Anything that may still co_wake() a
+ * coroutine (e.g. the disk pool) must be shut down first.
+ */
+void co_scheduler_destroy(co_scheduler_t* sched);
+
+#endif // COROUTINE_H
@@ -0,0 +1,247 @@
+// Disk I/O thread pool for cache-miss file loads
+
+#define _GNU_SOURCE
+#include "disk_io.h"
+#include "logger.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+#define DISK_READAHEAD_BYTES (1024 * 1024)   // Warm the page cache ahead of sendfile
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Blocking part of a cache miss: open, stat and read (or prefetch) the file
+ */
+static void load_file(disk_request_t* req) {
+    int fd = open(req->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        req->error = errno;
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        req->error = errno;
+        close(fd);
+        return;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        req->is_dir = 1;
+        close(fd);
+        return;
+    }
+    req->size = st.st_size;
+
+    // Small files are read whole, so the cache can take them straight away
+    if (req->size > 0 && (size_t)req->size <= req->read_limit) {
+        req->data = malloc(req->size);
+        off_t off = 0;
+        while (req->data && off < req->size) {
+            ssize_t n = pread(fd, req->data + off, req->size - off, off);
+            if (n > 0) {
+                off += n;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                // Short or failed read: fall back to sendfile from the open file
+                free(req->data);
+                req->data = NULL;
+            }
+        }
+        if (req->data) {
+            close(fd);
+            return;
+        }
+    }
+
+    // Large (or unreadable into memory): prefetch so sendfile rarely waits on disk
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    readahead(fd, 0, req->size < DISK_READAHEAD_BYTES ? (size_t)req->size : DISK_READAHEAD_BYTES);
+    req->file_fd = fd;
+}
+
+static void post_done(disk_io_pool_t* pool, disk_request_t* req) {
+    pthread_mutex_lock(&pool->lock);
+    req->next = pool->done;
+    pool->done = req;
+    pthread_mutex_unlock(&pool->lock);
+
+    uint64_t one = 1;
+    ssize_t ignored = write(pool->done_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+// ============================================================================
+// Disk Thread
+// ============================================================================
+static void* disk_thread(void* arg) {
+    disk_io_pool_t* pool = arg;
+
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->queue_head && !pool->shutdown) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        disk_request_t* req = pool->queue_head;
+        pool->queue_head = req->next;
+        if (!pool->queue_head) pool->queue_tail = NULL;
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+
+        update_disk_queue_depth(-1);
+
+        long long start_ns = monotonic_ns();
+        load_file(req);
+        long long done_ns = monotonic_ns();
+
+        record_disk_read((done_ns - start_ns) / 1000, (done_ns - req->submit_ns) / 1000,
+                         req->data ? (long long)req->size : 0);
+        post_done(pool, req);
+    }
+
+    return NULL;
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+int disk_io_init(disk_io_pool_t* pool, int num_threads) {
+    memset(pool, 0, sizeof(*pool));
+    if (num_threads > DISK_IO_MAX_THREADS) num_threads = DISK_IO_MAX_THREADS;
+
+    pool->done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pool->done_fd < 0) {
+        log_message("Disk I/O: eventfd failed: %s", strerror(errno));
+        return -1;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, disk_thread, pool) != 0) {
+            log_message("Disk I/O: failed to create thread %d", i);
+            break;
+        }
+        pool->num_threads++;
+    }
+    if (pool->num_threads == 0) {
+        pthread_cond_destroy(&pool->work_ready);
+        pthread_mutex_destroy(&pool->lock);
+        close(pool->done_fd);
+        return -1;
+    }
+    return 0;
+}
+
+void disk_io_submit(disk_io_pool_t* pool, disk_request_t* req) {
+    if (pool->shutdown) {
+        // Destroyed (owner thread only): nothing will run it, fail it right here
+        req->error = ECANCELED;
+        req->data = NULL;
+        req->file_fd = -1;
+        req->complete(req);
+        return;
+    }
+
+    req->error = 0;
+    req->is_dir = 0;
+    req->size = 0;
+    req->data = NULL;
+    req->file_fd = -1;
+    req->next = NULL;
+    req->submit_ns = monotonic_ns();
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->queue_tail) pool->queue_tail->next = req;
+    else pool->queue_head = req;
+    pool->queue_tail = req;
+    pool->queued++;
+    pool->pending++;
+    pthread_cond_signal(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    update_disk_queue_depth(1);
+}
+
+void disk_io_poll(void* arg) {
+    disk_io_pool_t* pool = arg;
+
+    uint64_t value;
+    while (read(pool->done_fd, &value, sizeof(value)) > 0) {
+        // drain the eventfd counter
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    disk_request_t* req = pool->done;
+    pool->done = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    while (req) {
+        disk_request_t* next = req->next;
+        // Count it as done first: the callback may free req
+        pthread_mutex_lock(&pool->lock);
+        pool->pending--;
+        pthread_mutex_unlock(&pool->lock);
+        req->complete(req);
+        req = next;
+    }
+}
+
+int disk_io_fd(disk_io_pool_t* pool) {
+    return pool->done_fd;
+}
+
+int disk_io_pending(disk_io_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    int pending = pool->pending;
+    pthread_mutex_unlock(&pool->lock);
+    return pending;
+}
+
+void disk_io_destroy(disk_io_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    // Cancel what never reached a disk thread, then deliver everything
+    disk_request_t* req = pool->queue_head;
+    pool->queue_head = pool->queue_tail = NULL;
+    while (req) {
+        disk_request_t* next = req->next;
+        req->error = ECANCELED;
+        update_disk_queue_depth(-1);
+        post_done(pool, req);
+        req = next;
+    }
+    disk_io_poll(pool);
+
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+    close(pool->done_fd);
+}
@@ -0,0 +1,89 @@
+#ifndef DISK_IO_H
+#define DISK_IO_H
+
+#include <pthread.h>
+#include <sys/types.h>
+#include "file_cache.h"
+
+// ============================================================================
+// Async Disk I/O Pool
+// ============================================================================
+// Cache misses are not read on the request path. The request thread submits a
+// load request and moves on; disk threads do the blocking open/fstat/read and
+// post the finished request back. The owner (the worker's event loop) runs
+// each request's complete() callback, which sends the response.
+
+#define DISK_IO_MAX_THREADS 16
+
+typedef struct disk_request {
+    // Input
+    char path[MAX_PATH_LEN];
+    size_t read_limit;              // Read into memory if size <= this, else open for sendfile
+    void (*complete)(struct disk_request* req);
+
+    // Result
+    int error;                      // 0 or errno
+    int is_dir;
+    off_t size;
+    char* data;                     // malloc'ed content (if read), freed by the callback
+    int file_fd;                    // Open file (if not read), closed by the callback
+
+    long long submit_ns;
+    struct disk_request* next;
+} disk_request_t;
+
+typedef struct {
+    pthread_t threads[DISK_IO_MAX_THREADS];
+    int num_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    disk_request_t* queue_head;     // FIFO of submitted requests
+    disk_request_t* queue_tail;
+    disk_request_t* done;           // Finished, waiting for disk_io_poll()
+    int queued;
+    int pending;                    // Submitted and not yet completed
+    int shutdown;
+
+    int done_fd;                    // eventfd signalled when requests finish
+} disk_io_pool_t;
+
+// ============================================================================
+// Disk I/O Functions
+// ============================================================================
+
+/**
+ * Start num_threads disk threads
+ * Returns: 0 on success, -1 on error
+ */
+int disk_io_init(disk_io_pool_t* pool, int num_threads);
+
+/**
+ * Queue a load request (thread-safe); req must stay valid until complete().
+ * After disk_io_destroy() it completes at once with ECANCELED.
+ */
+void disk_io_submit(disk_io_pool_t* pool, disk_request_t* req);
+
+/**
+ * Run complete() for every finished request (owner thread, non-blocking).
+ * Signature matches the event loop poller hook.
+ */
+void disk_io_poll(void* pool);
+
+/**
+ * Readable when finished requests are waiting for disk_io_poll()
+ */
+int disk_io_fd(disk_io_pool_t* pool);
+
+/**
+ * Number of requests submitted and not yet completed
+ */
+int disk_io_pending(disk_io_pool_t* pool);
+
+/**
+ * Stop the disk threads; requests still queued or finished are completed
+ * with ECANCELED so their callbacks can release the connection
+ */
+void disk_io_destroy(disk_io_pool_t* pool);
+
+#endif // DISK_IO_H
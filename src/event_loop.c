@@ -0,0 +1,483 @@
+// Per-worker epoll event loop with timer-wheel connection deadlines
+
+#define _GNU_SOURCE
+#include "event_loop.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
+static loop_conn_t* conn_alloc(event_loop_t* loop) {
+    loop_conn_t* conn = loop->free_conns;
+    if (conn) {
+        loop->free_conns = conn->next_free;
+    } else {
+        conn = malloc(sizeof(loop_conn_t));
+        if (!conn) return NULL;
+    }
+    memset(conn, 0, sizeof(*conn));
+    return conn;
+}
+
+/**
+ * Stop watching a connection and recycle its state (fd stays open)
+ */
+static void conn_release(event_loop_t* loop, loop_conn_t* conn) {
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    timer_wheel_cancel(&loop->timers, &conn->timer);
+
+    if (conn->prev) conn->prev->next = conn->next;
+    else loop->live = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    loop->live_count--;
+
+    conn->next_free = loop->free_conns;
+    loop->free_conns = conn;
+}
+
+static void conn_close(event_loop_t* loop, loop_conn_t* conn) {
+    int fd = conn->fd;
+    conn_release(loop, conn);
+    close(fd);
+}
+
+static void watch_conn(event_loop_t* loop, int client_fd, loop_conn_state_t state) {
+    // Draining: a connection back at a request boundary is closed, not kept
+    if (loop->draining && state == LOOP_CONN_IDLE) {
+        loop->drain_closed_idle++;
+        close(client_fd);
+        return;
+    }
+
+    loop_conn_t* conn = conn_alloc(loop);
+    if (!conn) {
+        close(client_fd);
+        return;
+    }
+    conn->fd = client_fd;
+    conn->state = state;
+
+    // Edge-triggered: a partial header stays unread in the socket (it is only
+    // peeked), so level-triggered epoll would report it on every pass and
+    // spin the worker; wake again only when more bytes arrive. Adding an fd
+    // with bytes already pending still reports it once.
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = conn;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+        conn->next_free = loop->free_conns;
+        loop->free_conns = conn;
+        close(client_fd);
+        return;
+    }
+
+    conn->next = loop->live;
+    if (loop->live) loop->live->prev = conn;
+    loop->live = conn;
+    loop->live_count++;
+
+    timer_wheel_add(&loop->timers, &conn->timer,
+                    state == LOOP_CONN_IDLE ? loop->keepalive_timeout_ms : loop->header_timeout_ms);
+}
+
+/**
+ * Deadline passed: slow header senders get a 408, idle keep-alives are closed
+ */
+static void on_timer(timer_node_t* node, void* ctx) {
+    event_loop_t* loop = ctx;
+    loop_conn_t* conn = (loop_conn_t*)node;
+
+    if (conn->state == LOOP_CONN_HEADERS) {
+        static const char response[] =
+            "HTTP/1.1 408 Request Timeout\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n"
+            "\r\n";
+        send(conn->fd, response, sizeof(response) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+        loop->header_timeouts++;
+
+        // Consume the partial request so close() does not turn into a reset
+        // that discards the 408
+        while (recv(conn->fd, loop->peek_buf, LOOP_PEEK_SIZE, MSG_DONTWAIT) > 0) {
+        }
+    } else {
+        loop->idle_timeouts++;
+    }
+    conn_close(loop, conn);
+}
+
+static void conn_readable(event_loop_t* loop, loop_conn_t* conn, uint32_t events) {
+    ssize_t n = recv(conn->fd, loop->peek_buf, LOOP_PEEK_SIZE - 1, MSG_PEEK);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (n <= 0) {
+        conn_close(loop, conn);
+        return;
+    }
+    loop->peek_buf[n] = '\0';
+
+    // Not all headers yet: keep waiting (a full peek buffer goes to the
+    // handler anyway, which rejects it), unless the client stopped sending
+    if (!strstr(loop->peek_buf, "\r\n\r\n") && n < LOOP_PEEK_SIZE - 1) {
+        if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            conn_close(loop, conn);
+            return;
+        }
+        if (conn->state == LOOP_CONN_IDLE) {
+            conn->state = LOOP_CONN_HEADERS;
+            timer_wheel_add(&loop->timers, &conn->timer, loop->header_timeout_ms);
+        }
+        return;
+    }
+
+    int fd = conn->fd;
+    conn_release(loop, conn);
+    loop->dispatch(loop->ctx, fd, loop->peek_buf, (size_t)n);
+}
+
+static void accept_ready(event_loop_t* loop) {
+    if (loop->draining) {
+        return;
+    }
+
+    // Bounded batch so one busy listener cannot starve other events
+    for (int i = 0; i < LOOP_MAX_EVENTS; i++) {
+        int client_fd = accept4(loop->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                log_message("Event loop: accept error: %s", strerror(errno));
+            }
+            return;
+        }
+        loop->accepted++;
+        watch_conn(loop, client_fd, LOOP_CONN_HEADERS);
+    }
+}
+
+static void drain_returned(event_loop_t* loop) {
+    uint64_t value;
+    while (read(loop->wake_fd, &value, sizeof(value)) > 0) {
+        // drain the eventfd counter
+    }
+
+    pthread_mutex_lock(&loop->return_lock);
+    for (int i = 0; i < loop->returned_count; i++) {
+        watch_conn(loop, loop->returned[i], LOOP_CONN_IDLE);
+    }
+    loop->returned_count = 0;
+    pthread_mutex_unlock(&loop->return_lock);
+}
+
+static void close_on_shutdown(timer_node_t* node, void* ctx) {
+    conn_close((event_loop_t*)ctx, (loop_conn_t*)node);
+}
+
+// ============================================================================
+// Initialize Event Loop
+// ============================================================================
+int event_loop_init(event_loop_t* loop, int listen_fd, const server_config_t* config,
+                    loop_dispatch_fn dispatch, void* ctx) {
+    memset(loop, 0, sizeof(*loop));
+    loop->listen_fd = listen_fd;
+    loop->aux_fd = -1;
+    loop->ticker_fd = -1;
+    loop->dispatch = dispatch;
+    loop->ctx = ctx;
+    loop->header_timeout_ms = config->header_timeout_seconds * 1000;
+    loop->keepalive_timeout_ms = config->keepalive_timeout_seconds * 1000;
+    timer_wheel_init(&loop->timers, LOOP_TICK_MS, monotonic_ms());
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        log_message("Event loop: epoll_create1 failed: %s", strerror(errno));
+        return -1;
+    }
+
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->wake_fd < 0) {
+        log_message("Event loop: eventfd failed: %s", strerror(errno));
+        close(loop->epoll_fd);
+        return -1;
+    }
+
+    struct epoll_event ev;
+    // Workers share the listener: only wake one of them per connection
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = &loop->listen_fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+        log_message("Event loop: cannot watch listener: %s", strerror(errno));
+        close(loop->wake_fd);
+        close(loop->epoll_fd);
+        return -1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &loop->wake_fd;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev);
+
+    pthread_mutex_init(&loop->return_lock, NULL);
+    return 0;
+}
+
+int event_loop_set_aux(event_loop_t* loop, int fd, loop_aux_fn cb) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &loop->aux_fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        return -1;
+    }
+    loop->aux_fd = fd;
+    loop->aux_cb = cb;
+    return 0;
+}
+
+int event_loop_set_ticker(event_loop_t* loop, int interval_ms, loop_aux_fn cb) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &loop->ticker_fd;
+    if (timerfd_settime(fd, 0, &spec, NULL) < 0 ||
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd);
+        return -1;
+    }
+    loop->ticker_fd = fd;
+    loop->ticker_cb = cb;
+    return 0;
+}
+
+int event_loop_add_poller(event_loop_t* loop, int fd, loop_poll_fn run,
+                          loop_timeout_fn next_timeout, void* ctx) {
+    if (loop->poller_count == LOOP_MAX_POLLERS) {
+        return -1;
+    }
+
+    loop_poller_t* poller = &loop->pollers[loop->poller_count];
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = poller;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        return -1;
+    }
+    poller->fd = fd;
+    poller->run = run;
+    poller->next_timeout = next_timeout;
+    poller->ctx = ctx;
+    loop->poller_count++;
+    return 0;
+}
+
+// ============================================================================
+// Add / Return Connections
+// ============================================================================
+void event_loop_add(event_loop_t* loop, int client_fd) {
+    watch_conn(loop, client_fd, LOOP_CONN_HEADERS);
+}
+
+void event_loop_add_idle(event_loop_t* loop, int client_fd) {
+    watch_conn(loop, client_fd, LOOP_CONN_IDLE);
+}
+
+void event_loop_return(event_loop_t* loop, int client_fd) {
+    pthread_mutex_lock(&loop->return_lock);
+    if (loop->returned_count == loop->returned_cap) {
+        int new_cap = loop->returned_cap ? loop->returned_cap * 2 : 64;
+        int* grown = realloc(loop->returned, sizeof(int) * new_cap);
+        if (!grown) {
+            pthread_mutex_unlock(&loop->return_lock);
+            close(client_fd);
+            return;
+        }
+        loop->returned = grown;
+        loop->returned_cap = new_cap;
+    }
+    loop->returned[loop->returned_count++] = client_fd;
+    pthread_mutex_unlock(&loop->return_lock);
+
+    uint64_t one = 1;
+    ssize_t ignored = write(loop->wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+// ============================================================================
+// Run Event Loop
+// ============================================================================
+/**
+ * One pass: wait up to max_wait_ms (-1 = until the next deadline), handle
+ * ready events, then expire due timers
+ */
+static void run_once(event_loop_t* loop, int max_wait_ms) {
+    struct epoll_event events[LOOP_MAX_EVENTS];
+
+    int timeout = timer_wheel_next_timeout_ms(&loop->timers, monotonic_ms());
+    if (max_wait_ms >= 0 && (timeout < 0 || timeout > max_wait_ms)) {
+        timeout = max_wait_ms;
+    }
+    for (int i = 0; i < loop->poller_count; i++) {
+        loop_poller_t* poller = &loop->pollers[i];
+        int poller_wait = poller->next_timeout ? poller->next_timeout(poller->ctx) : -1;
+        if (poller_wait >= 0 && (timeout < 0 || timeout > poller_wait)) {
+            timeout = poller_wait;
+        }
+    }
+    int n = epoll_wait(loop->epoll_fd, events, LOOP_MAX_EVENTS, timeout);
+    if (n < 0) {
+        if (errno != EINTR) {
+            log_message("Event loop: epoll_wait error: %s", strerror(errno));
+        }
+        n = 0;
+    }
+
+    // An empty wheel is not advanced while epoll sleeps; resync its clock
+    // before any new deadline is armed
+    if (loop->timers.count == 0) {
+        timer_wheel_advance(&loop->timers, monotonic_ms(), on_timer, loop);
+    }
+
+    for (int i = 0; i < n; i++) {
+        void* tag = events[i].data.ptr;
+        if (tag == &loop->listen_fd) {
+            accept_ready(loop);
+        } else if (tag == &loop->wake_fd) {
+            drain_returned(loop);
+        } else if (tag == &loop->aux_fd) {
+            loop->aux_cb(loop->ctx);
+        } else if (tag == &loop->ticker_fd) {
+            uint64_t expirations;
+            if (read(loop->ticker_fd, &expirations, sizeof(expirations)) > 0) {
+                loop->ticker_cb(loop->ctx);
+            }
+        } else if (tag >= (void*)loop->pollers &&
+                   tag < (void*)(loop->pollers + LOOP_MAX_POLLERS)) {
+            // Handled below, once per pass
+        } else {
+            conn_readable(loop, (loop_conn_t*)tag, events[i].events);
+        }
+    }
+
+    for (int i = 0; i < loop->poller_count; i++) {
+        loop->pollers[i].run(loop->pollers[i].ctx);
+    }
+
+    // Deadlines are processed after events so a connection that just
+    // completed its request is never timed out in the same pass
+    timer_wheel_advance(&loop->timers, monotonic_ms(), on_timer, loop);
+}
+
+void event_loop_run(event_loop_t* loop, volatile sig_atomic_t* keep_running) {
+    while (*keep_running) {
+        run_once(loop, -1);
+    }
+}
+
+// ============================================================================
+// Drain Event Loop
+// ============================================================================
+int event_loop_drain(event_loop_t* loop, int timeout_ms, loop_idle_fn done, void* ctx) {
+    long long deadline = monotonic_ms() + timeout_ms;
+
+    // Stop accepting: take every connection the kernel has already queued
+    // (with TCP_DEFER_ACCEPT those clients have sent their request), then
+    // close our copy of the listener. Queued connections would otherwise be
+    // reset when the last copy closes at exit; once closed, SO_REUSEPORT
+    // hashes new ones to listeners that are still open.
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, loop->listen_fd, NULL);
+    int client_fd;
+    while ((client_fd = accept4(loop->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0 ||
+           errno == EINTR) {
+        if (client_fd >= 0) {
+            loop->accepted++;
+            loop->drain_accepted++;
+            watch_conn(loop, client_fd, LOOP_CONN_HEADERS);
+        }
+    }
+    close(loop->listen_fd);
+    loop->listen_fd = -1;
+    loop->draining = 1;
+
+    // Idle keep-alive connections are between requests: close them now
+    loop_conn_t* conn = loop->live;
+    while (conn) {
+        loop_conn_t* next = conn->next;
+        if (conn->state == LOOP_CONN_IDLE) {
+            loop->drain_closed_idle++;
+            conn_close(loop, conn);
+        }
+        conn = next;
+    }
+
+    while (1) {
+        pthread_mutex_lock(&loop->return_lock);
+        int returned = loop->returned_count;
+        pthread_mutex_unlock(&loop->return_lock);
+
+        if (loop->live_count == 0 && returned == 0 && done(ctx)) {
+            return 0;
+        }
+
+        long long remaining = deadline - monotonic_ms();
+        if (remaining <= 0) {
+            return -1;
+        }
+        run_once(loop, remaining < LOOP_TICK_MS ? (int)remaining : LOOP_TICK_MS);
+    }
+}
+
+// ============================================================================
+// Destroy Event Loop
+// ============================================================================
+void event_loop_destroy(event_loop_t* loop) {
+    timer_wheel_expire_all(&loop->timers, close_on_shutdown, loop);
+
+    pthread_mutex_lock(&loop->return_lock);
+    for (int i = 0; i < loop->returned_count; i++) {
+        close(loop->returned[i]);
+    }
+    loop->returned_count = 0;
+    free(loop->returned);
+    loop->returned = NULL;
+    pthread_mutex_unlock(&loop->return_lock);
+    pthread_mutex_destroy(&loop->return_lock);
+
+    loop_conn_t* conn = loop->free_conns;
+    while (conn) {
+        loop_conn_t* next = conn->next_free;
+        free(conn);
+        conn = next;
+    }
+    loop->free_conns = NULL;
+
+    if (loop->ticker_fd >= 0) {
+        close(loop->ticker_fd);
+        loop->ticker_fd = -1;
+    }
+    close(loop->wake_fd);
+    close(loop->epoll_fd);
+}
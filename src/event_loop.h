@@ -0,0 +1,177 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include "config.h"
+#include "timer_wheel.h"
+
+// ============================================================================
+// Worker Event Loop
+// ============================================================================
+// Runs on the worker's acceptor thread. Non-blocking connections wait here,
+// not in a pool thread, until their request headers have fully arrived
+// (header-read deadline) or between keep-alive requests (idle deadline).
+// Complete requests are handed to the dispatch callback; deadlines are kept
+// in a hierarchical timer wheel instead of per-socket SO_RCVTIMEO/SO_SNDTIMEO.
+
+#define LOOP_TICK_MS 100
+#define LOOP_PEEK_SIZE 8192
+#define LOOP_MAX_EVENTS 64
+#define LOOP_MAX_POLLERS 4
+
+typedef enum {
+    LOOP_CONN_HEADERS,      // Waiting for the rest of the request headers
+    LOOP_CONN_IDLE          // Keep-alive: waiting for the next request
+} loop_conn_state_t;
+
+typedef struct loop_conn {
+    timer_node_t timer;     // Must be first: timer callbacks cast back to loop_conn_t
+    int fd;
+    loop_conn_state_t state;
+    struct loop_conn* prev;         // Connections currently watched by the loop
+    struct loop_conn* next;
+    struct loop_conn* next_free;
+} loop_conn_t;
+
+/**
+ * Called with a connection whose request headers are complete.
+ * request/len is a peeked (not consumed) copy of the pending bytes.
+ * The callee owns client_fd from here on.
+ */
+typedef void (*loop_dispatch_fn)(void* ctx, int client_fd, const char* request, size_t len);
+
+/**
+ * Drain completion check: returns non-zero once no queued or in-flight
+ * work remains outside the loop
+ */
+typedef int (*loop_idle_fn)(void* ctx);
+
+/**
+ * Secondary event source run on the loop thread: called every pass without
+ * blocking; next_timeout bounds how long the loop may sleep (-1 = no limit)
+ */
+typedef void (*loop_poll_fn)(void* ctx);
+typedef int (*loop_timeout_fn)(void* ctx);
+
+typedef struct {
+    int fd;                         // Readable when the poller has work
+    loop_poll_fn run;
+    loop_timeout_fn next_timeout;   // May be NULL
+    void* ctx;
+} loop_poller_t;
+
+/**
+ * Called when the auxiliary fd (e.g. the affinity socket) is readable
+ */
+typedef void (*loop_aux_fn)(void* ctx);
+
+typedef struct {
+    int epoll_fd;
+    int listen_fd;
+    int wake_fd;                    // eventfd signalled by event_loop_return()
+    int aux_fd;
+    loop_aux_fn aux_cb;
+    int ticker_fd;                  // timerfd for the periodic callback
+    loop_aux_fn ticker_cb;
+
+    loop_poller_t pollers[LOOP_MAX_POLLERS];
+    int poller_count;
+
+    loop_dispatch_fn dispatch;
+    void* ctx;
+
+    timer_wheel_t timers;
+    int header_timeout_ms;
+    int keepalive_timeout_ms;
+
+    // Keep-alive connections handed back by pool threads
+    pthread_mutex_t return_lock;
+    int* returned;
+    int returned_count;
+    int returned_cap;
+
+    loop_conn_t* live;
+    int live_count;
+    loop_conn_t* free_conns;
+    char peek_buf[LOOP_PEEK_SIZE];
+
+    // Counters (loop thread only)
+    unsigned long accepted;
+    unsigned long header_timeouts;
+    unsigned long idle_timeouts;
+
+    // Drain mode: no new accepts, keep-alive connections closed at the boundary
+    int draining;
+    unsigned long drain_accepted;   // Taken from the accept queue as the drain began
+    unsigned long drain_closed_idle;
+} event_loop_t;
+
+// ============================================================================
+// Event Loop Functions
+// ============================================================================
+
+/**
+ * Initialize the loop around a non-blocking listening socket
+ * Returns: 0 on success, -1 on error
+ */
+int event_loop_init(event_loop_t* loop, int listen_fd, const server_config_t* config,
+                    loop_dispatch_fn dispatch, void* ctx);
+
+/**
+ * Watch an extra fd and call cb when it is readable
+ */
+int event_loop_set_aux(event_loop_t* loop, int fd, loop_aux_fn cb);
+
+/**
+ * Call cb(ctx) every interval_ms from the loop thread
+ * Returns: 0 on success, -1 on error
+ */
+int event_loop_set_ticker(event_loop_t* loop, int interval_ms, loop_aux_fn cb);
+
+/**
+ * Attach a secondary event source (e.g. an inline response writer)
+ * Returns: 0 on success, -1 if the fd cannot be watched or all slots are used
+ */
+int event_loop_add_poller(event_loop_t* loop, int fd, loop_poll_fn run,
+                          loop_timeout_fn next_timeout, void* ctx);
+
+/**
+ * Start waiting for a request on client_fd (loop thread only)
+ */
+void event_loop_add(event_loop_t* loop, int client_fd);
+
+/**
+ * Keep-alive from the loop thread itself: wait for the next request under
+ * the idle deadline, without the cross-thread hand-back
+ */
+void event_loop_add_idle(event_loop_t* loop, int client_fd);
+
+/**
+ * Hand a keep-alive connection back to wait for its next request
+ * (thread-safe, called by pool threads)
+ */
+void event_loop_return(event_loop_t* loop, int client_fd);
+
+/**
+ * Run until *keep_running becomes 0
+ */
+void event_loop_run(event_loop_t* loop, volatile sig_atomic_t* keep_running);
+
+/**
+ * Stop accepting (connections already queued on the listener are taken, then
+ * the listener is closed), close idle keep-alive connections and keep serving until
+ * no connection waits in the loop and done(ctx) reports no outstanding work,
+ * or until timeout_ms passes
+ * Returns: 0 when fully drained, -1 if the deadline passed first
+ * (loop->live_count then holds the connections still waiting for headers)
+ */
+int event_loop_drain(event_loop_t* loop, int timeout_ms, loop_idle_fn done, void* ctx);
+
+/**
+ * Close every connection still held by the loop and free resources
+ */
+void event_loop_destroy(event_loop_t* loop);
+
+#endif // EVENT_LOOP_H
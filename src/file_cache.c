@@ -1,6 +1,7 @@
 // LRU File Cache Implementation for Worker Processes
 
 #include "file_cache.h"
+#include "lock_stats.h"
 #include "logger.h"
 #include <stdlib.h>
 #include <string.h>
@@ -62,35 +63,44 @@ static cache_entry_t* find_entry(file_cache_t* cache, const char* path) {
 }
 
 /**
- * Remove the least recently used entry (from tail)
+ * Take an entry out of the cache; a pinned one is only marked retired and
+ * freed by the last file_cache_release
  */
-static void evict_lru(file_cache_t* cache) {
-    if (!cache->tail) {
-        return;
-    }
-    
-    cache_entry_t* lru = cache->tail;
-    
-    // Remove from list
-    if (lru->prev) {
-        lru->prev->next = NULL;
+static void remove_entry(file_cache_t* cache, cache_entry_t* entry) {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
     }
-    cache->tail = lru->prev;
-    
-    if (cache->head == lru) {
-        cache->head = NULL;
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
     }
     
     // Update cache statistics
-    cache->total_size -= lru->content_size;
+    cache->total_size -= entry->content_size;
     cache->entry_count--;
     
-    log_message("Cache: Evicted LRU entry '%s' (%zu bytes)", 
-                lru->path, lru->content_size);
+    if (entry->refs > 0) {
+        entry->retired = 1;
+        return;
+    }
+    free(entry->content);
+    free(entry);
+}
+
+/**
+ * Remove the least recently used entry (from tail)
+ */
+static void evict_lru(file_cache_t* cache) {
+    if (!cache->tail) {
+        return;
+    }
     
-    // Free memory
-    free(lru->content);
-    free(lru);
+    log_message("Cache: Evicted LRU entry '%s' (%zu bytes)", 
+                cache->tail->path, cache->tail->content_size);
+    remove_entry(cache, cache->tail);
 }
 
 /**
@@ -103,6 +113,19 @@ static void make_space(file_cache_t* cache, size_t needed_size) {
     }
 }
 
+// A cache owned by one thread (thread-per-core mode) skips its rwlock
+static void cache_write_lock(file_cache_t* cache) {
+    if (!cache->single_owner) timed_wrlock(&cache->lock, LOCK_CACHE_WRITE);
+}
+
+static void cache_read_lock(file_cache_t* cache) {
+    if (!cache->single_owner) timed_rdlock(&cache->lock, LOCK_CACHE_READ);
+}
+
+static void cache_unlock(file_cache_t* cache) {
+    if (!cache->single_owner) pthread_rwlock_unlock(&cache->lock);
+}
+
 // ============================================================================
 // Public API Implementation
 // ============================================================================
@@ -117,6 +140,7 @@ int file_cache_init(file_cache_t* cache, int max_size_mb) {
     cache->total_size = 0;
     cache->max_size = max_size_mb * 1024 * 1024;  // Convert MB to bytes
     cache->entry_count = 0;
+    cache->single_owner = 0;
     
     if (pthread_rwlock_init(&cache->lock, NULL) != 0) {
         log_message("Cache: Failed to initialize rwlock");
@@ -129,12 +153,16 @@ int file_cache_init(file_cache_t* cache, int max_size_mb) {
     return 0;
 }
 
+void file_cache_set_single_owner(file_cache_t* cache) {
+    cache->single_owner = 1;
+}
+
 void file_cache_destroy(file_cache_t* cache) {
     if (!cache) {
         return;
     }
     
-    pthread_rwlock_wrlock(&cache->lock);
+    cache_write_lock(cache);
     
     // Free all entries
     cache_entry_t* current = cache->head;
@@ -150,25 +178,25 @@ void file_cache_destroy(file_cache_t* cache) {
     cache->total_size = 0;
     cache->entry_count = 0;
     
-    pthread_rwlock_unlock(&cache->lock);
+    cache_unlock(cache);
     pthread_rwlock_destroy(&cache->lock);
     
     log_message("Cache: Destroyed");
 }
 
-int file_cache_get(file_cache_t* cache, const char* path, 
-                   const char** content, size_t* content_size) {
+cache_entry_t* file_cache_get(file_cache_t* cache, const char* path,
+                              const char** content, size_t* content_size) {
     if (!cache || !path || !content || !content_size) {
-        return -1;
+        return NULL;
     }
     
-    pthread_rwlock_wrlock(&cache->lock);  // Write lock for LRU update
+    cache_write_lock(cache);  // Write lock for LRU update
     
     cache_entry_t* entry = find_entry(cache, path);
     
     if (!entry) {
-        pthread_rwlock_unlock(&cache->lock);
-        return -1;  // Cache miss
+        cache_unlock(cache);
+        return NULL;  // Cache miss
     }
     
     // Update access time and move to front
@@ -178,12 +206,26 @@ int file_cache_get(file_cache_t* cache, const char* path,
     // Return the cached content (caller should NOT free this)
     *content = entry->content;
     *content_size = entry->content_size;
+    entry->refs++;
     
-    pthread_rwlock_unlock(&cache->lock);
+    cache_unlock(cache);
     
     log_message("Cache: HIT '%s' (%zu bytes)", path, *content_size);
     
-    return 0;  // Cache hit
+    return entry;  // Cache hit
+}
+
+void file_cache_release(file_cache_t* cache, cache_entry_t* entry) {
+    if (!cache || !entry) {
+        return;
+    }
+    
+    cache_write_lock(cache);
+    if (--entry->refs == 0 && entry->retired) {
+        free(entry->content);
+        free(entry);
+    }
+    cache_unlock(cache);
 }
 
 int file_cache_put(file_cache_t* cache, const char* path, 
@@ -204,15 +246,20 @@ int file_cache_put(file_cache_t* cache, const char* path,
         return -1;
     }
     
-    pthread_rwlock_wrlock(&cache->lock);
+    cache_write_lock(cache);
     
     // Check if entry already exists
     cache_entry_t* existing = find_entry(cache, path);
+    if (existing && existing->refs > 0) {
+        // Still being sent: retire it and insert the new content as a new entry
+        remove_entry(cache, existing);
+        existing = NULL;
+    }
     if (existing) {
         // Update existing entry
         char* new_content = malloc(content_size);
         if (!new_content) {
-            pthread_rwlock_unlock(&cache->lock);
+            cache_unlock(cache);
             return -1;
         }
         
@@ -229,7 +276,7 @@ int file_cache_put(file_cache_t* cache, const char* path,
         
         move_to_front(cache, existing);
         
-        pthread_rwlock_unlock(&cache->lock);
+        cache_unlock(cache);
         
         log_message("Cache: UPDATED '%s' (%zu bytes)", path, content_size);
         return 0;
@@ -241,14 +288,14 @@ int file_cache_put(file_cache_t* cache, const char* path,
     // Create new entry
     cache_entry_t* new_entry = malloc(sizeof(cache_entry_t));
     if (!new_entry) {
-        pthread_rwlock_unlock(&cache->lock);
+        cache_unlock(cache);
         return -1;
     }
     
     new_entry->content = malloc(content_size);
     if (!new_entry->content) {
         free(new_entry);
-        pthread_rwlock_unlock(&cache->lock);
+        cache_unlock(cache);
         return -1;
     }
     
@@ -258,6 +305,8 @@ int file_cache_put(file_cache_t* cache, const char* path,
     memcpy(new_entry->content, content, content_size);
     new_entry->content_size = content_size;
     new_entry->last_access = time(NULL);
+    new_entry->refs = 0;
+    new_entry->retired = 0;
     new_entry->prev = NULL;
     new_entry->next = cache->head;
     
@@ -275,7 +324,7 @@ int file_cache_put(file_cache_t* cache, const char* path,
     cache->total_size += content_size;
     cache->entry_count++;
     
-    pthread_rwlock_unlock(&cache->lock);
+    cache_unlock(cache);
     
     log_message("Cache: PUT '%s' (%zu bytes) - Total: %d entries, %zu/%zu bytes", 
                 path, content_size, cache->entry_count, 
@@ -289,7 +338,7 @@ void file_cache_stats(file_cache_t* cache, int* entries, size_t* total_size) {
         return;
     }
     
-    pthread_rwlock_rdlock(&cache->lock);
+    cache_read_lock(cache);
     
     if (entries) {
         *entries = cache->entry_count;
@@ -298,5 +347,5 @@ void file_cache_stats(file_cache_t* cache, int* entries, size_t* total_size) {
         *total_size = cache->total_size;
     }
     
-    pthread_rwlock_unlock(&cache->lock);
+    cache_unlock(cache);
 }
@@ -19,6 +19,8 @@ typedef struct cache_entry {
     char* content;                  // File content
     size_t content_size;            // Size of content in bytes
     time_t last_access;             // Last access time (for LRU)
+    int refs;                       // Senders still using content (see file_cache_get)
+    int retired;                    // Out of the cache; freed when refs drops to 0
     struct cache_entry* prev;       // Doubly-linked list for LRU
     struct cache_entry* next;
 } cache_entry_t;
@@ -33,6 +35,7 @@ typedef struct {
     size_t max_size;                // Maximum cache size in bytes
     int entry_count;                // Number of entries
     pthread_rwlock_t lock;          // Reader-writer lock
+    int single_owner;               // Only one thread uses this cache: no locking
 } file_cache_t;
 
 // ============================================================================
@@ -44,16 +47,28 @@ typedef struct {
  */
 int file_cache_init(file_cache_t* cache, int max_size_mb);
 
+/**
+ * Mark the cache as used by a single thread only (skips the rwlock)
+ */
+void file_cache_set_single_owner(file_cache_t* cache);
+
 /**
  * Destroy the file cache and free all resources
  */
 void file_cache_destroy(file_cache_t* cache);
 
 /**
- * Get a file from the cache
+ * Get a file from the cache, pinned so that eviction or replacement cannot
+ * free its content while the caller is still sending it
+ * Returns: the pinned entry (hand it to file_cache_release), NULL on a miss
+ */
+cache_entry_t* file_cache_get(file_cache_t* cache, const char* path,
+                              const char** content, size_t* content_size);
+
+/**
+ * Unpin an entry returned by file_cache_get
  */
-int file_cache_get(file_cache_t* cache, const char* path, 
-                   const char** content, size_t* content_size);
+void file_cache_release(file_cache_t* cache, cache_entry_t* entry);
 
 /**
  * Put a file into the cache
@@ -0,0 +1,107 @@
+// Log-linear latency histogram
+
+#include "histogram.h"
+
+#define HIST_MAX_VALUE ((1LL << HIST_MAX_BITS) - 1)
+
+// ============================================================================
+// Bucket Layout
+// ============================================================================
+// Group 0 holds 0..15 one per bucket. Group g >= 1 covers [2^(g+3), 2^(g+4))
+// in 16 sub-buckets of width 2^(g-1).
+
+int hist_bucket_index(long long value_us) {
+    if (value_us < 0) value_us = 0;
+    if (value_us > HIST_MAX_VALUE) value_us = HIST_MAX_VALUE;
+    if (value_us < HIST_SUB_COUNT) {
+        return (int)value_us;
+    }
+
+    int msb = 63 - __builtin_clzll((unsigned long long)value_us);
+    int group = msb - HIST_SUB_BITS + 1;
+    int sub = (int)((value_us >> (msb - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+    return group * HIST_SUB_COUNT + sub;
+}
+
+long long hist_bucket_upper(int index) {
+    int group = index / HIST_SUB_COUNT;
+    int sub = index % HIST_SUB_COUNT;
+    if (group == 0) {
+        return sub;
+    }
+    int shift = group - 1;
+    long long base = (long long)(HIST_SUB_COUNT + sub) << shift;
+    return base + (1LL << shift) - 1;
+}
+
+// ============================================================================
+// Recording
+// ============================================================================
+void hist_record_local(latency_hist_t* hist, long long value_us) {
+    int index = hist_bucket_index(value_us);
+    __atomic_store_n(&hist->counts[index], hist->counts[index] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->total, hist->total + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->sum_us, hist->sum_us + value_us, __ATOMIC_RELAXED);
+    if (value_us > hist->max_us) {
+        __atomic_store_n(&hist->max_us, value_us, __ATOMIC_RELAXED);
+    }
+}
+
+void hist_record_shared(latency_hist_t* hist, long long value_us) {
+    __atomic_fetch_add(&hist->counts[hist_bucket_index(value_us)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->total, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum_us, value_us, __ATOMIC_RELAXED);
+
+    long long current = __atomic_load_n(&hist->max_us, __ATOMIC_RELAXED);
+    while (value_us > current &&
+           !__atomic_compare_exchange_n(&hist->max_us, &current, value_us, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // current was reloaded by the failed exchange
+    }
+}
+
+// ============================================================================
+// Reading
+// ============================================================================
+void hist_merge(latency_hist_t* dst, const latency_hist_t* src) {
+    long long total = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        long long count = __atomic_load_n(&src->counts[i], __ATOMIC_RELAXED);
+        dst->counts[i] += count;
+        total += count;
+    }
+    // Derive the total from the buckets so percentiles never overrun them
+    dst->total += total;
+    dst->sum_us += __atomic_load_n(&src->sum_us, __ATOMIC_RELAXED);
+    long long max_us = __atomic_load_n(&src->max_us, __ATOMIC_RELAXED);
+    if (max_us > dst->max_us) {
+        dst->max_us = max_us;
+    }
+}
+
+long long hist_percentile(const latency_hist_t* hist, double q) {
+    if (hist->total <= 0) {
+        return 0;
+    }
+    long long rank = (long long)(q * hist->total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > hist->total) rank = hist->total;
+
+    long long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            long long upper = hist_bucket_upper(i);
+            return upper < hist->max_us ? upper : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
+
+long long hist_count_at_or_below(const latency_hist_t* hist, long long limit_us) {
+    long long count = 0;
+    for (int i = 0; i < HIST_BUCKETS && hist_bucket_upper(i) <= limit_us; i++) {
+        count += hist->counts[i];
+    }
+    return count;
+}
@@ -0,0 +1,66 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+// ============================================================================
+// Log-Linear Latency Histogram
+// ============================================================================
+// HDR-style: values below 2^HIST_SUB_BITS microseconds get one bucket each;
+// above that every power of two is split into 2^HIST_SUB_BITS linear
+// sub-buckets, so any recorded value is off by at most 1/16 (6.25%).
+// Fixed size (no allocation), so histograms can live in shared memory and
+// be merged by simply adding the bucket counts.
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 32                // Values clamp at 2^32 us (~71 minutes)
+#define HIST_BUCKETS (HIST_SUB_COUNT * (HIST_MAX_BITS - HIST_SUB_BITS + 1))
+
+typedef struct {
+    long long counts[HIST_BUCKETS];
+    long long total;                    // Number of values recorded
+    long long sum_us;
+    long long max_us;
+} latency_hist_t;
+
+// ============================================================================
+// Histogram Functions
+// ============================================================================
+
+/**
+ * Bucket holding value_us
+ */
+int hist_bucket_index(long long value_us);
+
+/**
+ * Largest value (us) that falls into bucket index
+ */
+long long hist_bucket_upper(int index);
+
+/**
+ * Record a value in a histogram with a single writer (relaxed stores)
+ */
+void hist_record_local(latency_hist_t* hist, long long value_us);
+
+/**
+ * Record a value in a histogram shared by many writers (atomic adds)
+ */
+void hist_record_shared(latency_hist_t* hist, long long value_us);
+
+/**
+ * Add src's counts into dst (src may be written concurrently)
+ */
+void hist_merge(latency_hist_t* dst, const latency_hist_t* src);
+
+/**
+ * Value (us) at quantile q (0..1): the upper bound of the bucket holding it,
+ * capped at the largest value recorded. 0 if the histogram is empty.
+ */
+long long hist_percentile(const latency_hist_t* hist, double q);
+
+/**
+ * Number of values <= limit_us, counting whole buckets whose upper bound
+ * is within the limit
+ */
+long long hist_count_at_or_below(const latency_hist_t* hist, long long limit_us);
+
+#endif // HISTOGRAM_H
@@ -4,6 +4,10 @@
 #include "http.h"
 #include "stats.h"
 #include "logger.h"
+#include "coroutine.h"
+#include "phase_timing.h"
+#include "perf_counters.h"
+#include "mime.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,55 +18,150 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
 
 #define BUF_SIZE 8192
 #define MAX_PATH 4096
+#define RESPONSE_HEADER_SIZE 512
 
 // ============================================================================
 // MIME Type Detection
 // ============================================================================
 const char* get_mime_type(const char* path) {
-    const char* ext = strrchr(path, '.');
-    if (!ext) return "application/octet-stream";
-    
-    if (strcasecmp(ext, ".html") == 0 || strcasecmp(ext, ".htm") == 0) return "text/html";
-    if (strcasecmp(ext, ".css") == 0) return "text/css";
-    if (strcasecmp(ext, ".js") == 0) return "application/javascript";
-    if (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0) return "image/jpeg";
-    if (strcasecmp(ext, ".png") == 0) return "image/png";
-    if (strcasecmp(ext, ".gif") == 0) return "image/gif";
-    if (strcasecmp(ext, ".svg") == 0) return "image/svg+xml";
-    if (strcasecmp(ext, ".txt") == 0) return "text/plain";
-    if (strcasecmp(ext, ".json") == 0) return "application/json";
-    
-    return "application/octet-stream";
+    return mime_type_name(mime_type_for_path(path));
+}
+
+// ============================================================================
+// Non-blocking Send Helpers
+// ============================================================================
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
+/**
+ * Wait until the socket is writable or the response deadline passes
+ * Returns: 0 if writable, -1 on timeout or error
+ */
+static int wait_writable(http_conn_t* conn) {
+    long long remaining = conn->write_deadline_ms - monotonic_ms();
+    if (remaining <= 0) {
+        return -1;
+    }
+
+    // In a coroutine, park it and let the event loop run other requests
+    if (co_current()) {
+        return co_wait_fd(conn->fd, EPOLLOUT, remaining);
+    }
+
+    struct pollfd pfd = { .fd = conn->fd, .events = POLLOUT };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, (int)remaining);
+    } while (ready < 0 && errno == EINTR);
+    return (ready > 0 && !(pfd.revents & (POLLERR | POLLHUP))) ? 0 : -1;
+}
+
+/**
+ * Send header, then body bytes or file_fd's [0, file_size), without blocking.
+ * Whatever the socket cannot take right away goes to the worker's writer loop
+ * (without one, or inside a coroutine, it waits for writability until the
+ * write deadline).
+ * Returns: 0 if sent or handed off, -1 on error
+ */
+static int write_response(http_conn_t* conn, const char* header, size_t header_len,
+                          const char* body, size_t body_len, int file_fd, off_t file_size) {
+    size_t header_off = 0, body_off = 0;
+    off_t file_off = 0;
+    int has_more = body_len > 0 || (file_fd >= 0 && file_size > 0);
+
+    while (1) {
+        ssize_t sent;
+        if (header_off < header_len) {
+            sent = send(conn->fd, header + header_off, header_len - header_off,
+                        (has_more ? MSG_MORE : 0) | MSG_NOSIGNAL);
+            if (sent > 0) { header_off += sent; continue; }
+        } else if (body_off < body_len) {
+            sent = send(conn->fd, body + body_off, body_len - body_off, MSG_NOSIGNAL);
+            if (sent > 0) { body_off += sent; continue; }
+        } else if (file_fd >= 0 && file_off < file_size) {
+            sent = sendfile(conn->fd, file_fd, &file_off, file_size - file_off);
+            if (sent > 0) continue;
+        } else {
+            return 0;
+        }
+
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Slow client: let the writer loop finish so this thread is free;
+            // a coroutine simply parks until the socket drains
+            if (conn->writer && !co_current()) {
+                long long remaining = conn->write_deadline_ms - monotonic_ms();
+                if (response_writer_submit(conn->writer, conn->fd,
+                                           header + header_off, header_len - header_off,
+                                           body + body_off, body_len - body_off,
+                                           file_fd, file_off, file_size,
+                                           conn->keep_alive, remaining) == 0) {
+                    conn->offloaded = 1;
+                    return 0;
+                }
+            } else if (wait_writable(conn) == 0) {
+                continue;
+            }
+        }
+        conn->keep_alive = 0;
+        return -1;
+    }
+}
+
+/**
+ * write_response() as the end of the request's build phase and its send phase
+ */
+static int send_response(http_conn_t* conn, const char* header, size_t header_len,
+                         const char* body, size_t body_len, int file_fd, off_t file_size) {
+    PHASE_END(conn->phases, PHASE_HEADER);
+    int result = write_response(conn, header, header_len, body, body_len, file_fd, file_size);
+    PHASE_END(conn->phases, PHASE_SEND);
+    return result;
+}
+
+static const char* connection_header(const http_conn_t* conn) {
+    return conn->keep_alive ? "keep-alive" : "close";
 }
 
 // ============================================================================
 // HTTP Response Builder
 // ============================================================================
-void send_http_response(int fd, int status, const char* status_msg,
+void send_http_response(http_conn_t* conn, int status, const char* status_msg,
                        const char* content_type, const char* body, size_t body_len) {
-    char header[2048];
-    int header_len = snprintf(header, sizeof(header),
+    conn->trace.status = status;
+    conn->trace.bytes = body_len;
+
+    // Completions running outside a request (no arena) format on the stack
+    char stack_header[RESPONSE_HEADER_SIZE];
+    char* header = conn->arena ? arena_alloc(conn->arena, RESPONSE_HEADER_SIZE) : stack_header;
+    if (!header) {
+        conn->keep_alive = 0;
+        return;
+    }
+    int header_len = snprintf(header, RESPONSE_HEADER_SIZE,
         "HTTP/1.1 %d %s\r\n"
         "Content-Type: %s\r\n"
         "Content-Length: %zu\r\n"
         "Server: TemplateHTTP/1.0\r\n"
-        "Connection: close\r\n"
+        "Connection: %s\r\n"
         "\r\n",
-        status, status_msg, content_type, body_len);
+        status, status_msg, content_type, body_len, connection_header(conn));
 
-    send(fd, header, header_len, 0);
-    if (body && body_len > 0) {
-        send(fd, body, body_len, 0);
-    }
+    send_response(conn, header, header_len, body, body ? body_len : 0, -1, 0);
 }
 
 // ============================================================================
 // HTTP Request Parser
 // ============================================================================
-int parse_http_request(const char* buffer, http_request_t* req) {
+int parse_http_request(const char* buffer, http_request_t* req, arena_t* arena) {
     char* line_end = strstr(buffer, "\r\n");
     if (!line_end) return -1;
 
@@ -77,49 +176,344 @@ int parse_http_request(const char* buffer, http_request_t* req) {
         return -1;
     }
 
+    // Header lines: "Name: value", stored in the request arena
+    req->header_count = 0;
+    req->headers = arena_alloc(arena, sizeof(http_header_t) * MAX_HEADERS);
+    if (!req->headers) return 0;
+
+    const char* line = line_end + 2;
+    while (req->header_count < MAX_HEADERS) {
+        const char* eol = strstr(line, "\r\n");
+        if (!eol || eol == line) break;  // blank line ends headers (or request was truncated)
+
+        const char* colon = memchr(line, ':', eol - line);
+        if (colon) {
+            const char* value = colon + 1;
+            while (value < eol && (*value == ' ' || *value == '\t')) value++;
+            const char* value_end = eol;
+            while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+
+            http_header_t* h = &req->headers[req->header_count];
+            h->name = arena_strndup(arena, line, colon - line);
+            h->value = arena_strndup(arena, value, value_end - value);
+            if (!h->name || !h->value) break;
+            req->header_count++;
+        }
+        line = eol + 2;
+    }
+
+    return 0;
+}
+
+// ============================================================================
+// Header Lookup (case-insensitive)
+// ============================================================================
+const char* http_get_header(const http_request_t* req, const char* name) {
+    for (int i = 0; i < req->header_count; i++) {
+        if (strcasecmp(req->headers[i].name, name) == 0) {
+            return req->headers[i].value;
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Cache Miss Completion (disk I/O pool)
+// ============================================================================
+typedef struct {
+    disk_request_t disk;            // Must be first: the completion casts back
+    int fd;
+    const server_config_t* config;
+    file_cache_t* cache;
+    response_writer_t* writer;
+    event_loop_t* loop;
+    int keep_alive;
+    int is_head;
+    long long write_deadline_ms;
+    struct timespec start_time;
+    phase_clock_t phases;
+    request_trace_t trace;
+    perf_clock_t perf;
+} file_request_t;
+
+/**
+ * Hardware counter class of an answered request
+ */
+static int perf_class_of(const http_conn_t* conn) {
+    if (conn->monitoring) {
+        return PERF_CLASS_MONITORING;
+    }
+    if (conn->trace.status != 200) {
+        return PERF_CLASS_OTHER;
+    }
+    if (conn->trace.cache == TRACE_CACHE_HIT) {
+        return PERF_CLASS_CACHE_HIT;
+    }
+    return conn->trace.bytes > MAX_FILE_SIZE ? PERF_CLASS_LARGE_FILE : PERF_CLASS_CACHE_MISS;
+}
+
+/**
+ * Response time of an answered request into the latency stats, the request
+ * into the flight recorder if it was slow or failed, and its counters into
+ * its class
+ */
+static void record_response(http_conn_t* conn, const struct timespec* start_time) {
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    long long elapsed_us = (end_time.tv_sec - start_time->tv_sec) * 1000000LL +
+                           (end_time.tv_nsec - start_time->tv_nsec) / 1000LL;
+    add_response_time(elapsed_us);
+    conn->trace.total_us = elapsed_us;
+    record_request_trace(&conn->trace, conn->phases.phase_us);
+    perf_request_end(&conn->perf, perf_class_of(conn));
+}
+
+/**
+ * Count a file response: the global counters plus per-path and per-type stats
+ */
+static void update_file_stats(http_conn_t* conn, const char* full_path, long long bytes, int http_code) {
+    update_stats_with_code(bytes, http_code);
+    conn->trace.bytes = bytes;
+    if (http_code == 200) {
+        conn->trace.status = 200;   // Error statuses come from send_http_response()
+    }
+
+    // Track paths as requested, without the document root
+    const char* path = full_path;
+    size_t root_len = strlen(conn->config->document_root);
+    if (strncmp(full_path, conn->config->document_root, root_len) == 0) {
+        path += root_len;
+    }
+    record_path_stats(path, mime_type_for_path(full_path), bytes, http_code);
+}
+
+/**
+ * Answer a request from a finished disk load: fill the cache, send the file
+ * (or the error) and release the loaded data
+ */
+static void send_loaded_file(http_conn_t* conn, disk_request_t* disk, int is_head) {
+    if (disk->error == ECANCELED) {
+        // Shutting down before the load ran
+        conn->keep_alive = 0;
+        const char* body = "<h1>503 Service Unavailable</h1>";
+        send_http_response(conn, 503, "Service Unavailable", "text/html", body, strlen(body));
+        update_stats_with_code(strlen(body), 503);
+    } else if (disk->error) {
+        const char* body = "<h1>404 Not Found</h1>";
+        send_http_response(conn, 404, "Not Found", "text/html", body, strlen(body));
+        update_file_stats(conn, disk->path, strlen(body), 404);
+    } else if (disk->is_dir) {
+        const char* body = "<h1>403 Forbidden</h1>";
+        send_http_response(conn, 403, "Forbidden", "text/html", body, strlen(body));
+        update_file_stats(conn, disk->path, strlen(body), 500);
+    } else {
+        if (disk->data && conn->cache) {
+            file_cache_put(conn->cache, disk->path, disk->data, disk->size);
+        }
+
+        char header[RESPONSE_HEADER_SIZE];
+        int header_len = snprintf(header, sizeof(header),
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %lld\r\n"
+            "Server: TemplateHTTP/1.0\r\n"
+            "X-Cache: MISS\r\n"
+            "Connection: %s\r\n"
+            "\r\n", get_mime_type(disk->path), (long long)disk->size,
+            connection_header(conn));
+
+        if (is_head) {
+            send_response(conn, header, header_len, NULL, 0, -1, 0);
+        } else if (disk->data) {
+            send_response(conn, header, header_len, disk->data, disk->size, -1, 0);
+        } else {
+            send_response(conn, header, header_len, NULL, 0, disk->file_fd, disk->size);
+        }
+        update_file_stats(conn, disk->path, disk->size, 200);
+    }
+
+    free(disk->data);
+    disk->data = NULL;
+    if (disk->file_fd >= 0) {
+        close(disk->file_fd);
+        disk->file_fd = -1;
+    }
+}
+
+/**
+ * Runs on the worker's event loop thread once the disk pool has loaded the
+ * file: send the response and release the connection
+ */
+static void file_load_complete(disk_request_t* disk) {
+    file_request_t* fr = (file_request_t*)disk;
+    http_conn_t conn = {
+        .fd = fr->fd,
+        .config = fr->config,
+        .cache = fr->cache,
+        .writer = fr->writer,
+        .loop = fr->loop,
+        .keep_alive = fr->keep_alive,
+        .write_deadline_ms = fr->write_deadline_ms,
+        .phases = fr->phases,
+        .trace = fr->trace,
+        .perf = fr->perf,
+    };
+
+    perf_request_resume(&conn.perf);
+    PHASE_END(conn.phases, PHASE_FILE);
+    send_loaded_file(&conn, disk, fr->is_head);
+    record_response(&conn, &fr->start_time);
+
+    // Release the connection unless the writer took it over
+    if (!conn.offloaded) {
+        decrement_active_connections();
+        if (conn.keep_alive) {
+            event_loop_add_idle(fr->loop, fr->fd);
+        } else {
+            close(fr->fd);
+        }
+    }
+    free(fr);
+}
+
+// Cache miss from a coroutine: the load lives on its stack while it is parked
+typedef struct {
+    disk_request_t disk;            // Must be first: the completion casts back
+    coroutine_t* co;
+    int done;
+} co_file_request_t;
+
+static void co_file_loaded(disk_request_t* disk) {
+    co_file_request_t* req = (co_file_request_t*)disk;
+    req->done = 1;
+    co_wake(req->co);
+}
+
+/**
+ * Load a cache miss on the disk pool, parking the calling coroutine meanwhile
+ * Returns: 0 if the response was sent, -1 if the caller must read the file itself
+ */
+static int co_load_file(http_conn_t* conn, const char* full_path, int is_head) {
+    coroutine_t* co = co_current();
+    if (!co || !conn->disk || strlen(full_path) >= MAX_PATH_LEN) {
+        return -1;
+    }
+
+    co_file_request_t req;
+    memset(&req, 0, sizeof(req));
+    snprintf(req.disk.path, sizeof(req.disk.path), "%s", full_path);
+    req.disk.read_limit = (conn->cache && !is_head) ? MAX_FILE_SIZE - 1 : 0;
+    req.disk.complete = co_file_loaded;
+    req.co = co;
+
+    perf_request_pause(&conn->perf);   // Other coroutines run meanwhile
+    disk_io_submit(conn->disk, &req.disk);
+    while (!req.done) {
+        co_suspend();   // req must outlive the load, even on shutdown
+    }
+    perf_request_resume(&conn->perf);
+    PHASE_END(conn->phases, PHASE_FILE);
+
+    send_loaded_file(conn, &req.disk, is_head);
+    return 0;
+}
+
+/**
+ * Hand a cache miss to the disk pool
+ * Returns: 0 if submitted (the connection now belongs to the completion), -1 otherwise
+ */
+static int submit_file_load(http_conn_t* conn, const char* full_path, int is_head) {
+    if (!conn->disk || !conn->loop || strlen(full_path) >= MAX_PATH_LEN) {
+        return -1;
+    }
+
+    file_request_t* fr = calloc(1, sizeof(file_request_t));
+    if (!fr) {
+        return -1;
+    }
+    snprintf(fr->disk.path, sizeof(fr->disk.path), "%s", full_path);
+    // Same rule as the inline path: only files the cache would take are read whole
+    fr->disk.read_limit = (conn->cache && !is_head) ? MAX_FILE_SIZE - 1 : 0;
+    fr->disk.complete = file_load_complete;
+    fr->fd = conn->fd;
+    fr->config = conn->config;
+    fr->cache = conn->cache;
+    fr->writer = conn->writer;
+    fr->loop = conn->loop;
+    fr->keep_alive = conn->keep_alive;
+    fr->is_head = is_head;
+    fr->write_deadline_ms = conn->write_deadline_ms;
+    fr->start_time = conn->start_time;
+    fr->phases = conn->phases;
+    fr->trace = conn->trace;
+    perf_request_pause(&conn->perf);   // Resumed on the loop thread
+    fr->perf = conn->perf;
+
+    conn->offloaded = 1;
+    conn->deferred = 1;
+    disk_io_submit(conn->disk, &fr->disk);
     return 0;
 }
 
 // ============================================================================
 // Send File with sendfile() optimization
 // ============================================================================
-void send_file_response(int client_fd, const char* full_path, const char* method, file_cache_t* cache) {
+void send_file_response(http_conn_t* conn, const char* full_path, const char* method) {
+    file_cache_t* cache = conn->cache;
+    int is_head = (strcmp(method, "HEAD") == 0);
+
     // Try to get file from cache first
     if (cache) {
         const char* cached_content = NULL;
         size_t cached_size = 0;
         
-        if (file_cache_get(cache, full_path, &cached_content, &cached_size) == 0) {
+        cache_entry_t* pinned = file_cache_get(cache, full_path, &cached_content, &cached_size);
+        int hit = pinned != NULL;
+        record_cache_lookup(hit);
+        conn->trace.cache = hit ? TRACE_CACHE_HIT : TRACE_CACHE_MISS;
+        PHASE_END(conn->phases, PHASE_CACHE);
+        if (hit) {
             // Cache hit! Send cached content
             const char* mime = get_mime_type(full_path);
-            char header[512];
-            int header_len = snprintf(header, sizeof(header),
+            char* header = arena_alloc(conn->arena, RESPONSE_HEADER_SIZE);
+            if (!header) {
+                file_cache_release(cache, pinned);
+                conn->keep_alive = 0;
+                return;
+            }
+            int header_len = snprintf(header, RESPONSE_HEADER_SIZE,
                 "HTTP/1.1 200 OK\r\n"
                 "Content-Type: %s\r\n"
                 "Content-Length: %zu\r\n"
                 "Server: TemplateHTTP/1.0\r\n"
                 "X-Cache: HIT\r\n"
-                "Connection: close\r\n"
-                "\r\n", mime, cached_size);
-            
-            send(client_fd, header, header_len, 0);
+                "Connection: %s\r\n"
+                "\r\n", mime, cached_size, connection_header(conn));
             
-            // Send file content (skip for HEAD requests)
-            if (strcmp(method, "HEAD") != 0) {
-                send(client_fd, cached_content, cached_size, 0);
-            }
+            // Send file content (skip for HEAD requests); the entry stays
+            // pinned while a coroutine is parked on a slow client
+            send_response(conn, header, header_len, cached_content,
+                          is_head ? 0 : cached_size, -1, 0);
+            file_cache_release(cache, pinned);
             
-            update_stats_with_code(cached_size, 200);
+            update_file_stats(conn, full_path, cached_size, 200);
             return;
         }
     }
     
-    // Cache miss - open file
+    // Cache miss - a coroutine parks while the disk pool loads it; a pool
+    // thread hands the rest of the request to the pool and keeps serving hits
+    if (co_load_file(conn, full_path, is_head) == 0 ||
+        submit_file_load(conn, full_path, is_head) == 0) {
+        return;
+    }
+
+    // No disk pool: open file here
     FILE* file = fopen(full_path, "rb");
     if (!file) {
         const char* body = "<h1>404 Not Found</h1>";
-        send_http_response(client_fd, 404, "Not Found", "text/html", body, strlen(body));
-        update_stats_with_code(strlen(body), 404);
+        send_http_response(conn, 404, "Not Found", "text/html", body, strlen(body));
+        update_file_stats(conn, full_path, strlen(body), 404);
         return;
     }
 
@@ -129,8 +523,8 @@ void send_file_response(int client_fd, const char* full_path, const char* method
     if (fstat(fd, &st) < 0) {
         fclose(file);
         const char* body = "<h1>500 Internal Server Error</h1>";
-        send_http_response(client_fd, 500, "Internal Server Error", "text/html", body, strlen(body));
-        update_stats_with_code(strlen(body), 500);
+        send_http_response(conn, 500, "Internal Server Error", "text/html", body, strlen(body));
+        update_file_stats(conn, full_path, strlen(body), 500);
         return;
     }
 
@@ -138,8 +532,8 @@ void send_file_response(int client_fd, const char* full_path, const char* method
     if (S_ISDIR(st.st_mode)) {
         fclose(file);
         const char* body = "<h1>403 Forbidden</h1>";
-        send_http_response(client_fd, 403, "Forbidden", "text/html", body, strlen(body));
-        update_stats_with_code(strlen(body), 500);
+        send_http_response(conn, 403, "Forbidden", "text/html", body, strlen(body));
+        update_file_stats(conn, full_path, strlen(body), 500);
         return;
     }
 
@@ -151,16 +545,16 @@ void send_file_response(int client_fd, const char* full_path, const char* method
     char* file_content = NULL;
     
     if (is_cacheable) {
-        // Read file into memory for caching
-        file_content = malloc(file_size);
+        // Read file into the request arena for caching (the cache keeps its own copy)
+        file_content = arena_alloc(conn->arena, file_size);
         if (file_content) {
             size_t bytes_read = fread(file_content, 1, file_size, file);
             if (bytes_read == (size_t)file_size) {
                 // Successfully read - add to cache
                 file_cache_put(cache, full_path, file_content, file_size);
             } else {
-                // Read failed - free buffer and fall back to sendfile
-                free(file_content);
+                // Read failed - fall back to sendfile
+                rewind(file);
                 file_content = NULL;
                 is_cacheable = 0;
             }
@@ -169,121 +563,234 @@ void send_file_response(int client_fd, const char* full_path, const char* method
         }
     }
 
+    PHASE_END(conn->phases, PHASE_FILE);
+
     // Send headers
-    char header[512];
-    int header_len = snprintf(header, sizeof(header),
+    char* header = arena_alloc(conn->arena, RESPONSE_HEADER_SIZE);
+    if (!header) {
+        conn->keep_alive = 0;
+        fclose(file);
+        return;
+    }
+    int header_len = snprintf(header, RESPONSE_HEADER_SIZE,
         "HTTP/1.1 200 OK\r\n"
         "Content-Type: %s\r\n"
         "Content-Length: %ld\r\n"
         "Server: TemplateHTTP/1.0\r\n"
         "X-Cache: MISS\r\n"
-        "Connection: close\r\n"
-        "\r\n", mime, file_size);
+        "Connection: %s\r\n"
+        "\r\n", mime, file_size, connection_header(conn));
     
-    send(client_fd, header, header_len, 0);
-
     // Send file content (skip for HEAD requests)
-    if (strcmp(method, "HEAD") != 0) {
-        if (is_cacheable && file_content) {
-            // Send from cached buffer
-            send(client_fd, file_content, file_size, 0);
-            free(file_content);
-        } else {
-            // Use sendfile for large files or when cache is not available
-            off_t offset = 0;
-            while (offset < file_size) {
-                ssize_t sent = sendfile(client_fd, fd, &offset, file_size - offset);
-                if (sent <= 0) {
-                    if (errno == EINTR) continue;
-                    break;
-                }
-            }
-        }
+    if (is_head) {
+        send_response(conn, header, header_len, NULL, 0, -1, 0);
+    } else if (is_cacheable && file_content) {
+        // Send from the buffer just read
+        send_response(conn, header, header_len, file_content, file_size, -1, 0);
     } else {
-        // HEAD request - free buffer if allocated
-        if (file_content) {
-            free(file_content);
-        }
+        // Use sendfile for large files or when cache is not available
+        send_response(conn, header, header_len, NULL, 0, fd, file_size);
     }
 
     fclose(file);
-    update_stats_with_code(file_size, 200);
+    update_file_stats(conn, full_path, file_size, 200);
+}
+
+// ============================================================================
+// Receive exactly one request's headers
+// ============================================================================
+// The event loop only dispatches once the full header block has arrived, so
+// peek it and consume precisely that much: bytes of a pipelined next request
+// stay in the socket for the loop to pick up.
+static ssize_t recv_request_headers(int client_fd, char* buffer, size_t size) {
+    ssize_t peeked = recv(client_fd, buffer, size - 1, MSG_PEEK);
+    if (peeked <= 0) {
+        return -1;
+    }
+    buffer[peeked] = '\0';
+
+    char* end = strstr(buffer, "\r\n\r\n");
+    size_t want = end ? (size_t)(end - buffer) + 4 : (size_t)peeked;
+
+    ssize_t got = recv(client_fd, buffer, want, 0);
+    if (got <= 0) {
+        return -1;
+    }
+    buffer[got] = '\0';
+    return got;
+}
+
+/**
+ * HTTP/1.1 keeps the connection open unless the client says close;
+ * HTTP/1.0 only when the client asks for keep-alive
+ */
+static int wants_keep_alive(const http_request_t* req, const server_config_t* config) {
+    if (config->keepalive_timeout_seconds <= 0) {
+        return 0;
+    }
+    const char* connection = http_get_header(req, "Connection");
+    if (strcmp(req->version, "HTTP/1.1") == 0) {
+        return !(connection && strcasecmp(connection, "close") == 0);
+    }
+    return connection && strcasecmp(connection, "keep-alive") == 0;
+}
+
+/**
+ * Close unless kept alive, and leave the active-connection count balanced
+ * Returns: 1 if the connection stays open
+ */
+static int release_connection(http_conn_t* conn) {
+    if (conn->offloaded) {
+        // The writer loop or a disk load completion owns the socket now
+        return 0;
+    }
+    decrement_active_connections();
+    if (conn->keep_alive) {
+        return 1;
+    }
+    close(conn->fd);
+    return 0;
+}
+
+/**
+ * Send a monitoring document and count it. The generators format into a
+ * per-thread buffer that the next document on the thread rewrites (and may
+ * realloc); a coroutine parked mid-send would see that happen, so it sends
+ * a copy from its own request arena.
+ */
+static void send_monitoring_response(http_conn_t* conn, int status, const char* status_msg,
+                                     const char* content_type, const char* body, size_t len) {
+    if (co_current()) {
+        char* copy = arena_alloc(conn->arena, len);
+        if (!copy) {
+            body = "<h1>500 Internal Server Error</h1>";
+            send_http_response(conn, 500, "Internal Server Error", "text/html", body, strlen(body));
+            update_stats_with_code(strlen(body), 500);
+            return;
+        }
+        memcpy(copy, body, len);
+        body = copy;
+    }
+    send_http_response(conn, status, status_msg, content_type, body, len);
+    update_stats_with_code(len, status);
+}
+
+/**
+ * Record the response time of every answered request (error responses
+ * included), then release the connection. A deferred load records its own.
+ */
+static int finish_connection(http_conn_t* conn) {
+    if (!conn->deferred) {
+        record_response(conn, &conn->start_time);
+    }
+    return release_connection(conn);
 }
 
 // ============================================================================
 // Handle Client Connection
 // ============================================================================
-void handle_client_connection(int client_fd, const server_config_t* config, file_cache_t* cache) {
+int handle_client_connection(http_conn_t* conn) {
     increment_active_connections();
     
-    struct timespec start_time, end_time;
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    clock_gettime(CLOCK_MONOTONIC, &conn->start_time);
+    PHASE_MARK(conn->phases);
+    perf_request_start(&conn->perf);
+    
+    const server_config_t* config = conn->config;
+    conn->keep_alive = 0;
+    conn->offloaded = 0;
+    conn->deferred = 0;
+    conn->monitoring = 0;
+    conn->write_deadline_ms = monotonic_ms() + config->write_timeout_seconds * 1000LL;
     
-    char buffer[BUF_SIZE];
-    ssize_t bytes_read = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
+    char* buffer = arena_alloc(conn->arena, BUF_SIZE);
+    ssize_t bytes_read = buffer ? recv_request_headers(conn->fd, buffer, BUF_SIZE) : -1;
     
     if (bytes_read <= 0) {
-        close(client_fd);
-        decrement_active_connections();
-        return;
+        // Nothing to answer: not a response, so no response time
+        return release_connection(conn);
     }
-    
-    buffer[bytes_read] = '\0';
+    PHASE_END(conn->phases, PHASE_RECV);
 
     // Parse HTTP request
     http_request_t req;
-    if (parse_http_request(buffer, &req) < 0) {
+    int parsed = parse_http_request(buffer, &req, conn->arena);
+    PHASE_END(conn->phases, PHASE_PARSE);
+    if (parsed < 0) {
         const char* body = "<h1>400 Bad Request</h1>";
-        send_http_response(client_fd, 400, "Bad Request", "text/html", body, strlen(body));
+        send_http_response(conn, 400, "Bad Request", "text/html", body, strlen(body));
         update_stats_with_code(strlen(body), 500);
-        close(client_fd);
-        return;
+        return finish_connection(conn);
     }
 
+    // Flight recorder key: the path without its query string
+    snprintf(conn->trace.path, sizeof(conn->trace.path), "%.*s",
+             (int)strcspn(req.path, "?"), req.path);
+
     // Only support GET and HEAD
     if (strcmp(req.method, "GET") != 0 && strcmp(req.method, "HEAD") != 0) {
         const char* body = "<h1>501 Not Implemented</h1>";
-        send_http_response(client_fd, 501, "Not Implemented", "text/html", body, strlen(body));
+        send_http_response(conn, 501, "Not Implemented", "text/html", body, strlen(body));
         update_stats_with_code(strlen(body), 500);
-        close(client_fd);
-        return;
+        return finish_connection(conn);
     }
 
+    // While draining, every response closes its connection at this boundary
+    conn->keep_alive = wants_keep_alive(&req, config) && !is_draining();
+
     // Handle monitoring endpoints
-    if (strcmp(req.path, "/health") == 0) {
+    conn->monitoring = 1;
+    if (strcmp(req.path, "/health") == 0 || strcmp(req.path, "/health/") == 0) {
         size_t response_len;
         char* body = generate_health_response(&response_len);
-        send_http_response(client_fd, 200, "OK", "application/json", body, response_len);
-        update_stats_with_code(response_len, 200);
-        close(client_fd);
-        decrement_active_connections();
-        return;
+        if (is_draining()) {
+            // Fail health checks so load balancers stop sending traffic
+            send_monitoring_response(conn, 503, "Service Unavailable", "application/json", body, response_len);
+        } else {
+            send_monitoring_response(conn, 200, "OK", "application/json", body, response_len);
+        }
+        return finish_connection(conn);
     }
     
-    if (strcmp(req.path, "/metrics") == 0) {
+    if (strcmp(req.path, "/metrics") == 0 || strcmp(req.path, "/metrics/") == 0) {
         size_t response_len;
         char* body = generate_metrics_response(&response_len);
-        send_http_response(client_fd, 200, "OK", "text/plain; version=0.0.4", body, response_len);
-        update_stats_with_code(response_len, 200);
-        close(client_fd);
-        decrement_active_connections();
-        return;
+        send_monitoring_response(conn, 200, "OK", "text/plain; version=0.0.4", body, response_len);
+        return finish_connection(conn);
+    }
+    
+    if (strcmp(req.path, "/stats/top") == 0) {
+        size_t response_len;
+        char* body = generate_top_json_response(&response_len);
+        send_monitoring_response(conn, 200, "OK", "application/json", body, response_len);
+        return finish_connection(conn);
+    }
+    
+    if (strcmp(req.path, "/debug/slow") == 0) {
+        size_t response_len;
+        char* body = generate_slow_json_response(&response_len);
+        send_monitoring_response(conn, 200, "OK", "application/json", body, response_len);
+        return finish_connection(conn);
     }
     
-    if (strcmp(req.path, "/stats") == 0) {
+    if (strcmp(req.path, "/stats") == 0 || strcmp(req.path, "/stats/") == 0) {
         size_t response_len;
         char* body = generate_stats_json_response(&response_len);
-        send_http_response(client_fd, 200, "OK", "application/json", body, response_len);
-        update_stats_with_code(response_len, 200);
-        close(client_fd);
-        decrement_active_connections();
-        return;
+        send_monitoring_response(conn, 200, "OK", "application/json", body, response_len);
+        return finish_connection(conn);
     }
     
+    conn->monitoring = 0;
+    
     // Sanitize path
-    char rel_path[MAX_PATH];
+    char* rel_path = arena_alloc(conn->arena, MAX_PATH);
+    char* full_path = arena_alloc(conn->arena, MAX_PATH);
+    if (!rel_path || !full_path) {
+        conn->keep_alive = 0;
+        return finish_connection(conn);
+    }
     if (strcmp(req.path, "/") == 0) {
-        snprintf(rel_path, sizeof(rel_path), "/index.html");
+        snprintf(rel_path, MAX_PATH, "/index.html");
     } else {
         // Remove query string
         char* query = strchr(req.path, '?');
@@ -291,31 +798,23 @@ void handle_client_connection(int client_fd, const server_config_t* config, file
         
         // Reject path traversal attempts
         if (strstr(req.path, "..")) {
+            conn->keep_alive = 0;
             const char* body = "<h1>403 Forbidden</h1>";
-            send_http_response(client_fd, 403, "Forbidden", "text/html", body, strlen(body));
+            send_http_response(conn, 403, "Forbidden", "text/html", body, strlen(body));
             update_stats_with_code(strlen(body), 500);
-            close(client_fd);
-            return;
+            return finish_connection(conn);
         }
-        snprintf(rel_path, sizeof(rel_path), "%s", req.path);
+        snprintf(rel_path, MAX_PATH, "%s", req.path);
     }
 
     // Build full path
-    char full_path[MAX_PATH];
-    snprintf(full_path, sizeof(full_path), "%s%s", config->document_root, rel_path);
+    snprintf(full_path, MAX_PATH, "%s%s", config->document_root, rel_path);
 
     log_message("Request: %s %s -> %s", req.method, req.path, full_path);
+    PHASE_END(conn->phases, PHASE_PATH);
 
     // Serve the file
-    send_file_response(client_fd, full_path, req.method, cache);
-
-    close(client_fd);
+    send_file_response(conn, full_path, req.method);
     
-    // Calculate and record response time
-    clock_gettime(CLOCK_MONOTONIC, &end_time);
-    long long response_time_ms = (end_time.tv_sec - start_time.tv_sec) * 1000LL +
-                                  (end_time.tv_nsec - start_time.tv_nsec) / 1000000LL;
-    add_response_time(response_time_ms);
-    
-    decrement_active_connections();
+    return finish_connection(conn);
 }
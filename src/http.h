@@ -2,26 +2,70 @@
 #define HTTP_H
 
 #include <stddef.h>
+#include <time.h>
 #include "config.h"
 #include "file_cache.h"
+#include "arena.h"
+#include "response_writer.h"
+#include "disk_io.h"
+#include "event_loop.h"
+#include "phase_timing.h"
+#include "perf_counters.h"
+#include "stats.h"
+
+#define MAX_HEADERS 32
 
 // ============================================================================
 // HTTP Request/Response Structures
 // ============================================================================
+typedef struct {
+    const char* name;               // Arena-allocated, valid until arena reset
+    const char* value;
+} http_header_t;
+
 typedef struct {
     char method[16];
     char path[512];
     char version[16];
+    http_header_t* headers;         // Arena-allocated array
+    int header_count;
 } http_request_t;
 
+// Per-connection state threaded through the request path
+typedef struct {
+    int fd;                         // Non-blocking client socket
+    const server_config_t* config;
+    file_cache_t* cache;
+    arena_t* arena;
+    response_writer_t* writer;      // Slow-client offload (NULL = wait in this thread)
+    disk_io_pool_t* disk;           // Cache-miss loads (NULL = read in this thread)
+    event_loop_t* loop;             // Where disk load completions run and keep-alives return
+    int keep_alive;                 // Leave the connection open after this response
+    int offloaded;                  // The writer or a disk completion owns fd now
+    int deferred;                   // Response finishes after a disk load
+    long long write_deadline_ms;    // Monotonic deadline for sending the response
+    struct timespec start_time;
+    phase_clock_t phases;           // Per-phase time of this request (PHASE_TIMING builds)
+    request_trace_t trace;          // For the slow-request recorder; queue_wait_us set by the caller
+    perf_clock_t perf;              // Hardware counters of this request (PERF_COUNTERS)
+    int monitoring;                 // Answered by a monitoring endpoint
+} http_conn_t;
+
 // ============================================================================
 // HTTP Functions
 // ============================================================================
 const char* get_mime_type(const char* path);
-void send_http_response(int fd, int status, const char* status_msg,
+void send_http_response(http_conn_t* conn, int status, const char* status_msg,
                        const char* content_type, const char* body, size_t body_len);
-int parse_http_request(const char* buffer, http_request_t* req);
-void send_file_response(int client_fd, const char* full_path, const char* method, file_cache_t* cache);
-void handle_client_connection(int client_fd, const server_config_t* config, file_cache_t* cache);
+int parse_http_request(const char* buffer, http_request_t* req, arena_t* arena);
+const char* http_get_header(const http_request_t* req, const char* name);
+void send_file_response(http_conn_t* conn, const char* full_path, const char* method);
+
+/**
+ * Serve one request on conn->fd
+ * Returns: 1 if the connection was kept alive (caller hands it back to the
+ * event loop), 0 if it was closed or handed to the response writer
+ */
+int handle_client_connection(http_conn_t* conn);
 
 #endif // HTTP_H
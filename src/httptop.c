@@ -0,0 +1,251 @@
+// Live terminal view of a running server's statistics
+// Build: make httptop
+// Run: ./bin/httptop [-d seconds] [-n frames] [-b] [-s /segment | config_file]
+//
+// Maps the named segment the server creates with STATS_SHM_NAME read-only,
+// so watching the server costs it nothing: no requests, no locks, no
+// writes to the block.
+
+#include "config.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SHOWN_WORKERS 64
+#define MAX_SHOWN_SLOW 5
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void signal_handler(int signum) {
+    (void)signum;
+    keep_running = 0;
+}
+
+// One reading of the block; two consecutive ones give per-interval rates
+typedef struct {
+    struct timespec taken;
+    stats_counters_t totals;
+    latency_hist_t latency;
+    worker_view_t workers[MAX_SHOWN_WORKERS];
+    int worker_count;
+} snapshot_t;
+
+static void take_snapshot(snapshot_t* snap) {
+    clock_gettime(CLOCK_MONOTONIC, &snap->taken);
+    stats_read_totals(&snap->totals);
+    stats_read_latency(&snap->latency);
+    snap->worker_count = stats_read_workers(snap->workers, MAX_SHOWN_WORKERS);
+}
+
+static double seconds_between(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Latency of the requests finished between two readings
+static void interval_latency(const latency_hist_t* now, const latency_hist_t* before,
+                             latency_hist_t* out) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        out->counts[i] = now->counts[i] - before->counts[i];
+    }
+    out->total = now->total - before->total;
+    out->sum_us = now->sum_us - before->sum_us;
+    out->max_us = now->max_us;      // Only the all-time max is kept
+}
+
+static const worker_view_t* find_worker(const snapshot_t* snap, int worker) {
+    for (int i = 0; i < snap->worker_count; i++) {
+        if (snap->workers[i].worker == worker) {
+            return &snap->workers[i];
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Formatting
+// ============================================================================
+static const char* format_us(long long us, char* buf, size_t size) {
+    if (us < 1000) {
+        snprintf(buf, size, "%lldus", us);
+    } else if (us < 1000000) {
+        snprintf(buf, size, "%.1fms", us / 1e3);
+    } else {
+        snprintf(buf, size, "%.2fs", us / 1e6);
+    }
+    return buf;
+}
+
+static const char* format_bytes(double bytes, char* buf, size_t size) {
+    static const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+    int unit = 0;
+    while (bytes >= 1024 && unit < 4) {
+        bytes /= 1024;
+        unit++;
+    }
+    snprintf(buf, size, unit ? "%.1f %s" : "%.0f %s", bytes, units[unit]);
+    return buf;
+}
+
+static double hit_ratio(long long hits, long long misses) {
+    return hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0;
+}
+
+// ============================================================================
+// Screen
+// ============================================================================
+static void render(const char* shm_name, const snapshot_t* now, const snapshot_t* before) {
+    server_stats_t* stats = get_stats();
+    double elapsed = seconds_between(&before->taken, &now->taken);
+    long long uptime = time(NULL) - stats->header.start_time;
+    char a[32], b[32], c[32], d[32], e[32];
+
+    printf("httptop - %s  master %d  up %lld:%02lld:%02lld%s\n\n",
+           shm_name, stats->header.master_pid, uptime / 3600, uptime / 60 % 60, uptime % 60,
+           is_draining() ? "  DRAINING" : "");
+
+    rate_window_t recent, minute, longest;
+    stats_read_rate(10, &recent);
+    stats_read_rate(60, &minute);
+    stats_read_rate(RATE_WINDOW_SECONDS, &longest);
+    printf("requests  %lld total | now %.1f/s | 10s %.1f/s | 60s %.1f/s | 5m %.1f/s\n",
+           now->totals.total_requests,
+           (now->totals.total_requests - before->totals.total_requests) / elapsed,
+           recent.requests_per_sec, minute.requests_per_sec, longest.requests_per_sec);
+    printf("traffic   %s/s (10s) | errors %.2f/s (10s) | active %lld | rejected %lld\n",
+           format_bytes(recent.bytes_per_sec, a, sizeof(a)), recent.errors_per_sec,
+           now->totals.active_connections, now->totals.rejected);
+    printf("cache     %.1f%% hit (%lld hits, %lld misses)\n",
+           hit_ratio(now->totals.cache_hits, now->totals.cache_misses),
+           now->totals.cache_hits, now->totals.cache_misses);
+
+    latency_hist_t window;
+    interval_latency(&now->latency, &before->latency, &window);
+    printf("latency   p50 %s  p90 %s  p99 %s  p99.9 %s  (last %.1fs, %lld responses)  max %s\n\n",
+           format_us(hist_percentile(&window, 0.50), a, sizeof(a)),
+           format_us(hist_percentile(&window, 0.90), b, sizeof(b)),
+           format_us(hist_percentile(&window, 0.99), c, sizeof(c)),
+           format_us(hist_percentile(&window, 0.999), d, sizeof(d)),
+           elapsed, window.total, format_us(now->latency.max_us, e, sizeof(e)));
+
+    printf("%6s %8s %9s %7s %6s %5s %8s %5s %8s %7s %8s %10s\n",
+           "WORKER", "PID", "REQ/S", "ACTIVE", "QUEUE", "PEAK", "BACKLOG", "BUSY", "THREADS",
+           "HIT%", "CACHED", "CACHE");
+    for (int i = 0; i < now->worker_count; i++) {
+        const worker_view_t* w = &now->workers[i];
+        const worker_view_t* prev = find_worker(before, w->worker);
+        long long served = prev ? w->requests - prev->requests : 0;
+        printf("%6d %8d %9.1f %7lld %6lld %5lld %8lld %5lld %8lld %6.1f%% %8lld %10s\n",
+               w->worker, w->pid, served / elapsed, w->active_connections, w->queue_depth,
+               w->queue_peak, w->listen_backlog, w->busy_threads, w->threads,
+               hit_ratio(w->cache_hits, w->cache_misses),
+               w->cache_entries, format_bytes(w->cache_bytes, a, sizeof(a)));
+    }
+
+    slow_entry_t slow[MAX_SHOWN_SLOW];
+    int slow_count = stats_read_slow(slow, MAX_SHOWN_SLOW);
+    printf("\nslow/failed requests: %lld recorded (threshold %s)\n",
+           stats->slow_next, format_us(stats->slow_threshold_us, a, sizeof(a)));
+    for (int i = 0; i < slow_count; i++) {
+        time_t when = slow[i].time_ms / 1000;
+        struct tm tm;
+        char clock[16];
+        strftime(clock, sizeof(clock), "%H:%M:%S", localtime_r(&when, &tm));
+        printf("  %s  %3d %9s  queue %-8s %-4s w%-3d %s\n",
+               clock, slow[i].status, format_us(slow[i].total_us, a, sizeof(a)),
+               format_us(slow[i].queue_wait_us, b, sizeof(b)), trace_cache_name(slow[i].cache),
+               slow[i].worker, slow[i].path);
+    }
+}
+
+static int server_running(void) {
+    int pid = get_stats()->header.master_pid;
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [-d seconds] [-n frames] [-b] [-s /segment | config_file]\n"
+        "  -d  refresh interval (default 1)\n"
+        "  -n  exit after this many screens (default: until interrupted)\n"
+        "  -b  batch mode: append screens instead of redrawing\n"
+        "  -s  segment name; otherwise STATS_SHM_NAME from config_file (default server.conf)\n",
+        prog);
+}
+
+// ============================================================================
+// Main Function
+// ============================================================================
+int main(int argc, char** argv) {
+    double interval = 1.0;
+    int frames = 0;
+    int batch = !isatty(STDOUT_FILENO);
+    char shm_name[sizeof(((server_config_t*)0)->stats_shm_name)] = "";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:bs:h")) != -1) {
+        switch (opt) {
+            case 'd': interval = atof(optarg); break;
+            case 'n': frames = atoi(optarg); break;
+            case 'b': batch = 1; break;
+            case 's': snprintf(shm_name, sizeof(shm_name), "%s", optarg); break;
+            default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if (interval < 0.1) {
+        interval = 0.1;
+    }
+
+    if (!shm_name[0]) {
+        const char* config_file = optind < argc ? argv[optind] : "server.conf";
+        server_config_t config;
+        load_config(config_file, &config);
+        if (!config.stats_shm_name[0]) {
+            fprintf(stderr, "%s does not set STATS_SHM_NAME; set it and restart the server, or pass -s\n",
+                    config_file);
+            return EXIT_FAILURE;
+        }
+        snprintf(shm_name, sizeof(shm_name), "%s", config.stats_shm_name);
+    }
+
+    if (stats_attach(shm_name) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    static snapshot_t snapshots[2];
+    snapshot_t* before = &snapshots[0];
+    snapshot_t* now = &snapshots[1];
+    take_snapshot(before);
+
+    struct timespec pause = { (time_t)interval, (long)((interval - (time_t)interval) * 1e9) };
+    for (int frame = 0; keep_running && (frames == 0 || frame < frames); frame++) {
+        nanosleep(&pause, NULL);
+        if (!keep_running) {
+            break;
+        }
+        if (!server_running()) {
+            fprintf(stderr, "Server (pid %d) has exited\n", get_stats()->header.master_pid);
+            stats_detach();
+            return EXIT_FAILURE;
+        }
+
+        take_snapshot(now);
+        printf(batch ? (frame ? "\n" : "") : "\033[H\033[2J");
+        render(shm_name, now, before);
+        fflush(stdout);
+
+        snapshot_t* swap = before;
+        before = now;
+        now = swap;
+    }
+
+    stats_detach();
+    return EXIT_SUCCESS;
+}
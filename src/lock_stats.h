@@ -0,0 +1,101 @@
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+// ============================================================================
+// Lock Contention Instrumentation
+// ============================================================================
+// Built with -DLOCK_STATS (the Makefile default; `make LOCK_STATS=0` strips
+// it out), each instrumented lock site first tries the lock without
+// blocking. Only when that fails does it read the clock, block, and charge
+// the wait to the site. An uncontended acquisition costs one counter store.
+// Without it the wrappers are the plain calls.
+
+#include <pthread.h>
+#include <semaphore.h>
+
+typedef enum {
+    LOCK_QUEUE_MUTEX,   // connection_queue_t mutex semaphore
+    LOCK_QUEUE_FILLED,  // Pool thread waiting for a queued connection (idle time)
+    LOCK_QUEUE_EMPTY,   // Blocking enqueue waiting for a free slot in its class
+    LOCK_CACHE_READ,    // file_cache_t rwlock, lookups
+    LOCK_CACHE_WRITE,   // file_cache_t rwlock, inserts and evictions
+    NUM_LOCK_SITES
+} lock_site_t;
+
+// Acquisition counters of one lock site
+typedef struct {
+    long long acquisitions;
+    long long contended;        // Acquisitions that had to block
+    long long wait_ns;          // Time spent blocked
+} lock_counters_t;
+
+const char* lock_site_name(int site);
+
+#ifdef LOCK_STATS
+
+#include <time.h>
+
+void record_lock_acquire(int site, int contended, long long wait_ns);
+
+static inline long long lock_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline int timed_sem_wait(sem_t* sem, int site) {
+    if (sem_trywait(sem) == 0) {
+        record_lock_acquire(site, 0, 0);
+        return 0;
+    }
+    long long start = lock_now_ns();
+    int result = sem_wait(sem);
+    if (result == 0) {
+        record_lock_acquire(site, 1, lock_now_ns() - start);
+    }
+    return result;
+}
+
+static inline int timed_rdlock(pthread_rwlock_t* lock, int site) {
+    if (pthread_rwlock_tryrdlock(lock) == 0) {
+        record_lock_acquire(site, 0, 0);
+        return 0;
+    }
+    long long start = lock_now_ns();
+    int result = pthread_rwlock_rdlock(lock);
+    if (result == 0) {
+        record_lock_acquire(site, 1, lock_now_ns() - start);
+    }
+    return result;
+}
+
+static inline int timed_wrlock(pthread_rwlock_t* lock, int site) {
+    if (pthread_rwlock_trywrlock(lock) == 0) {
+        record_lock_acquire(site, 0, 0);
+        return 0;
+    }
+    long long start = lock_now_ns();
+    int result = pthread_rwlock_wrlock(lock);
+    if (result == 0) {
+        record_lock_acquire(site, 1, lock_now_ns() - start);
+    }
+    return result;
+}
+
+// For sites with their own wait loop (the queue's spin-then-park): start
+// stores the time the wait began, LOCK_RECORD charges it if contended
+#define LOCK_WAIT_START(start) ((start) = lock_now_ns())
+#define LOCK_RECORD(site, contended, start) \
+    record_lock_acquire((site), (contended), (contended) ? lock_now_ns() - (start) : 0)
+
+#else
+
+#define timed_sem_wait(sem, site) sem_wait(sem)
+#define timed_rdlock(lock, site) pthread_rwlock_rdlock(lock)
+#define timed_wrlock(lock, site) pthread_rwlock_wrlock(lock)
+#define LOCK_WAIT_START(start) ((void)(start))
+#define LOCK_RECORD(site, contended, start) ((void)(start))
+
+#endif // LOCK_STATS
+
+#endif // LOCK_STATS_H
@@ -1,31 +1,511 @@
-// Thread-safe logging functions
+// Asynchronous logger: threads format lines straight into a lock-free ring,
+// a background thread per process writes them out in batches; the master
+// rotates the file for everyone
 
 #include "logger.h"
+#include "stats.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <time.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
-#include <semaphore.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
-#define MAX_LOG_SIZE (10 * 1024 * 1024)  // 10MB
-#define LOG_SEM_NAME "/server_log_sem"
+#define LOG_RING_SLOTS 1024             // Power of two
+#define LOG_LINE_MAX 512                // Longer lines are truncated
+#define LOG_BATCH_LINES 64              // Lines per writev() (below IOV_MAX)
+#define LOG_FLUSH_MS 50                 // Longest a line waits in the ring when idle
+#define LOG_BLOCK_WAIT_US 100           // LOG_OVERFLOW_BLOCK: retry interval on a full ring
+#define LOG_FLUSH_TIMEOUT_MS 2000       // logger_flush() gives up after this
+#define LOG_COMPRESS_WAIT_MS 5000       // logger_cleanup() waits this long for compressions
 
-static FILE* log_file = NULL;
-static sem_t* log_sem = NULL;
+#define WRITER_NONE 0                   // Not started in this process (yet)
+#define WRITER_STARTING 1
+#define WRITER_RUNNING 2
+#define WRITER_FAILED 3                 // Could not start: lines are written inline
+
+// One line; seq == position: free for that position, position + 1: holds it
+typedef struct {
+    unsigned long seq;
+    int len;
+    char text[LOG_LINE_MAX];
+} log_slot_t;
+
+// Bounded MPSC ring (Vyukov): a producer claims a position with a CAS on
+// ring_head, formats into the slot and publishes it through seq; the writer
+// takes positions in order from ring_tail and hands each slot back for the
+// position one lap later
+static log_slot_t ring[LOG_RING_SLOTS];
+static unsigned long ring_head __attribute__((aligned(64)));
+static unsigned long ring_tail __attribute__((aligned(64)));
+static unsigned long ring_dropped;      // Lines dropped on a full ring (this process)
+
+// Shared by the master and every worker (mapped before fork). Writers add
+// what they wrote to bytes; the master rotates and bumps generation, and
+// each writer reopens the path when it sees a new generation.
+typedef struct {
+    unsigned long generation;
+    long long bytes;                // Written to the current file
+} log_shared_t;
+
+static log_shared_t* log_shared = NULL;
+static unsigned long log_generation;    // Generation this process's log_fd is on
+static int log_fd = -1;
 static char log_path[256] = {0};
+static int overflow_policy = LOG_OVERFLOW_DROP;
+
+// Rotation policy (master only)
+static long long rotate_max_bytes = 0;
+static int rotate_interval = 0;
+static int rotate_compress = 0;
+static time_t last_rotation;
+static int compressions_running = 0;
+
+static pthread_t writer_thread;
+static int writer_state = WRITER_NONE;
+static int writer_stop = 0;
+static int writer_sleeping = 0;         // Set while the writer waits on wake_fd
+static int wake_fd = -1;                // eventfd, per process
+
+// ============================================================================
+// Line Formatting
+// ============================================================================
+
+/**
+ * "[timestamp] " into out, reformatted only when the second changes
+ */
+static int format_timestamp(char* out, size_t size) {
+    static __thread time_t stamp_second = -1;
+    static __thread char stamp[64];
+    static __thread int stamp_len;
+
+    time_t now = time(NULL);
+    if (now != stamp_second) {
+        struct tm tm_info;
+        localtime_r(&now, &tm_info);
+        stamp_len = (int)strftime(stamp, sizeof(stamp), "[%d/%b/%Y:%H:%M:%S %z] ", &tm_info);
+        stamp_second = now;
+    }
+    int len = stamp_len < (int)size ? stamp_len : (int)size - 1;
+    memcpy(out, stamp, len);
+    return len;
+}
+
+/**
+ * One full line, newline included, truncated to size
+ * Returns: its length (no NUL terminator)
+ */
+static int format_line(char* out, size_t size, const char* format, va_list args) {
+    int len = format_timestamp(out, size);
+    int room = (int)size - len - 1;     // Keep a byte for the newline
+    int n = vsnprintf(out + len, room, format, args);
+    if (n < 0) {
+        n = 0;
+    } else if (n >= room) {
+        n = room - 1;
+    }
+    len += n;
+    out[len++] = '\n';
+    return len;
+}
+
+// ============================================================================
+// Output (writer thread, or inline when there is none)
+// ============================================================================
+
+static void write_fully(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;     // Nowhere to report it
+        }
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+/**
+ * Open the log path again onto log_fd, so writes already in flight finish
+ * in whichever file they started on
+ */
+static int reopen_log(void) {
+    int fd = open(log_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    dup2(fd, log_fd);
+    close(fd);
+    return 0;
+}
+
+/**
+ * Move to the current file if the master rotated or reopened it: one shared
+ * memory load per batch, no filesystem calls
+ */
+static void follow_rotation(void) {
+    unsigned long generation = __atomic_load_n(&log_shared->generation, __ATOMIC_ACQUIRE);
+    if (generation != __atomic_load_n(&log_generation, __ATOMIC_RELAXED)) {
+        reopen_log();
+        __atomic_store_n(&log_generation, generation, __ATOMIC_RELAXED);
+    }
+}
+
+static void output_lines(struct iovec* iov, int count) {
+    if (log_fd >= 0) {
+        struct iovec copy[LOG_BATCH_LINES];
+        long long bytes = 0;
+        for (int i = 0; i < count; i++) {
+            copy[i] = iov[i];
+            bytes += iov[i].iov_len;
+        }
+        follow_rotation();
+        write_fully(log_fd, copy, count);   // O_APPEND: one batch lands in one piece
+        __atomic_fetch_add(&log_shared->bytes, bytes, __ATOMIC_RELAXED);
+    }
+    write_fully(STDERR_FILENO, iov, count);
+}
+
+static void output_line(const char* line, int len) {
+    struct iovec iov = { (void*)line, (size_t)len };
+    output_lines(&iov, 1);
+}
+
+// ============================================================================
+// Ring
+// ============================================================================
+
+static void ring_reset(void) {
+    for (unsigned long i = 0; i < LOG_RING_SLOTS; i++) {
+        __atomic_store_n(&ring[i].seq, i, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&ring_head, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring_tail, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring_dropped, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Claim the next free slot
+ * Returns: the slot (position in *position), or NULL if the ring is full
+ */
+static log_slot_t* claim_slot(unsigned long* position) {
+    unsigned long pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    for (;;) {
+        log_slot_t* slot = &ring[pos & (LOG_RING_SLOTS - 1)];
+        unsigned long seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        long diff = (long)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring_head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *position = pos;
+                return slot;
+            }
+            // pos was reloaded by the failed exchange
+        } else if (diff < 0) {
+            return NULL;    // Still holds the line from one lap ago
+        } else {
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void wake_writer(void) {
+    if (__atomic_exchange_n(&writer_sleeping, 0, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+/**
+ * Wake the writer early once the ring is half full, so a burst is written
+ * out before it fills; otherwise it comes by every LOG_FLUSH_MS
+ */
+static void nudge_writer(unsigned long pos) {
+    unsigned long tail = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+    if (pos - tail >= LOG_RING_SLOTS / 2) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&writer_sleeping, __ATOMIC_RELAXED)) {
+            wake_writer();
+        }
+    }
+}
+
+/**
+ * Lines ready at the tail, at most max
+ */
+static int ready_lines(int max) {
+    unsigned long tail = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+    int count = 0;
+    while (count < max) {
+        log_slot_t* slot = &ring[(tail + count) & (LOG_RING_SLOTS - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + count + 1) {
+            break;  // Not published yet (or nothing there)
+        }
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Write out one batch from the tail
+ * Returns: the number of lines written
+ */
+static int write_batch(void) {
+    int count = ready_lines(LOG_BATCH_LINES);
+    if (count == 0) {
+        return 0;
+    }
+
+    unsigned long tail = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+    struct iovec iov[LOG_BATCH_LINES];
+    long long bytes = 0;
+    for (int i = 0; i < count; i++) {
+        log_slot_t* slot = &ring[(tail + i) & (LOG_RING_SLOTS - 1)];
+        iov[i].iov_base = slot->text;
+        iov[i].iov_len = slot->len;
+        bytes += slot->len;
+    }
+    output_lines(iov, count);
+
+    for (int i = 0; i < count; i++) {
+        log_slot_t* slot = &ring[(tail + i) & (LOG_RING_SLOTS - 1)];
+        __atomic_store_n(&slot->seq, tail + i + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&ring_tail, tail + count, __ATOMIC_RELEASE);
+    record_log_written(count, bytes);
+    return count;
+}
+
+/**
+ * Report lines dropped since the last report, in the log itself and the stats
+ */
+static void report_dropped(unsigned long* reported) {
+    unsigned long dropped = __atomic_load_n(&ring_dropped, __ATOMIC_RELAXED);
+    if (dropped == *reported) {
+        return;
+    }
+    char line[LOG_LINE_MAX];
+    int len = format_timestamp(line, sizeof(line));
+    len += snprintf(line + len, sizeof(line) - len,
+                    "Logger: %lu messages dropped (log buffer full)\n", dropped - *reported);
+    output_line(line, len);
+    record_log_dropped((long long)(dropped - *reported));
+    *reported = dropped;
+}
+
+static void* writer_main(void* arg) {
+    (void)arg;
+    unsigned long reported = 0;
+
+    for (;;) {
+        if (write_batch() > 0) {
+            continue;
+        }
+        report_dropped(&reported);
+        if (__atomic_load_n(&writer_stop, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        // Sleep until the flush interval passes or a producer needs room;
+        // recheck after announcing it so a concurrent nudge is not lost
+        __atomic_store_n(&writer_sleeping, 1, __ATOMIC_SEQ_CST);
+        if (ready_lines(LOG_RING_SLOTS / 2) < LOG_RING_SLOTS / 2) {
+            struct pollfd pfd = { .fd = wake_fd, .events = POLLIN };
+            if (poll(&pfd, 1, LOG_FLUSH_MS) > 0) {
+                uint64_t value;
+                ssize_t ignored = read(wake_fd, &value, sizeof(value));
+                (void)ignored;
+            }
+        }
+        __atomic_store_n(&writer_sleeping, 0, __ATOMIC_SEQ_CST);
+    }
+
+    // Stopping: everything published has been written
+    report_dropped(&reported);
+    return NULL;
+}
+
+/**
+ * Start this process's writer on first use (the master's does not survive fork)
+ * Returns: 1 if lines should go through the ring, 0 to write them inline
+ */
+static int ensure_writer(void) {
+    int state = __atomic_load_n(&writer_state, __ATOMIC_ACQUIRE);
+    if (state == WRITER_RUNNING || state == WRITER_STARTING) {
+        return 1;
+    }
+    if (state == WRITER_FAILED || log_fd < 0) {
+        return 0;
+    }
+
+    int expected = WRITER_NONE;
+    if (!__atomic_compare_exchange_n(&writer_state, &expected, WRITER_STARTING, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return expected != WRITER_FAILED;
+    }
+
+    writer_stop = 0;
+    writer_sleeping = 0;
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd < 0 || pthread_create(&writer_thread, NULL, writer_main, NULL) != 0) {
+        if (wake_fd >= 0) {
+            close(wake_fd);
+            wake_fd = -1;
+        }
+        __atomic_store_n(&writer_state, WRITER_FAILED, __ATOMIC_RELEASE);
+        return 0;
+    }
+    __atomic_store_n(&writer_state, WRITER_RUNNING, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/**
+ * In a new worker: the writer thread stayed in the parent, and so do the
+ * lines it had queued (the parent writes them)
+ */
+static void logger_atfork_child(void) {
+    ring_reset();
+    writer_state = WRITER_NONE;
+    writer_sleeping = 0;
+    writer_stop = 0;
+    if (wake_fd >= 0) {
+        close(wake_fd);     // Shared with the parent's writer otherwise
+        wake_fd = -1;
+    }
+}
 
 // ============================================================================
-// Thread-Safe Logger
+// Rotation (master only)
 // ============================================================================
 
-int logger_init(const char* log_file_path) {
-    // Create or open the semaphore
-    log_sem = sem_open(LOG_SEM_NAME, O_CREAT, 0644, 1);
-    if (log_sem == SEM_FAILED) {
-        perror("sem_open failed");
+#ifdef HAVE_ZLIB
+/**
+ * Compress a rotated file to <file>.gz and remove it; runs detached so the
+ * master keeps its one-second loop
+ */
+static void* compress_main(void* arg) {
+    char* path = arg;
+    char gz_path[320], tmp_path[330];
+    snprintf(gz_path, sizeof(gz_path), "%s.gz", path);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.gz.tmp", path);
+
+    int ok = 0;
+    int in = open(path, O_RDONLY | O_CLOEXEC);
+    gzFile out = in >= 0 ? gzopen(tmp_path, "wb") : NULL;
+    if (out) {
+        char buf[65536];
+        ssize_t n;
+        ok = 1;
+        while ((n = read(in, buf, sizeof(buf))) > 0) {
+            if (gzwrite(out, buf, (unsigned)n) != n) {
+                ok = 0;
+                break;
+            }
+        }
+        if (n < 0) ok = 0;
+        if (gzclose(out) != Z_OK) ok = 0;
+    }
+    if (in >= 0) close(in);
+
+    // Only a complete .gz replaces the original
+    if (ok && rename(tmp_path, gz_path) == 0) {
+        unlink(path);
+    } else {
+        unlink(tmp_path);
+        log_message("Logger: could not compress %s", path);
+    }
+    free(path);
+    __atomic_fetch_sub(&compressions_running, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+#endif
+
+static void compress_rotated(const char* path) {
+#ifdef HAVE_ZLIB
+    pthread_attr_t attr;
+    pthread_t thread;
+    char* copy = strdup(path);
+    __atomic_fetch_add(&compressions_running, 1, __ATOMIC_RELAXED);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (!copy || pthread_create(&thread, &attr, compress_main, copy) != 0) {
+        __atomic_fetch_sub(&compressions_running, 1, __ATOMIC_RELEASE);
+        free(copy);
+        log_message("Logger: could not start compressing %s", path);
+    }
+    pthread_attr_destroy(&attr);
+#else
+    (void)path;
+#endif
+}
+
+/**
+ * Point every writer at the file log_fd now refers to
+ */
+static void publish_generation(long long bytes) {
+    unsigned long generation = __atomic_load_n(&log_shared->generation, __ATOMIC_RELAXED) + 1;
+    __atomic_store_n(&log_generation, generation, __ATOMIC_RELAXED);    // Already on it
+    __atomic_store_n(&log_shared->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&log_shared->generation, generation, __ATOMIC_RELEASE);
+}
+
+static void rotate_log(time_t now) {
+    char rotated[300];
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &tm_info);
+    snprintf(rotated, sizeof(rotated), "%s.%s", log_path, timestamp);
+
+    // Either way, wait a full period before trying again
+    last_rotation = now;
+    if (rename(log_path, rotated) < 0) {
+        __atomic_store_n(&log_shared->bytes, 0, __ATOMIC_RELAXED);
+        log_message("Logger: could not rotate %s: %s", log_path, strerror(errno));
+        return;
+    }
+    if (reopen_log() < 0) {
+        log_message("Logger: could not reopen %s after rotation: %s", log_path, strerror(errno));
+    }
+    publish_generation(0);
+    log_message("Logger: rotated previous log to %s", rotated);
+    if (rotate_compress) {
+        compress_rotated(rotated);
+    }
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+
+int logger_init(const char* log_file_path, int overflow) {
+    // Rotation state every process sees; mapped before the workers are forked
+    log_shared = mmap(NULL, sizeof(log_shared_t), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (log_shared == MAP_FAILED) {
+        perror("mmap failed");
+        log_shared = NULL;
         return -1;
     }
 
@@ -33,86 +513,140 @@ int logger_init(const char* log_file_path) {
     strncpy(log_path, log_file_path, sizeof(log_path) - 1);
 
     // Open log file in append mode
-    log_file = fopen(log_path, "a");
-    if (!log_file) {
-        perror("fopen log file failed");
-        sem_close(log_sem);
-        sem_unlink(LOG_SEM_NAME);
+    log_fd = open(log_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (log_fd < 0) {
+        perror("open log file failed");
+        munmap(log_shared, sizeof(log_shared_t));
+        log_shared = NULL;
         return -1;
     }
+    struct stat st;
+    log_shared->bytes = fstat(log_fd, &st) == 0 ? st.st_size : 0;
+    log_shared->generation = 0;
+    log_generation = 0;
+    last_rotation = time(NULL);
 
+    overflow_policy = overflow;
+    ring_reset();
+    static int atfork_registered = 0;
+    if (!atfork_registered) {
+        pthread_atfork(NULL, NULL, logger_atfork_child);
+        atfork_registered = 1;
+    }
     return 0;
 }
 
-void logger_cleanup(void) {
-    if (log_file) {
-        fclose(log_file);
-        log_file = NULL;
+void logger_set_rotation(long long max_bytes, int interval_seconds, int compress) {
+    rotate_max_bytes = max_bytes;
+    rotate_interval = interval_seconds;
+#ifdef HAVE_ZLIB
+    rotate_compress = compress;
+#else
+    rotate_compress = 0;
+    if (compress) {
+        log_message("LOG_COMPRESS ignored: built without zlib (make ZLIB=0)");
     }
-    if (log_sem) {
-        sem_close(log_sem);
-        sem_unlink(LOG_SEM_NAME);
-        log_sem = NULL;
+#endif
+}
+
+void logger_maintain(void) {
+    if (!log_shared || log_fd < 0) {
+        return;
+    }
+    time_t now = time(NULL);
+    if ((rotate_max_bytes > 0 &&
+         __atomic_load_n(&log_shared->bytes, __ATOMIC_RELAXED) >= rotate_max_bytes) ||
+        (rotate_interval > 0 && now - last_rotation >= rotate_interval)) {
+        rotate_log(now);
     }
 }
 
-static void rotate_log_if_needed(void) {
+void logger_reopen(void) {
+    if (!log_shared || log_fd < 0) {
+        return;
+    }
+    if (reopen_log() < 0) {
+        log_message("Logger: could not reopen %s: %s", log_path, strerror(errno));
+        return;
+    }
     struct stat st;
-    if (stat(log_path, &st) != 0) {
+    publish_generation(fstat(log_fd, &st) == 0 ? st.st_size : 0);
+    last_rotation = time(NULL);
+    log_message("Logger: reopened %s", log_path);
+}
+
+void logger_flush(void) {
+    if (__atomic_load_n(&writer_state, __ATOMIC_ACQUIRE) != WRITER_RUNNING) {
         return;
     }
 
-    if (st.st_size >= MAX_LOG_SIZE) {
-        fclose(log_file);
+    unsigned long target = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+    for (int waited = 0; waited < LOG_FLUSH_TIMEOUT_MS; waited++) {
+        if ((long)(__atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) - target) >= 0) {
+            return;
+        }
+        usleep(1000);
+    }
+}
 
-        // Rename old log file
-        char old_log[300];
-        time_t now = time(NULL);
-        struct tm* tm_info = localtime(&now);
-        char timestamp[32];
-        strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", tm_info);
-        snprintf(old_log, sizeof(old_log), "%s.%s", log_path, timestamp);
-        rename(log_path, old_log);
+void logger_cleanup(void) {
+    // Let rotated files being compressed finish (master only)
+    for (int waited = 0; waited < LOG_COMPRESS_WAIT_MS &&
+                         __atomic_load_n(&compressions_running, __ATOMIC_ACQUIRE) > 0; waited += 10) {
+        usleep(10000);
+    }
 
-        // Open new log file
-        log_file = fopen(log_path, "a");
-        if (!log_file) {
-            perror("Failed to reopen log file after rotation");
-        }
+    if (__atomic_load_n(&writer_state, __ATOMIC_ACQUIRE) == WRITER_RUNNING) {
+        __atomic_store_n(&writer_stop, 1, __ATOMIC_RELEASE);
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+        pthread_join(writer_thread, NULL);
+        close(wake_fd);
+        wake_fd = -1;
+    }
+    __atomic_store_n(&writer_state, WRITER_NONE, __ATOMIC_RELEASE);
+
+    if (log_fd >= 0) {
+        close(log_fd);
+        log_fd = -1;
+    }
+    if (log_shared) {
+        munmap(log_shared, sizeof(log_shared_t));
+        log_shared = NULL;
     }
 }
 
 void log_message(const char* format, ...) {
-    time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
-    char timestamp[64];
-    strftime(timestamp, sizeof(timestamp), "%d/%b/%Y:%H:%M:%S %z", tm_info);
-
-    // Always write to stderr
-    fprintf(stderr, "[%s] ", timestamp);
-    va_list args1;
-    va_start(args1, format);
-    vfprintf(stderr, format, args1);
-    va_end(args1);
-    fprintf(stderr, "\n");
-
-    // Write to file if initialized
-    if (log_file && log_sem) {
-        sem_wait(log_sem);  // Lock
-
-        // Check if rotation is needed
-        rotate_log_if_needed();
-
-        if (log_file) {
-            fprintf(log_file, "[%s] ", timestamp);
-            va_list args2;
-            va_start(args2, format);
-            vfprintf(log_file, format, args2);
-            va_end(args2);
-            fprintf(log_file, "\n");
-            fflush(log_file);  // Ensure data is written
-        }
+    va_list args;
+    va_start(args, format);
 
-        sem_post(log_sem);  // Unlock
+    if (!ensure_writer()) {
+        // No logger (yet), or no writer thread: write it out here
+        char line[LOG_LINE_MAX];
+        int len = format_line(line, sizeof(line), format, args);
+        va_end(args);
+        output_line(line, len);
+        return;
     }
+
+    unsigned long pos;
+    log_slot_t* slot;
+    while (!(slot = claim_slot(&pos))) {
+        if (overflow_policy != LOG_OVERFLOW_BLOCK) {
+            __atomic_fetch_add(&ring_dropped, 1, __ATOMIC_RELAXED);
+            va_end(args);
+            return;
+        }
+        wake_writer();
+        usleep(LOG_BLOCK_WAIT_US);
+    }
+
+    slot->len = format_line(slot->text, sizeof(slot->text), format, args);
+    va_end(args);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    nudge_writer(pos);
 }
@@ -2,11 +2,37 @@
 #define LOGGER_H
 
 // ============================================================================
-// Thread-Safe Logger
+// Asynchronous Logger
 // ============================================================================
+// log_message() formats the line into a per-process ring and returns; a
+// background thread writes the ring out in batches (writev) to the log file
+// and stderr. With no room in the ring the overflow policy decides.
+//
+// Rotation has a single owner, the master: writers add what they write to a
+// shared byte count, the master rotates once a second if it is over the
+// limit (or the interval passed) and bumps a shared generation, and each
+// writer reopens the path when it sees the new generation. Nothing on the
+// logging path touches file metadata.
+
+#define LOG_OVERFLOW_DROP 0         // Drop the line and count it (default)
+#define LOG_OVERFLOW_BLOCK 1        // Wait for the writer to make room
 
 // Initialize the logger (must be called before using log_message)
-int logger_init(const char* log_file_path);
+int logger_init(const char* log_file_path, int overflow_policy);
+
+// Rotation policy: max_bytes (0 = no size limit), interval_seconds
+// (0 = no time limit), compress rotated files with gzip in the background
+void logger_set_rotation(long long max_bytes, int interval_seconds, int compress);
+
+// Rotate if the policy says so (master, once a second)
+void logger_maintain(void);
+
+// Reopen the log path in every process, after an external tool (logrotate)
+// moved the file (master, on SIGHUP/SIGUSR1)
+void logger_reopen(void);
+
+// Write out everything logged so far (before a worker exits)
+void logger_flush(void);
 
 // Cleanup the logger (should be called on shutdown)
 void logger_cleanup(void);
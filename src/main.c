@@ -6,13 +6,17 @@
 #include "logger.h"
 #include "stats.h"
 #include "server.h"
+#include "core_worker.h"
+#include "perf_counters.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <signal.h>
 #include <unistd.h>
 #include <sys/wait.h>
 
 static volatile sig_atomic_t keep_running = 1;
+static volatile sig_atomic_t reopen_requested = 0;
 
 // ============================================================================
 // Signal Handler
@@ -22,6 +26,12 @@ void signal_handler(int signum) {
     keep_running = 0;
 }
 
+// SIGHUP/SIGUSR1: logrotate moved server.log, start a new one
+void reopen_signal_handler(int signum) {
+    (void)signum;
+    reopen_requested = 1;
+}
+
 // ============================================================================
 // Main Function
 // ============================================================================
@@ -32,33 +42,59 @@ int main(int argc, char** argv) {
     load_config(config_file, &config);
 
     // Initialize logger
-    if (logger_init("server.log") < 0) {
+    if (logger_init("server.log", config.log_overflow) < 0) {
         fprintf(stderr, "Failed to initialize logger\n");
         exit(EXIT_FAILURE);
     }
+    logger_set_rotation(config.log_max_size_mb * 1024LL * 1024LL, config.log_rotate_seconds,
+                        config.log_compress);
 
     // Initialize statistics with shared memory
-    if (init_stats() < 0) {
+    if (init_stats(config.stats_shm_name) < 0) {
         fprintf(stderr, "Failed to initialize statistics\n");
         logger_cleanup();
         exit(EXIT_FAILURE);
     }
+    set_slow_request_threshold(config.slow_request_ms * 1000LL);
+    perf_counters_enable(config.perf_counters);
 
     // Setup signal handlers
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     signal(SIGCHLD, SIG_IGN);
+    signal(SIGHUP, reopen_signal_handler);
+    signal(SIGUSR1, reopen_signal_handler);
 
-    // Create server socket
-    int server_fd = create_server_socket(config.port);
-    if (server_fd < 0) {
-        fprintf(stderr, "Failed to create server socket\n");
-        exit(EXIT_FAILURE);
+    // Thread-per-core: one worker per CPU we may run on, each opening its own
+    // SO_REUSEPORT listener, so the master holds no listening socket
+    int per_core = (config.execution_mode == EXEC_MODE_PER_CORE);
+    int server_fd = -1;
+    if (per_core) {
+        config.num_workers = core_worker_count();
+    } else {
+        // Create server socket
+        server_fd = create_server_socket(config.port);
+        if (server_fd < 0) {
+            fprintf(stderr, "Failed to create server socket\n");
+            exit(EXIT_FAILURE);
+        }
     }
 
     log_message("Master process listening on port %d", config.port);
     log_message("Document root: %s", config.document_root);
-    log_message("Number of workers: %d", config.num_workers);
+    log_message("Number of workers: %d%s", config.num_workers,
+                per_core ? " (thread-per-core, one per CPU)" : "");
+
+    // Cache affinity: socketpairs must exist before fork so every worker shares them
+    affinity_router_t router;
+    affinity_router_t* router_ptr = NULL;
+    if (!per_core && config.cache_affinity && config.num_workers > 1 && config.cache_size_mb > 0) {
+        if (affinity_init(&router, config.num_workers) == 0) {
+            router_ptr = &router;
+        } else {
+            log_message("Cache affinity disabled: failed to create worker socketpairs");
+        }
+    }
 
     // Fork worker processes
     pid_t* worker_pids = malloc(sizeof(pid_t) * config.num_workers);
@@ -73,8 +109,12 @@ int main(int argc, char** argv) {
         
         if (pid == 0) {
             // Child process - worker
-            worker_process(server_fd, i, &config);
-            close(server_fd);
+            if (per_core) {
+                core_worker_process(i, &config);
+            } else {
+                worker_process(server_fd, i, &config, router_ptr);
+            }
+            logger_flush();
             exit(EXIT_SUCCESS);
         } else {
             // Parent process - store worker PID
@@ -86,6 +126,16 @@ int main(int argc, char** argv) {
     while (keep_running) {
         sleep(1);
         
+        // One sample per second feeds the /stats and /metrics rate windows
+        record_rate_sample();
+        
+        // The master owns log rotation for every process
+        if (reopen_requested) {
+            reopen_requested = 0;
+            logger_reopen();
+        }
+        logger_maintain();
+        
         // Show global statistics every 30 seconds
         static int counter = 0;
         counter++;
@@ -102,25 +152,62 @@ int main(int argc, char** argv) {
         }
     }
 
-    // Shutdown: send SIGTERM to all workers
-    log_message("Master shutting down, terminating workers...");
+    // Shutdown: fail /health and let every worker drain before exiting
+    log_message("Master shutting down, draining workers (deadline %ds)...",
+                config.drain_timeout_seconds);
+    set_draining();
+    // Workers empty the accept queue and close their copies as they start
+    // draining; ours must be gone too, or the listener outlives them and
+    // keeps queueing connections nobody will accept
+    if (server_fd >= 0) {
+        close(server_fd);
+        server_fd = -1;
+    }
     for (int i = 0; i < config.num_workers; i++) {
         if (worker_pids[i] > 0) {
             kill(worker_pids[i], SIGTERM);
         }
     }
 
-    // Wait for all workers to exit
-    for (int i = 0; i < config.num_workers; i++) {
-        if (worker_pids[i] > 0) {
-            waitpid(worker_pids[i], NULL, 0);
+    // Wait for workers; each enforces the drain deadline itself, so anything
+    // still alive well past it is stuck and gets killed
+    int grace_ms = (config.drain_timeout_seconds + 5) * 1000;
+    int remaining = config.num_workers;
+    for (int waited_ms = 0; remaining > 0; waited_ms += 100) {
+        remaining = 0;
+        for (int i = 0; i < config.num_workers; i++) {
+            if (worker_pids[i] <= 0) continue;
+            // Children are auto-reaped (SIGCHLD ignored): any non-zero result means gone
+            if (waitpid(worker_pids[i], NULL, WNOHANG) != 0) {
+                worker_pids[i] = 0;
+            } else {
+                remaining++;
+            }
+        }
+        if (remaining > 0 && waited_ms >= grace_ms) {
+            log_message("Master: %d workers did not exit after drain, killing", remaining);
+            for (int i = 0; i < config.num_workers; i++) {
+                if (worker_pids[i] > 0) {
+                    kill(worker_pids[i], SIGKILL);
+                }
+            }
+            grace_ms = INT_MAX;
+        }
+        if (remaining > 0) {
+            usleep(100000);
         }
     }
 
-    close(server_fd);
+    server_stats_t* stats = get_stats();
+    log_message("Drain finished: %lld requests drained, %lld connections dropped",
+                stats->drained_requests, stats->dropped_connections);
+
     free(worker_pids);
+    if (router_ptr) {
+        affinity_destroy(router_ptr);
+    }
     
-    // Cleanup shared memory and semaphore
+    // Cleanup shared memory
     cleanup_stats();
     
     log_message("Shutdown complete");
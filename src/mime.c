@@ -0,0 +1,39 @@
+// MIME type detection
+
+#include "mime.h"
+#include <string.h>
+#include <strings.h>
+
+static const char* mime_names[NUM_MIME_TYPES] = {
+    [MIME_HTML] = "text/html",
+    [MIME_CSS] = "text/css",
+    [MIME_JS] = "application/javascript",
+    [MIME_JPEG] = "image/jpeg",
+    [MIME_PNG] = "image/png",
+    [MIME_GIF] = "image/gif",
+    [MIME_SVG] = "image/svg+xml",
+    [MIME_TEXT] = "text/plain",
+    [MIME_JSON] = "application/json",
+    [MIME_OCTET_STREAM] = "application/octet-stream",
+};
+
+mime_type_t mime_type_for_path(const char* path) {
+    const char* ext = strrchr(path, '.');
+    if (!ext) return MIME_OCTET_STREAM;
+
+    if (strcasecmp(ext, ".html") == 0 || strcasecmp(ext, ".htm") == 0) return MIME_HTML;
+    if (strcasecmp(ext, ".css") == 0) return MIME_CSS;
+    if (strcasecmp(ext, ".js") == 0) return MIME_JS;
+    if (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0) return MIME_JPEG;
+    if (strcasecmp(ext, ".png") == 0) return MIME_PNG;
+    if (strcasecmp(ext, ".gif") == 0) return MIME_GIF;
+    if (strcasecmp(ext, ".svg") == 0) return MIME_SVG;
+    if (strcasecmp(ext, ".txt") == 0) return MIME_TEXT;
+    if (strcasecmp(ext, ".json") == 0) return MIME_JSON;
+
+    return MIME_OCTET_STREAM;
+}
+
+const char* mime_type_name(mime_type_t type) {
+    return type >= 0 && type < NUM_MIME_TYPES ? mime_names[type] : mime_names[MIME_OCTET_STREAM];
+}
@@ -0,0 +1,34 @@
+#ifndef MIME_H
+#define MIME_H
+
+// ============================================================================
+// MIME Types
+// ============================================================================
+// The fixed set of content types the server sends, so per-type counters can
+// live in fixed-size arrays indexed by mime_type_t.
+
+typedef enum {
+    MIME_HTML,
+    MIME_CSS,
+    MIME_JS,
+    MIME_JPEG,
+    MIME_PNG,
+    MIME_GIF,
+    MIME_SVG,
+    MIME_TEXT,
+    MIME_JSON,
+    MIME_OCTET_STREAM,
+    NUM_MIME_TYPES
+} mime_type_t;
+
+/**
+ * Content type for path, from its extension
+ */
+mime_type_t mime_type_for_path(const char* path);
+
+/**
+ * Content-Type value for a mime_type_t
+ */
+const char* mime_type_name(mime_type_t type);
+
+#endif // MIME_H
@@ -0,0 +1,213 @@
+// Per-thread perf_event groups and per-request attribution
+
+#include "perf_counters.h"
+#include "coroutine.h"
+#include "logger.h"
+#include "stats.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PERF_STATE_OFF 0            // Not measured (counting off, or no counters)
+#define PERF_STATE_RUNNING 1        // Charging the current thread since the mark
+#define PERF_STATE_PAUSED 2         // Between threads, or answered
+#define PERF_STATE_SPOILED 3        // Its thread ran other requests meanwhile
+
+static int perf_enabled = 0;
+static int perf_failure_logged = 0;
+
+// The calling thread's counter group
+typedef struct {
+    int opened;                         // Opening was tried (successfully or not)
+    int group_fd;                       // Group leader, -1 if nothing could be opened
+    int members;
+    int slot[NUM_PERF_COUNTERS];        // Position in the group read, -1 if not counted
+} perf_thread_t;
+
+static __thread perf_thread_t thread_perf;
+
+static const struct {
+    unsigned int type;
+    unsigned long long config;
+} perf_events[NUM_PERF_COUNTERS] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static int open_event(int counter, int group_fd, int exclude_kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = perf_events[counter].type;
+    attr.config = perf_events[counter].config;
+    attr.read_format = PERF_FORMAT_GROUP |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    // pid 0, cpu -1: the calling thread, on whichever CPU it runs
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+/**
+ * Open the calling thread's group: each event with kernel time if allowed,
+ * hardware events user-only otherwise, and without the events the host
+ * does not have (no PMU in most VMs)
+ */
+static void open_thread_counters(perf_thread_t* t) {
+    int modes[NUM_PERF_COUNTERS];
+    int error = 0;                      // Reported if nothing opens; EACCES wins over ENOENT
+
+    t->opened = 1;
+    t->group_fd = -1;
+    t->members = 0;
+    for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+        t->slot[counter] = -1;
+        modes[counter] = PERF_EVENT_UNAVAILABLE;
+
+        int mode = PERF_EVENT_ALL;
+        int fd = open_event(counter, t->group_fd, 0);
+        // Context switches happen in the kernel: user-only would always read 0
+        if (fd < 0 && (errno == EACCES || errno == EPERM) &&
+            perf_events[counter].type == PERF_TYPE_HARDWARE) {
+            mode = PERF_EVENT_USER;
+            fd = open_event(counter, t->group_fd, 1);
+        }
+        if (fd < 0) {
+            if (!error || errno == EACCES || errno == EPERM) error = errno;
+            continue;
+        }
+
+        if (t->group_fd < 0) {
+            t->group_fd = fd;
+        }
+        t->slot[counter] = t->members++;
+        modes[counter] = mode;
+    }
+
+    if (t->group_fd < 0) {
+        if (!__atomic_exchange_n(&perf_failure_logged, 1, __ATOMIC_RELAXED)) {
+            log_message("PERF_COUNTERS: no performance counters available (%s); "
+                        "check /proc/sys/kernel/perf_event_paranoid", strerror(error));
+        }
+        return;
+    }
+    record_perf_thread(modes);
+}
+
+static perf_thread_t* thread_counters(void) {
+    if (!perf_enabled) {
+        return NULL;
+    }
+    perf_thread_t* t = &thread_perf;
+    if (!t->opened) {
+        open_thread_counters(t);
+    }
+    return t->group_fd >= 0 ? t : NULL;
+}
+
+static int read_counters(perf_thread_t* t, long long* values, long long* enabled, long long* running) {
+    // PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, one value per member
+    unsigned long long buf[3 + NUM_PERF_COUNTERS];
+    ssize_t expected = (ssize_t)((3 + t->members) * sizeof(buf[0]));
+    if (read(t->group_fd, buf, sizeof(buf)) < expected) {
+        return -1;
+    }
+    *enabled = (long long)buf[1];
+    *running = (long long)buf[2];
+    for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+        values[counter] = t->slot[counter] >= 0 ? (long long)buf[3 + t->slot[counter]] : 0;
+    }
+    return 0;
+}
+
+static void mark_stretch(perf_clock_t* clock, perf_thread_t* t) {
+    if (read_counters(t, clock->mark, &clock->mark_enabled, &clock->mark_running) < 0) {
+        clock->state = PERF_STATE_SPOILED;
+        return;
+    }
+    clock->mark_thread = t;
+    clock->mark_switches = co_switch_count();
+    clock->state = PERF_STATE_RUNNING;
+}
+
+/**
+ * Add what the thread counted since the mark, unless other requests ran on
+ * it meanwhile (another thread, or another coroutine)
+ */
+static void charge_stretch(perf_clock_t* clock) {
+    perf_thread_t* t = thread_counters();
+    long long now[NUM_PERF_COUNTERS];
+    long long enabled, running;
+    if (!t || t != clock->mark_thread || co_switch_count() != clock->mark_switches ||
+        read_counters(t, now, &enabled, &running) < 0) {
+        clock->state = PERF_STATE_SPOILED;
+        return;
+    }
+
+    // With more events than hardware counters the kernel time-slices the
+    // group; scale up to the time it was enabled
+    long long ran = running - clock->mark_running;
+    long long on = enabled - clock->mark_enabled;
+    for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+        long long delta = now[counter] - clock->mark[counter];
+        if (ran > 0 && on > ran) {
+            delta = (long long)((double)delta * on / ran);
+        }
+        clock->counts[counter] += delta;
+    }
+    clock->state = PERF_STATE_PAUSED;
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+void perf_counters_enable(int enabled) {
+    perf_enabled = enabled;
+    set_perf_counters_enabled(enabled);
+}
+
+void perf_request_start(perf_clock_t* clock) {
+    clock->state = PERF_STATE_OFF;
+    perf_thread_t* t = thread_counters();
+    if (!t) {
+        return;
+    }
+    memset(clock->counts, 0, sizeof(clock->counts));
+    mark_stretch(clock, t);
+}
+
+void perf_request_pause(perf_clock_t* clock) {
+    if (clock->state == PERF_STATE_RUNNING) {
+        charge_stretch(clock);
+    }
+}
+
+void perf_request_resume(perf_clock_t* clock) {
+    if (clock->state != PERF_STATE_PAUSED) {
+        return;
+    }
+    perf_thread_t* t = thread_counters();
+    if (t) {
+        mark_stretch(clock, t);
+    } else {
+        clock->state = PERF_STATE_SPOILED;
+    }
+}
+
+void perf_request_end(perf_clock_t* clock, int perf_class) {
+    perf_request_pause(clock);
+    if (clock->state == PERF_STATE_PAUSED) {
+        record_perf_request(perf_class, clock->counts);
+    } else if (clock->state == PERF_STATE_SPOILED) {
+        record_perf_unattributed();
+    }
+    clock->state = PERF_STATE_OFF;
+}
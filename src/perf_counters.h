@@ -0,0 +1,75 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// ============================================================================
+// Hardware Performance Counters per Request Class
+// ============================================================================
+// With PERF_COUNTERS=1 each request-path thread opens one perf_event group
+// counting its own cycles, instructions, cache misses and context switches.
+// A request reads the group when it starts running on a thread and when it
+// leaves it; the difference is charged to the request's class once the
+// response is sent. Events the host does not allow are left out. A request
+// whose thread ran other coroutines in between (it parked on a socket) is
+// only counted as unattributed, since the difference is not its own.
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,          // Last-level cache misses
+    PERF_CONTEXT_SWITCHES,
+    NUM_PERF_COUNTERS
+} perf_counter_t;
+
+typedef enum {
+    PERF_CLASS_CACHE_HIT,       // 200 from the file cache
+    PERF_CLASS_CACHE_MISS,      // 200 read from disk (or no cache)
+    PERF_CLASS_LARGE_FILE,      // 200 too big for the cache (over MAX_FILE_SIZE)
+    PERF_CLASS_MONITORING,      // /health, /metrics, /stats, /debug endpoints
+    PERF_CLASS_OTHER,           // Errors and everything else
+    NUM_PERF_CLASSES
+} perf_class_t;
+
+// How an event could be opened (perf_event_paranoid decides)
+#define PERF_EVENT_UNAVAILABLE 0
+#define PERF_EVENT_USER 1           // User-space time only
+#define PERF_EVENT_ALL 2            // User and kernel
+
+const char* perf_counter_name(int counter);
+const char* perf_class_name(int perf_class);
+
+// One request's counts so far, over every thread it ran on
+typedef struct {
+    long long counts[NUM_PERF_COUNTERS];
+    long long mark[NUM_PERF_COUNTERS];  // Group values when the current stretch began
+    long long mark_enabled;             // and its enabled/running times, to scale
+    long long mark_running;             // for multiplexing
+    unsigned long mark_switches;        // Coroutine switches on the thread at the mark
+    const void* mark_thread;
+    int state;                          // PERF_STATE_* (perf_counters.c)
+} perf_clock_t;
+
+/**
+ * Turn counting on for threads that serve requests from now on (call before
+ * forking workers)
+ */
+void perf_counters_enable(int enabled);
+
+/**
+ * Start measuring a new request on the calling thread (opens the thread's
+ * counters on first use); a no-op when counting is off
+ */
+void perf_request_start(perf_clock_t* clock);
+
+/**
+ * Stop charging the request to this thread before it moves to another one
+ * or parks; perf_request_resume() picks it up again
+ */
+void perf_request_pause(perf_clock_t* clock);
+void perf_request_resume(perf_clock_t* clock);
+
+/**
+ * The request is answered: charge what it cost to perf_class
+ */
+void perf_request_end(perf_clock_t* clock, int perf_class);
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,68 @@
+#ifndef PHASE_TIMING_H
+#define PHASE_TIMING_H
+
+// ============================================================================
+// Request Phase Timing
+// ============================================================================
+// Built with -DPHASE_TIMING (the Makefile default; `make PHASE_TIMING=0`
+// strips it out), the request path takes a monotonic timestamp at each phase
+// boundary and records the microseconds spent in the phase that just ended
+// in a per-phase histogram, and in the request's own phase_clock_t for the
+// slow-request recorder. Without it the marks compile to nothing (and every
+// phase reads 0).
+
+typedef enum {
+    PHASE_RECV,         // Reading the request headers off the socket
+    PHASE_PARSE,        // Request line and header parsing
+    PHASE_PATH,         // Path sanitizing, resolution and the request log line
+    PHASE_CACHE,        // File cache lookup
+    PHASE_FILE,         // Cache miss: open/stat/read (or waiting on the disk pool)
+    PHASE_HEADER,       // Building the response (headers, endpoint bodies)
+    PHASE_SEND,         // Writing the response (up to the hand-off to the writer)
+    NUM_PHASES
+} request_phase_t;
+
+const char* phase_name(int phase);
+
+// One request's phase boundary and the time charged to each phase so far
+typedef struct {
+    long long mark_ns;
+    long long phase_us[NUM_PHASES];
+} phase_clock_t;
+
+#ifdef PHASE_TIMING
+
+#include <string.h>
+#include <time.h>
+
+void record_phase_time(int phase, long long time_us);
+
+static inline long long phase_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Start timing a new request on clock
+#define PHASE_MARK(clock) do {                              \
+        memset(&(clock), 0, sizeof(clock));                 \
+        (clock).mark_ns = phase_now_ns();                   \
+    } while (0)
+
+// Charge the time since the last mark to phase, and mark again
+#define PHASE_END(clock, phase) do {                        \
+        long long phase_now_ = phase_now_ns();              \
+        long long phase_us_ = (phase_now_ - (clock).mark_ns) / 1000; \
+        record_phase_time((phase), phase_us_);              \
+        (clock).phase_us[phase] += phase_us_;               \
+        (clock).mark_ns = phase_now_;                       \
+    } while (0)
+
+#else
+
+#define PHASE_MARK(clock) ((void)0)
+#define PHASE_END(clock, phase) ((void)0)
+
+#endif // PHASE_TIMING
+
+#endif // PHASE_TIMING_H
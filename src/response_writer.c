@@ -0,0 +1,318 @@
+// Per-worker writer loop that finishes responses for slow clients
+
+#define _GNU_SOURCE
+#include "response_writer.h"
+#include "logger.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+#define WRITER_MAX_EVENTS 64
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
+static void wake(response_writer_t* writer) {
+    uint64_t one = 1;
+    ssize_t ignored = write(writer->wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+/**
+ * Release a job: the connection goes back to the event loop if it finished
+ * and is kept alive, otherwise it is closed
+ */
+static void job_finish(response_writer_t* writer, write_job_t* job, int ok) {
+    epoll_ctl(writer->epoll_fd, EPOLL_CTL_DEL, job->fd, NULL);
+    timer_wheel_cancel(&writer->timers, &job->timer);
+
+    if (job->file_fd >= 0) {
+        close(job->file_fd);
+    }
+    free(job->buf);
+
+    // The pool thread left the connection counted as active until now
+    decrement_active_connections();
+    if (ok && job->keep_alive) {
+        if (writer->threaded) {
+            event_loop_return(writer->loop, job->fd);
+        } else {
+            event_loop_add_idle(writer->loop, job->fd);
+        }
+    } else {
+        close(job->fd);
+    }
+    free(job);
+
+    pthread_mutex_lock(&writer->lock);
+    writer->pending--;
+    pthread_mutex_unlock(&writer->lock);
+}
+
+/**
+ * Write as much as the socket takes
+ * Returns: 1 when done, 0 to wait for EPOLLOUT, -1 on error
+ */
+static int job_progress(write_job_t* job) {
+    while (job->off < job->len) {
+        int more = job->file_fd >= 0 ? MSG_MORE : 0;
+        ssize_t sent = send(job->fd, job->buf + job->off, job->len - job->off,
+                            more | MSG_NOSIGNAL);
+        if (sent > 0) {
+            job->off += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        return -1;
+    }
+
+    while (job->file_fd >= 0 && job->file_off < job->file_end) {
+        ssize_t sent = sendfile(job->fd, job->file_fd, &job->file_off,
+                                job->file_end - job->file_off);
+        if (sent > 0) continue;
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        return -1;   // error, or the file shrank under us
+    }
+
+    return 1;
+}
+
+static void on_deadline(timer_node_t* node, void* ctx) {
+    response_writer_t* writer = ctx;
+    writer->timeouts++;
+    job_finish(writer, (write_job_t*)node, 0);
+}
+
+static void take_submitted(response_writer_t* writer) {
+    uint64_t value;
+    while (read(writer->wake_fd, &value, sizeof(value)) > 0) {
+        // drain the eventfd counter
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    write_job_t* job = writer->submitted;
+    writer->submitted = NULL;
+    pthread_mutex_unlock(&writer->lock);
+
+    // Bring the wheel's clock up to date before arming new deadlines
+    timer_wheel_advance(&writer->timers, monotonic_ms(), on_deadline, writer);
+
+    while (job) {
+        write_job_t* next = job->next;
+        struct epoll_event ev;
+        ev.events = EPOLLOUT;
+        ev.data.ptr = job;
+        if (epoll_ctl(writer->epoll_fd, EPOLL_CTL_ADD, job->fd, &ev) < 0) {
+            writer->errors++;
+            job_finish(writer, job, 0);
+        } else {
+            timer_wheel_add(&writer->timers, &job->timer, job->timeout_ms);
+        }
+        job = next;
+    }
+}
+
+static void close_on_stop(timer_node_t* node, void* ctx) {
+    job_finish((response_writer_t*)ctx, (write_job_t*)node, 0);
+}
+
+// ============================================================================
+// Writer Pass
+// ============================================================================
+static void writer_pass(response_writer_t* writer, int timeout_ms) {
+    struct epoll_event events[WRITER_MAX_EVENTS];
+
+    int n = epoll_wait(writer->epoll_fd, events, WRITER_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        if (errno != EINTR) {
+            log_message("Response writer: epoll_wait error: %s", strerror(errno));
+        }
+        n = 0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        void* tag = events[i].data.ptr;
+        if (tag == &writer->wake_fd) {
+            take_submitted(writer);
+            continue;
+        }
+
+        write_job_t* job = tag;
+        int result = job_progress(job);
+        if (result > 0) {
+            writer->completed++;
+            job_finish(writer, job, 1);
+        } else if (result < 0) {
+            writer->errors++;
+            job_finish(writer, job, 0);
+        }
+    }
+
+    timer_wheel_advance(&writer->timers, monotonic_ms(), on_deadline, writer);
+}
+
+static void* writer_thread(void* arg) {
+    response_writer_t* writer = arg;
+    stats_bind_thread();
+
+    while (1) {
+        writer_pass(writer, timer_wheel_next_timeout_ms(&writer->timers, monotonic_ms()));
+
+        pthread_mutex_lock(&writer->lock);
+        int stopping = writer->stopping;
+        pthread_mutex_unlock(&writer->lock);
+        if (stopping) {
+            break;
+        }
+    }
+
+    take_submitted(writer);
+    timer_wheel_expire_all(&writer->timers, close_on_stop, writer);
+    return NULL;
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+int response_writer_init(response_writer_t* writer, event_loop_t* loop, int threaded) {
+    memset(writer, 0, sizeof(*writer));
+    writer->loop = loop;
+    writer->threaded = threaded;
+    timer_wheel_init(&writer->timers, LOOP_TICK_MS, monotonic_ms());
+
+    writer->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (writer->epoll_fd < 0) {
+        log_message("Response writer: epoll_create1 failed: %s", strerror(errno));
+        return -1;
+    }
+
+    writer->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (writer->wake_fd < 0) {
+        log_message("Response writer: eventfd failed: %s", strerror(errno));
+        close(writer->epoll_fd);
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &writer->wake_fd;
+    epoll_ctl(writer->epoll_fd, EPOLL_CTL_ADD, writer->wake_fd, &ev);
+
+    pthread_mutex_init(&writer->lock, NULL);
+
+    if (!threaded) {
+        // Inline: the event loop drives this writer through its poller hook
+        return event_loop_add_poller(loop, writer->epoll_fd, response_writer_poll,
+                                     response_writer_next_timeout_ms, writer);
+    }
+
+    if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0) {
+        log_message("Response writer: failed to create thread");
+        pthread_mutex_destroy(&writer->lock);
+        close(writer->wake_fd);
+        close(writer->epoll_fd);
+        return -1;
+    }
+    return 0;
+}
+
+int response_writer_submit(response_writer_t* writer, int client_fd,
+                           const char* head, size_t head_len,
+                           const char* body, size_t body_len,
+                           int file_fd, off_t file_off, off_t file_end,
+                           int keep_alive, long long timeout_ms) {
+    write_job_t* job = calloc(1, sizeof(write_job_t));
+    if (!job) {
+        return -1;
+    }
+
+    // Header and body usually live in the pool thread's arena or the cache:
+    // copy what is left so both can be reused immediately
+    job->len = head_len + body_len;
+    if (job->len > 0) {
+        job->buf = malloc(job->len);
+        if (!job->buf) {
+            free(job);
+            return -1;
+        }
+        if (head_len > 0) memcpy(job->buf, head, head_len);
+        if (body_len > 0) memcpy(job->buf + head_len, body, body_len);
+    }
+
+    job->file_fd = -1;
+    if (file_fd >= 0 && file_off < file_end) {
+        job->file_fd = dup(file_fd);
+        if (job->file_fd < 0) {
+            free(job->buf);
+            free(job);
+            return -1;
+        }
+        job->file_off = file_off;
+        job->file_end = file_end;
+    }
+
+    job->fd = client_fd;
+    job->keep_alive = keep_alive;
+    job->timeout_ms = timeout_ms > 0 ? timeout_ms : 0;
+
+    pthread_mutex_lock(&writer->lock);
+    job->next = writer->submitted;
+    writer->submitted = job;
+    writer->pending++;
+    writer->offloaded++;
+    pthread_mutex_unlock(&writer->lock);
+
+    wake(writer);
+    return 0;
+}
+
+int response_writer_pending(response_writer_t* writer) {
+    pthread_mutex_lock(&writer->lock);
+    int pending = writer->pending;
+    pthread_mutex_unlock(&writer->lock);
+    return pending;
+}
+
+void response_writer_poll(void* arg) {
+    writer_pass((response_writer_t*)arg, 0);
+}
+
+int response_writer_next_timeout_ms(void* arg) {
+    response_writer_t* writer = arg;
+    return timer_wheel_next_timeout_ms(&writer->timers, monotonic_ms());
+}
+
+void response_writer_destroy(response_writer_t* writer) {
+    if (writer->threaded) {
+        pthread_mutex_lock(&writer->lock);
+        writer->stopping = 1;
+        pthread_mutex_unlock(&writer->lock);
+        wake(writer);
+
+        pthread_join(writer->thread, NULL);
+    } else {
+        take_submitted(writer);
+        timer_wheel_expire_all(&writer->timers, close_on_stop, writer);
+    }
+
+    pthread_mutex_destroy(&writer->lock);
+    close(writer->wake_fd);
+    close(writer->epoll_fd);
+}
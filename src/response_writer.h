@@ -0,0 +1,95 @@
+#ifndef RESPONSE_WRITER_H
+#define RESPONSE_WRITER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "event_loop.h"
+#include "timer_wheel.h"
+
+// ============================================================================
+// Slow-Client Write Offload
+// ============================================================================
+// One writer thread per worker. Pool threads write responses without
+// blocking; whatever a slow client's socket cannot take in that first pass is
+// handed here and finished from an epoll loop, so the pool thread is free
+// for the next request. The write deadline is kept in a timer wheel.
+// In thread-per-core mode the writer has no thread of its own and is driven
+// by the core's event loop instead.
+
+typedef struct write_job {
+    timer_node_t timer;         // Must be first: timer callbacks cast back to write_job_t
+    int fd;
+    char* buf;                  // Unsent header/body bytes (owned copy)
+    size_t len;
+    size_t off;
+    int file_fd;                // dup()ed file for sendfile, or -1
+    off_t file_off;
+    off_t file_end;
+    int keep_alive;
+    long long timeout_ms;       // Write deadline, armed when the writer picks it up
+    struct write_job* next;     // Submission list
+} write_job_t;
+
+typedef struct {
+    int epoll_fd;
+    int wake_fd;                // eventfd: new jobs or stop request
+    pthread_t thread;
+    int threaded;               // 0 = run inline on the event loop thread
+    event_loop_t* loop;         // Finished keep-alive connections go back here
+
+    pthread_mutex_t lock;
+    write_job_t* submitted;     // Handed over, not yet picked up by the thread
+    int pending;                // Submitted and not yet finished
+    int stopping;
+
+    timer_wheel_t timers;       // Writer thread only
+
+    // Counters (writer thread only, except offloaded)
+    unsigned long offloaded;
+    unsigned long completed;
+    unsigned long timeouts;
+    unsigned long errors;
+} response_writer_t;
+
+// ============================================================================
+// Response Writer Functions
+// ============================================================================
+
+/**
+ * Start the writer thread, or with threaded = 0 attach it to loop's thread
+ * Returns: 0 on success, -1 on error
+ */
+int response_writer_init(response_writer_t* writer, event_loop_t* loop, int threaded);
+
+/**
+ * Hand over the rest of a response (thread-safe, called by pool threads).
+ * head/body are copied; file_fd is dup()ed and sent from file_off to file_end.
+ * The writer owns client_fd from here on: it is returned to the event loop
+ * after the last byte if keep_alive, otherwise closed.
+ * Returns: 0 on success, -1 on error (caller still owns client_fd)
+ */
+int response_writer_submit(response_writer_t* writer, int client_fd,
+                           const char* head, size_t head_len,
+                           const char* body, size_t body_len,
+                           int file_fd, off_t file_off, off_t file_end,
+                           int keep_alive, long long timeout_ms);
+
+/**
+ * Number of responses handed over and not yet finished
+ */
+int response_writer_pending(response_writer_t* writer);
+
+/**
+ * Inline mode: one non-blocking pass, and the time until the next deadline
+ * (event loop poller callbacks)
+ */
+void response_writer_poll(void* writer);
+int response_writer_next_timeout_ms(void* writer);
+
+/**
+ * Stop the writer thread and close any unfinished connections
+ */
+void response_writer_destroy(response_writer_t* writer);
+
+#endif // RESPONSE_WRITER_H
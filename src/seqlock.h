@@ -0,0 +1,54 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+// ============================================================================
+// Sequence Counters for Single-Writer Shared Blocks
+// ============================================================================
+// The one writer makes the counter odd, stores the fields with relaxed
+// atomics and makes it even again; readers copy the fields and retry if the
+// counter was odd or moved meanwhile. Writers never wait and readers never
+// block them. A writer process that dies mid-update leaves the counter odd
+// for good, so readers give up after SEQLOCK_READ_ATTEMPTS and keep the
+// last (possibly mixed) copy.
+
+#define SEQLOCK_READ_ATTEMPTS 64
+
+static inline void seqlock_write_begin(unsigned int* seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * seqlock_write_begin() for blocks any thread may write: claims the block
+ * unless another writer is inside it, never waiting
+ * Returns: 1 if claimed (finish with seqlock_write_end()), 0 otherwise
+ */
+static inline int seqlock_try_write_begin(unsigned int* seq) {
+    unsigned int start = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    if ((start & 1) ||
+        !__atomic_compare_exchange_n(seq, &start, start + 1, 0,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return 1;
+}
+
+static inline void seqlock_write_end(unsigned int* seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline unsigned int seqlock_read_begin(const unsigned int* seq) {
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Returns: non-zero if the copy taken since seqlock_read_begin() returned
+ * start may be torn and must be retaken
+ */
+static inline int seqlock_read_retry(const unsigned int* seq, unsigned int start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (start & 1) || __atomic_load_n(seq, __ATOMIC_RELAXED) != start;
+}
+
+#endif // SEQLOCK_H
@@ -8,6 +8,10 @@
 #include "thread_pool.h"
 #include "connection_queue.h"
 #include "file_cache.h"
+#include "arena.h"
+#include "event_loop.h"
+#include "response_writer.h"
+#include "disk_io.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,7 +22,10 @@
 #include <signal.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #define BACKLOG 128
 
@@ -39,6 +46,9 @@ int create_server_socket(int port) {
 #ifdef SO_REUSEPORT
     setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
 #endif
+    // Only wake accept() once the request has arrived, so classification can peek it
+    int defer_secs = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_secs, sizeof(defer_secs));
 
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
@@ -58,9 +68,36 @@ int create_server_socket(int port) {
         return -1;
     }
 
+    // Workers' event loops share the listener; losers of the accept race must not block
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK);
+
     return sockfd;
 }
 
+// ============================================================================
+// Listen Backlog
+// ============================================================================
+/**
+ * Accept queue of a listening socket: on a listener TCP_INFO reports the
+ * connections waiting for accept() in tcpi_unacked and the backlog limit in
+ * tcpi_sacked. listener_id (the socket inode) tells apart listeners shared
+ * by several workers.
+ * Returns: 0 on success, -1 on error
+ */
+int listen_queue_info(int listen_fd, long long* queued, long long* limit, long long* listener_id) {
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    struct stat st;
+    if (getsockopt(listen_fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0 ||
+        fstat(listen_fd, &st) != 0) {
+        return -1;
+    }
+    *queued = info.tcpi_unacked;
+    *limit = info.tcpi_sacked;
+    *listener_id = (long long)st.st_ino;
+    return 0;
+}
+
 // ============================================================================
 // Thread Pool Worker Context
 // ============================================================================
@@ -70,8 +107,33 @@ typedef struct {
     int thread_id;
     const server_config_t* config;
     file_cache_t* cache;
+    event_loop_t* loop;
+    response_writer_t* writer;
+    disk_io_pool_t* disk;
 } thread_context_t;
 
+// ============================================================================
+// Worker Dispatch Context (event loop thread)
+// ============================================================================
+typedef struct {
+    int worker_id;
+    const server_config_t* config;
+    connection_queue_t* queue;
+    thread_pool_t* pool;
+    file_cache_t* cache;
+    response_writer_t* writer;
+    disk_io_pool_t* disk;
+    affinity_router_t* router;
+    event_loop_t* loop;
+    int affinity_fd;
+    int draining;
+
+    unsigned long class_accepted[NUM_QUEUE_CLASSES];
+    unsigned long total_rejected;
+    unsigned long handed_off;
+    unsigned long received;
+} worker_context_t;
+
 // ============================================================================
 // Thread Pool Worker Function
 // ============================================================================
@@ -81,29 +143,60 @@ void* thread_worker(void* arg) {
     log_message("Worker %d: Thread %d started (TID: %lu)", 
                ctx->worker_id, ctx->thread_id, (unsigned long)pthread_self());
     
+    // Per-thread request arena, reset after every connection
+    arena_t arena;
+    if (arena_init(&arena, (size_t)ctx->config->arena_size_kb * 1024) != 0) {
+        log_message("Worker %d: Thread %d failed to allocate request arena",
+                    ctx->worker_id, ctx->thread_id);
+        free(ctx);
+        return NULL;
+    }
+    size_t published_high_water = 0;
+    
     thread_pool_increment_active(ctx->pool);
+    stats_bind_thread();
     
     while (1) {
         // Consumer: dequeue connection from bounded queue
-        int client_fd = connection_queue_dequeue(ctx->pool->queue);
+        long long queued_ns = 0;
+        int client_fd = connection_queue_dequeue_timed(ctx->pool->queue, &queued_ns);
         
         if (client_fd < 0) {
             // Shutdown signal
             break;
         }
         
-        // Set socket timeouts
-        struct timeval tv;
-        tv.tv_sec = ctx->config->timeout_seconds;
-        tv.tv_usec = 0;
-        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        thread_pool_mark_busy(ctx->pool);
+        
+        // Handle the connection; deadlines come from the event loop's timer
+        // wheel and the write deadline in conn, not per-socket timeouts
+        http_conn_t conn = {
+            .fd = client_fd,
+            .config = ctx->config,
+            .cache = ctx->cache,
+            .arena = &arena,
+            .writer = ctx->writer,
+            .disk = ctx->disk,
+            .loop = ctx->loop,
+            .trace.queue_wait_us = queued_ns / 1000,
+        };
+        if (handle_client_connection(&conn)) {
+            // Keep-alive: wait for the next request in the event loop, not here
+            event_loop_return(ctx->loop, client_fd);
+        }
+        
+        // Only touch shared stats when this thread sets a new record
+        if (arena.high_water > published_high_water) {
+            published_high_water = arena.high_water;
+            update_arena_high_water((long long)published_high_water);
+        }
+        arena_reset(&arena);
         
-        // Handle the connection
-        handle_client_connection(client_fd, ctx->config, ctx->cache);
+        thread_pool_mark_idle(ctx->pool);
     }
     
     thread_pool_decrement_active(ctx->pool);
+    arena_destroy(&arena);
     
     log_message("Worker %d: Thread %d exiting", ctx->worker_id, ctx->thread_id);
     free(ctx);
@@ -132,136 +225,181 @@ void send_503_response(int client_fd) {
         "<p>Server is overloaded. Please try again later.</p>"
         "</body></html>";
     update_stats_with_code(strlen(response), 503);
-    send(client_fd, response, strlen(response), 0);
+    send(client_fd, response, strlen(response), MSG_DONTWAIT | MSG_NOSIGNAL);
     close(client_fd);
 }
 
 // ============================================================================
-// Check if request is for a priority endpoint (metrics, health, stats)
+// Extract the path from a (peeked) request line
 // ============================================================================
-int is_priority_endpoint(int client_fd) {
-    char buffer[512];
-    
-    // Peek at the request without consuming it
-    ssize_t bytes = recv(client_fd, buffer, sizeof(buffer) - 1, MSG_PEEK);
-    if (bytes <= 0) {
-        return 0;
-    }
-    
-    buffer[bytes] = '\0';
-    
-    // Check if it's a GET/HEAD request for priority endpoints
-    if (strstr(buffer, "GET /metrics") == buffer || 
-        strstr(buffer, "HEAD /metrics") == buffer ||
-        strstr(buffer, "GET /health") == buffer || 
-        strstr(buffer, "HEAD /health") == buffer ||
-        strstr(buffer, "GET /stats") == buffer || 
-        strstr(buffer, "HEAD /stats") == buffer) {
-        return 1;
+int parse_request_path(const char* request, char* path, size_t path_size) {
+    char method[16], target[256];
+    if (sscanf(request, "%15s %255s", method, target) != 2) {
+        return -1;
     }
-    
+
+    snprintf(path, path_size, "%s", target);
     return 0;
 }
 
 // ============================================================================
-// Handle priority endpoints immediately (bypass queue)
+// Admit a connection into the worker's queue (or answer 503)
 // ============================================================================
-void handle_priority_endpoint(int client_fd) {
-    char buffer[512];
-    ssize_t bytes = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
-    
-    if (bytes <= 0) {
-        close(client_fd);
-        return;
-    }
-    
-    buffer[bytes] = '\0';
-    
-    // Quick parse - just get the path
-    char method[16], path[256];
-    if (sscanf(buffer, "%15s %255s", method, path) != 2) {
-        close(client_fd);
-        return;
-    }
-    
-    // Handle each priority endpoint
-    if (strcmp(path, "/metrics") == 0 || strcmp(path, "/metrics/") == 0) {
-        size_t response_len;
-        char* body = generate_metrics_response(&response_len);
-        
-        char header[256];
-        int header_len = snprintf(header, sizeof(header),
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Type: text/plain; version=0.0.4\r\n"
-            "Content-Length: %zu\r\n"
-            "X-Priority: high\r\n"
-            "Connection: close\r\n"
-            "\r\n",
-            response_len);
+static void admit_connection(worker_context_t* wctx, int client_fd, int class_id) {
+    wctx->class_accepted[class_id]++;
+
+    // Try to enqueue connection (non-blocking)
+    int evicted_fd = -1;
+    if (connection_queue_try_enqueue(wctx->queue, client_fd, class_id, &evicted_fd) != 0) {
+        // Class is full - reject with 503
+        wctx->total_rejected++;
+        record_rejected();
+        send_503_response(client_fd);
         
-        send(client_fd, header, header_len, 0);
-        if (strcmp(method, "GET") == 0) {
-            send(client_fd, body, response_len, 0);
+        // Log every 100 rejections to avoid log spam
+        if (wctx->total_rejected % 100 == 1) {
+            log_message("Worker %d: %s queue full, rejected %lu connections so far", 
+                       wctx->worker_id, queue_class_name(class_id), wctx->total_rejected);
         }
-        // Don't free - body is static buffer
-        update_stats_with_code(response_len, 200);
+    } else if (evicted_fd >= 0) {
+        // Drop-oldest class: the displaced connection gets the 503
+        wctx->total_rejected++;
+        record_rejected();
+        send_503_response(evicted_fd);
     }
-    else if (strcmp(path, "/health") == 0 || strcmp(path, "/health/") == 0) {
-        size_t response_len;
-        char* body = generate_health_response(&response_len);
-        
-        char header[256];
-        int header_len = snprintf(header, sizeof(header),
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Type: application/json\r\n"
-            "Content-Length: %zu\r\n"
-            "X-Priority: high\r\n"
-            "Connection: close\r\n"
-            "\r\n",
-            response_len);
-        
-        send(client_fd, header, header_len, 0);
-        if (strcmp(method, "GET") == 0) {
-            send(client_fd, body, response_len, 0);
+}
+
+// ============================================================================
+// Event Loop Callbacks
+// ============================================================================
+
+/**
+ * A connection's request headers are complete: classify, route, enqueue
+ */
+static void dispatch_request(void* arg, int client_fd, const char* request, size_t len) {
+    worker_context_t* wctx = arg;
+    (void)len;
+
+    // Route into a traffic class; /health, /metrics and /stats go to the
+    // control class so they stay fast while bulk downloads queue
+    char path[256];
+    int have_path = (parse_request_path(request, path, sizeof(path)) == 0);
+    int class_id = have_path ? connection_queue_classify(wctx->config, path)
+                             : wctx->config->queue_default_class;
+
+    // Cache affinity: hand file requests to the worker that caches them
+    // (not while draining: the owner may already have finished)
+    if (wctx->router && !wctx->draining && have_path && class_id != QUEUE_CLASS_CONTROL) {
+        int owner = affinity_owner(wctx->router, path);
+        if (owner != wctx->worker_id && affinity_send(wctx->router, owner, client_fd) == 0) {
+            close(client_fd);
+            wctx->handed_off++;
+            return;
         }
-        // Don't free - body is static buffer
-        update_stats_with_code(response_len, 200);
     }
-    else if (strcmp(path, "/stats") == 0 || strcmp(path, "/stats/") == 0) {
-        size_t response_len;
-        char* body = generate_stats_json_response(&response_len);
-        
-        char header[256];
-        int header_len = snprintf(header, sizeof(header),
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Type: application/json\r\n"
-            "Content-Length: %zu\r\n"
-            "X-Priority: high\r\n"
-            "Connection: close\r\n"
-            "\r\n",
-            response_len);
-        
-        send(client_fd, header, header_len, 0);
-        if (strcmp(method, "GET") == 0) {
-            send(client_fd, body, response_len, 0);
-        }
-        // Don't free - body is static buffer
-        update_stats_with_code(response_len, 200);
+
+    admit_connection(wctx, client_fd, class_id);
+}
+
+/**
+ * Drain is complete once nothing is queued, no pool thread is busy, every
+ * disk load has completed and the writer has flushed every offloaded response
+ */
+static int drain_done(void* arg) {
+    worker_context_t* wctx = arg;
+    return connection_queue_size(wctx->queue) == 0 &&
+           thread_pool_get_busy_threads(wctx->pool) == 0 &&
+           (!wctx->disk || disk_io_pending(wctx->disk) == 0) &&
+           (!wctx->writer || response_writer_pending(wctx->writer) == 0);
+}
+
+/**
+ * Sockets routed to us because we own their path's cache bucket
+ */
+static void receive_handoffs(void* arg) {
+    worker_context_t* wctx = arg;
+    int client_fd;
+    while ((client_fd = affinity_recv(wctx->affinity_fd)) >= 0) {
+        wctx->received++;
+        event_loop_add(wctx->loop, client_fd);
     }
-    
-    close(client_fd);
+}
+
+/**
+ * Publish this worker's gauges to its stats block (loop ticker)
+ */
+static void publish_gauges(void* arg) {
+    worker_context_t* wctx = arg;
+    worker_stats_t gauges = {
+        .queue_depth = connection_queue_size(wctx->queue),
+        .queue_peak = connection_queue_take_peak(wctx->queue),
+        .busy_threads = thread_pool_get_busy_threads(wctx->pool),
+        .threads = thread_pool_get_active_threads(wctx->pool),
+    };
+    unsigned long spin_hist[WAKEUP_HIST_BUCKETS], park_hist[WAKEUP_HIST_BUCKETS];
+    connection_queue_wakeup_stats(wctx->queue, spin_hist, park_hist);
+    for (int b = 0; b < WAKEUP_HIST_BUCKETS; b++) {
+        gauges.wake_spin[b] = (long long)spin_hist[b];
+        gauges.wake_park[b] = (long long)park_hist[b];
+    }
+    listen_queue_info(wctx->loop->listen_fd, &gauges.listen_backlog,
+                      &gauges.listen_backlog_limit, &gauges.listener_id);
+    if (wctx->cache) {
+        int entries;
+        size_t total_size;
+        file_cache_stats(wctx->cache, &entries, &total_size);
+        gauges.cache_entries = entries;
+        gauges.cache_bytes = (long long)total_size;
+    }
+    publish_worker_stats(&gauges);
+}
+
+// ============================================================================
+// Log consumer wakeup latency (spin vs park)
+// ============================================================================
+static long wakeup_percentile_us(const unsigned long* hist, unsigned long total, double q) {
+    unsigned long target = (unsigned long)(total * q);
+    unsigned long seen = 0;
+    for (int b = 0; b < WAKEUP_HIST_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen > target) return 1L << b;   // upper bound of bucket b
+    }
+    return 1L << (WAKEUP_HIST_BUCKETS - 1);
+}
+
+static void log_wakeup_stats(int worker_id, connection_queue_t* queue) {
+    unsigned long spin_hist[WAKEUP_HIST_BUCKETS], park_hist[WAKEUP_HIST_BUCKETS];
+    connection_queue_wakeup_stats(queue, spin_hist, park_hist);
+
+    unsigned long spun = 0, parked = 0;
+    for (int b = 0; b < WAKEUP_HIST_BUCKETS; b++) {
+        spun += spin_hist[b];
+        parked += park_hist[b];
+    }
+
+    log_message("Worker %d: Consumer wakeups - spun: %lu (p50 <%ldus, p99 <%ldus), parked: %lu (p50 <%ldus, p99 <%ldus)",
+                worker_id,
+                spun, spun ? wakeup_percentile_us(spin_hist, spun, 0.50) : 0L,
+                spun ? wakeup_percentile_us(spin_hist, spun, 0.99) : 0L,
+                parked, parked ? wakeup_percentile_us(park_hist, parked, 0.50) : 0L,
+                parked ? wakeup_percentile_us(park_hist, parked, 0.99) : 0L);
 }
 
 // ============================================================================
 // Worker Process Loop (com Thread Pool)
 // ============================================================================
-void worker_process(int server_fd, int worker_id, const server_config_t* config) {
+void worker_process(int server_fd, int worker_id, const server_config_t* config,
+                    affinity_router_t* router) {
     // Setup signal handler for worker
     signal(SIGTERM, worker_signal_handler);
     signal(SIGINT, worker_signal_handler);
     
     log_message("Worker %d started (PID: %d) with %d threads", 
                worker_id, getpid(), config->threads_per_worker);
+    
+    // The event loop thread finishes disk loads and counts them in its own shard
+    stats_set_worker(worker_id);
+    stats_bind_thread();
 
     // Initialize file cache for this worker (if enabled)
     file_cache_t cache;
@@ -280,20 +418,71 @@ void worker_process(int server_fd, int worker_id, const server_config_t* config)
 
     // Initialize connection queue (bounded circular buffer with semaphores)
     connection_queue_t conn_queue;
-    if (connection_queue_init(&conn_queue) != 0) {
+    if (connection_queue_init(&conn_queue, config) != 0) {
         log_message("Worker %d: Failed to initialize connection queue", worker_id);
         if (cache_ptr) file_cache_destroy(cache_ptr);
         return;
     }
     
+    // Initialize event loop (accepts, header-read and keep-alive deadlines)
+    worker_context_t wctx;
+    memset(&wctx, 0, sizeof(wctx));
+    wctx.worker_id = worker_id;
+    wctx.config = config;
+    wctx.queue = &conn_queue;
+    wctx.cache = cache_ptr;
+    wctx.router = router;
+    wctx.affinity_fd = -1;
+    
+    event_loop_t loop;
+    if (event_loop_init(&loop, server_fd, config, dispatch_request, &wctx) != 0) {
+        log_message("Worker %d: Failed to initialize event loop", worker_id);
+        connection_queue_destroy(&conn_queue);
+        if (cache_ptr) file_cache_destroy(cache_ptr);
+        return;
+    }
+    wctx.loop = &loop;
+    
+    // With cache affinity, also watch for sockets handed over by other workers
+    if (router) {
+        wctx.affinity_fd = affinity_setup_worker(router, worker_id);
+        event_loop_set_aux(&loop, wctx.affinity_fd, receive_handoffs);
+    }
+    
+    // Slow clients: responses that do not fit in the first write finish here
+    response_writer_t writer;
+    if (config->write_offload) {
+        if (response_writer_init(&writer, &loop, 1) == 0) {
+            wctx.writer = &writer;
+        } else {
+            log_message("Worker %d: Write offload disabled: cannot start writer thread", worker_id);
+        }
+    }
+    
+    // Cache misses load on disk threads and complete on the event loop, which
+    // must never block on a socket: only with the writer to finish slow sends
+    disk_io_pool_t disk;
+    if (config->disk_io_threads > 0 && wctx.writer) {
+        if (disk_io_init(&disk, config->disk_io_threads) == 0) {
+            wctx.disk = &disk;
+            event_loop_add_poller(&loop, disk_io_fd(&disk), disk_io_poll, NULL, &disk);
+        } else {
+            log_message("Worker %d: Disk I/O pool disabled: cannot start disk threads", worker_id);
+        }
+    }
+    
     // Initialize thread pool
     thread_pool_t pool;
     thread_pool_init(&pool, &conn_queue);
+    wctx.pool = &pool;
     
     // Create worker threads
     pthread_t* threads = malloc(sizeof(pthread_t) * config->threads_per_worker);
     if (!threads) {
         log_message("Worker %d: Failed to allocate thread array", worker_id);
+        if (wctx.disk) disk_io_destroy(wctx.disk);
+        if (wctx.writer) response_writer_destroy(wctx.writer);
+        event_loop_destroy(&loop);
         connection_queue_destroy(&conn_queue);
         if (cache_ptr) file_cache_destroy(cache_ptr);
         return;
@@ -306,6 +495,9 @@ void worker_process(int server_fd, int worker_id, const server_config_t* config)
         ctx->thread_id = i;
         ctx->config = config;
         ctx->cache = cache_ptr;
+        ctx->loop = &loop;
+        ctx->writer = wctx.writer;
+        ctx->disk = wctx.disk;
         
         if (pthread_create(&threads[i], NULL, thread_worker, ctx) != 0) {
             log_message("Worker %d: Failed to create thread %d", worker_id, i);
@@ -313,53 +505,64 @@ void worker_process(int server_fd, int worker_id, const server_config_t* config)
         }
     }
     
-    log_message("Worker %d: Thread pool initialized with bounded queue (size: %d)", 
-                worker_id, QUEUE_SIZE);
-
-    // Producer: Accept connections and enqueue them
-    unsigned long total_accepted = 0;
-    unsigned long total_rejected = 0;
-    unsigned long priority_handled = 0;
+    log_message("Worker %d: Thread pool initialized with %d-class bounded queue", 
+                worker_id, NUM_QUEUE_CLASSES);
     
-    while (keep_running) {
-        struct sockaddr_in client_addr;
-        socklen_t addr_len = sizeof(client_addr);
-        
-        int client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &addr_len);
-        
-        if (client_fd < 0) {
-            if (errno == EINTR) continue;
-            log_message("Worker %d: accept error: %s", worker_id, strerror(errno));
-            continue;
-        }
-
-        total_accepted++;
-        
-        // Check if this is a priority endpoint (metrics, health, stats)
-        // Priority endpoints bypass the queue and are handled immediately
-        if (is_priority_endpoint(client_fd)) {
-            priority_handled++;
-            handle_priority_endpoint(client_fd);
-            continue;
-        }
-        
-        // Try to enqueue connection (non-blocking)
-        if (connection_queue_try_enqueue(&conn_queue, client_fd) != 0) {
-            // Queue is full - reject with 503
-            total_rejected++;
-            send_503_response(client_fd);
-            
-            // Log every 100 rejections to avoid log spam
-            if (total_rejected % 100 == 1) {
-                log_message("Worker %d: Queue full, rejected %lu connections so far", 
-                           worker_id, total_rejected);
-            }
-        }
+    // Queue depth, busy threads and cache size for the per-worker metrics
+    if (event_loop_set_ticker(&loop, WORKER_STATS_INTERVAL_MS, publish_gauges) != 0) {
+        log_message("Worker %d: Per-worker gauges disabled: cannot create timer", worker_id);
     }
+    publish_gauges(&wctx);
+
+    // Producer: the event loop accepts connections, waits for their
+    // request headers and enqueues them
+    log_message("Worker %d: Event loop timeouts - header %ds, write %ds, keep-alive %ds",
+                worker_id, config->header_timeout_seconds, config->write_timeout_seconds,
+                config->keepalive_timeout_seconds);
+    event_loop_run(&loop, &keep_running);
 
     // Shutdown gracioso
-    log_message("Worker %d: Initiating graceful shutdown (accepted: %lu, priority: %lu, rejected: %lu)", 
-                worker_id, total_accepted, priority_handled, total_rejected);
+    unsigned long* class_accepted = wctx.class_accepted;
+    log_message("Worker %d: Initiating graceful shutdown (accepted: %lu [control: %lu, interactive: %lu, bulk: %lu], rejected: %lu)", 
+                worker_id, loop.accepted, class_accepted[QUEUE_CLASS_CONTROL],
+                class_accepted[QUEUE_CLASS_INTERACTIVE], class_accepted[QUEUE_CLASS_BULK],
+                wctx.total_rejected);
+    log_message("Worker %d: Timeouts - header read: %lu, keep-alive idle: %lu",
+                worker_id, loop.header_timeouts, loop.idle_timeouts);
+    if (router) {
+        log_message("Worker %d: Cache affinity handed off %lu, received %lu connections",
+                    worker_id, wctx.handed_off, wctx.received);
+    }
+    
+    // Graceful drain: stop accepting, fail /health, serve everything already
+    // queued or in flight, then exit; force exit at the deadline
+    set_draining();
+    wctx.draining = 1;
+    unsigned long completed_before = thread_pool_get_completed(&pool);
+    log_message("Worker %d: Draining (%d queued, %d in flight, deadline %ds)",
+                worker_id, connection_queue_size(&conn_queue),
+                thread_pool_get_busy_threads(&pool), config->drain_timeout_seconds);
+    
+    int drain_result = event_loop_drain(&loop, config->drain_timeout_seconds * 1000,
+                                        drain_done, &wctx);
+    long long drained = (long long)(thread_pool_get_completed(&pool) - completed_before);
+    
+    if (drain_result != 0) {
+        // Deadline passed: whatever is still waiting, queued or running is dropped
+        long long dropped = loop.live_count + connection_queue_size(&conn_queue) +
+                            thread_pool_get_busy_threads(&pool) +
+                            (wctx.disk ? disk_io_pending(wctx.disk) : 0) +
+                            (wctx.writer ? response_writer_pending(wctx.writer) : 0);
+        record_drain(drained, dropped);
+        log_message("Worker %d: Drain deadline reached - drained %lld requests, dropped %lld connections, forcing exit",
+                    worker_id, drained, dropped);
+        logger_flush();
+        _exit(EXIT_FAILURE);
+    }
+    
+    record_drain(drained, 0);
+    log_message("Worker %d: Drain complete - drained %lld requests (%lu taken from the accept queue), closed %lu idle keep-alive connections",
+                worker_id, drained, loop.drain_accepted, loop.drain_closed_idle);
     
     connection_queue_shutdown(&conn_queue);
     
@@ -368,9 +571,24 @@ void worker_process(int server_fd, int worker_id, const server_config_t* config)
         pthread_join(threads[i], NULL);
     }
     
+    log_wakeup_stats(worker_id, &conn_queue);
+    
+    // Disk completions may hand responses to the writer, so they go first
+    if (wctx.disk) {
+        disk_io_destroy(wctx.disk);
+    }
+    
+    // Writer last among the producers of keep-alive returns, before the loop goes
+    if (wctx.writer) {
+        response_writer_destroy(wctx.writer);
+        log_message("Worker %d: Write offload - %lu responses offloaded, %lu completed, %lu timed out, %lu failed",
+                    worker_id, writer.offloaded, writer.completed, writer.timeouts, writer.errors);
+    }
+    
     free(threads);
     thread_pool_destroy(&pool);
     connection_queue_destroy(&conn_queue);
+    event_loop_destroy(&loop);
     
     // Print cache statistics before destroying (if cache was enabled)
     if (cache_ptr) {
@@ -1,14 +1,17 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <stddef.h>
 #include "config.h"
+#include "affinity.h"
 
 // ============================================================================
 // Server Functions
 // ============================================================================
 int create_server_socket(int port);
-void worker_process(int server_fd, int worker_id, const server_config_t* config);
-int is_priority_endpoint(int client_fd);
-void handle_priority_endpoint(int client_fd);
+int listen_queue_info(int listen_fd, long long* queued, long long* limit, long long* listener_id);
+void worker_process(int server_fd, int worker_id, const server_config_t* config,
+                    affinity_router_t* router);
+int parse_request_path(const char* request, char* path, size_t path_size);
 
 #endif // SERVER_H
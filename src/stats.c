@@ -2,34 +2,444 @@
 
 #include "stats.h"
 #include "logger.h"
+#include "seqlock.h"
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 static server_stats_t* global_stats = NULL;
 
+// Named segment created by this process, unlinked on cleanup ("" = anonymous)
+static char stats_shm_name[256];
+
+// Shard owned by the calling thread (NULL = shared atomic counters)
+static __thread stats_shard_t* local_shard = NULL;
+
+// Worker this process runs as (-1 in the master); inherited by its shards
+static int process_worker = -1;
+
+// Shard fields have one writer; relaxed stores keep concurrent reads well-defined
+#define SHARD_ADD(field, value) \
+    __atomic_store_n(&(field), (field) + (value), __ATOMIC_RELAXED)
+#define SHARD_READ(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+// Shared fields have many writers across threads and processes
+#define STAT_ADD(field, value) __atomic_fetch_add(&(field), (value), __ATOMIC_RELAXED)
+#define STAT_READ(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+static void stat_max(long long* field, long long value) {
+    long long current = __atomic_load_n(field, __ATOMIC_RELAXED);
+    while (value > current &&
+           !__atomic_compare_exchange_n(field, &current, value, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // current was reloaded by the failed exchange
+    }
+}
+
+static int claimed_shards(void) {
+    int shards = __atomic_load_n(&global_stats->shards_claimed, __ATOMIC_RELAXED);
+    return shards < MAX_STATS_SHARDS ? shards : MAX_STATS_SHARDS;
+}
+
+// Copy a shard's counters as one consistent set (no other lock involved)
+static void read_shard_counters(stats_shard_t* shard, stats_counters_t* out) {
+    const long long* src = (const long long*)&shard->counters;
+    long long* dst = (long long*)out;
+    for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+        unsigned int seq = seqlock_read_begin(&shard->seq);
+        for (size_t i = 0; i < NUM_STATS_COUNTERS; i++) {
+            dst[i] = SHARD_READ(src[i]);
+        }
+        if (!seqlock_read_retry(&shard->seq, seq)) {
+            break;
+        }
+    }
+}
+
+// ============================================================================
+// Fold shards into the shared totals
+// ============================================================================
+static void collect_totals(stats_counters_t* totals) {
+    long long* sum = (long long*)totals;
+    const long long* shared = (const long long*)&global_stats->counters;
+    for (size_t i = 0; i < NUM_STATS_COUNTERS; i++) {
+        sum[i] = STAT_READ(shared[i]);
+    }
+
+    int shards = claimed_shards();
+    for (int i = 0; i < shards; i++) {
+        stats_counters_t shard;
+        read_shard_counters(&global_stats->shards[i], &shard);
+        const long long* value = (const long long*)&shard;
+        for (size_t j = 0; j < NUM_STATS_COUNTERS; j++) {
+            sum[j] += value[j];
+        }
+    }
+}
+
+// ============================================================================
+// Per-Worker Values
+// ============================================================================
+enum {
+    WORKER_REQUESTS,
+    WORKER_ACTIVE_CONNECTIONS,
+    WORKER_QUEUE_DEPTH,
+    WORKER_QUEUE_PEAK,
+    WORKER_REJECTED,
+    WORKER_CACHE_HITS,
+    WORKER_CACHE_MISSES,
+    WORKER_CACHE_ENTRIES,
+    WORKER_CACHE_BYTES,
+    WORKER_BUSY_THREADS,
+    WORKER_IDLE_THREADS,
+    WORKER_THREADS,
+    WORKER_LISTEN_BACKLOG,
+    WORKER_LISTEN_BACKLOG_LIMIT,
+    NUM_WORKER_VALUES
+};
+
+static const struct {
+    const char* metric;
+    const char* type;
+    const char* help;
+    const char* json;
+} worker_fields[NUM_WORKER_VALUES] = {
+    { "http_worker_requests_total", "counter", "Requests served by the worker", "requests" },
+    { "http_worker_connections_active", "gauge", "Connections open in the worker", "active_connections" },
+    { "http_worker_queue_depth", "gauge", "Connections waiting for a pool thread", "queue_depth" },
+    { "http_worker_queue_depth_peak", "gauge", "Highest queue depth over the last publication interval", "queue_peak" },
+    { "http_worker_rejected_total", "counter", "Connections rejected with 503 at admission", "rejected" },
+    { "http_worker_cache_hits_total", "counter", "File cache hits", "cache_hits" },
+    { "http_worker_cache_misses_total", "counter", "File cache misses", "cache_misses" },
+    { "http_worker_cache_entries", "gauge", "Files in the worker's cache", "cache_entries" },
+    { "http_worker_cache_bytes", "gauge", "Bytes in the worker's cache", "cache_bytes" },
+    { "http_worker_busy_threads", "gauge", "Pool threads (per-core: coroutines) on a request", "busy_threads" },
+    { "http_worker_idle_threads", "gauge", "Pool threads waiting for a connection", "idle_threads" },
+    { "http_worker_threads", "gauge", "Request threads in the worker", "threads" },
+    { "http_worker_listen_backlog", "gauge", "Connections waiting for accept() on the worker's listener (prefork: shared)", "listen_backlog" },
+    { "http_worker_listen_backlog_limit", "gauge", "Accept queue limit of the worker's listener", "listen_backlog_limit" },
+};
+
+typedef long long worker_values_t[NUM_WORKER_VALUES];
+
+/**
+ * Every worker's values: counters summed over the shards it owns, gauges
+ * from its last publication
+ * Returns: calloc'd array of MAX_STATS_WORKERS entries (NULL on failure)
+ */
+static worker_values_t* collect_workers(void) {
+    worker_values_t* values = calloc(MAX_STATS_WORKERS, sizeof(*values));
+    if (!values) {
+        return NULL;
+    }
+
+    int shards = claimed_shards();
+    for (int i = 0; i < shards; i++) {
+        stats_shard_t* shard = &global_stats->shards[i];
+        int worker = SHARD_READ(shard->worker);
+        if (worker < 0 || worker >= MAX_STATS_WORKERS) {
+            continue;
+        }
+        stats_counters_t counters;
+        read_shard_counters(shard, &counters);
+        values[worker][WORKER_REQUESTS] += counters.total_requests;
+        values[worker][WORKER_ACTIVE_CONNECTIONS] += counters.active_connections;
+        values[worker][WORKER_REJECTED] += counters.rejected;
+        values[worker][WORKER_CACHE_HITS] += counters.cache_hits;
+        values[worker][WORKER_CACHE_MISSES] += counters.cache_misses;
+    }
+
+    for (int worker = 0; worker < MAX_STATS_WORKERS; worker++) {
+        worker_stats_t* block = &global_stats->workers[worker];
+        for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+            unsigned int seq = seqlock_read_begin(&block->seq);
+            values[worker][WORKER_QUEUE_DEPTH] = STAT_READ(block->queue_depth);
+            values[worker][WORKER_QUEUE_PEAK] = STAT_READ(block->queue_peak);
+            values[worker][WORKER_CACHE_ENTRIES] = STAT_READ(block->cache_entries);
+            values[worker][WORKER_CACHE_BYTES] = STAT_READ(block->cache_bytes);
+            values[worker][WORKER_BUSY_THREADS] = STAT_READ(block->busy_threads);
+            values[worker][WORKER_THREADS] = STAT_READ(block->threads);
+            values[worker][WORKER_LISTEN_BACKLOG] = STAT_READ(block->listen_backlog);
+            values[worker][WORKER_LISTEN_BACKLOG_LIMIT] = STAT_READ(block->listen_backlog_limit);
+            if (!seqlock_read_retry(&block->seq, seq)) {
+                break;
+            }
+        }
+        long long idle = values[worker][WORKER_THREADS] - values[worker][WORKER_BUSY_THREADS];
+        values[worker][WORKER_IDLE_THREADS] = idle > 0 ? idle : 0;
+    }
+    return values;
+}
+
+static int worker_started(int worker) {
+    return __atomic_load_n(&global_stats->workers[worker].pid, __ATOMIC_RELAXED) != 0;
+}
+
+/**
+ * A worker's pool consumer wakeup histograms from its last publication
+ * (bucket b counts wakeups under 2^b us; the last one is open-ended)
+ */
+static void collect_wakeups(int worker, long long* spin, long long* park) {
+    worker_stats_t* block = &global_stats->workers[worker];
+    for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+        unsigned int seq = seqlock_read_begin(&block->seq);
+        for (int b = 0; b < WAKEUP_HIST_BUCKETS; b++) {
+            spin[b] = STAT_READ(block->wake_spin[b]);
+            park[b] = STAT_READ(block->wake_park[b]);
+        }
+        if (!seqlock_read_retry(&block->seq, seq)) {
+            break;
+        }
+    }
+}
+
+/**
+ * Accept queues summed over distinct listeners: prefork workers all report
+ * the one listener they share, per-core workers each have their own
+ */
+static void collect_listen_backlog(const worker_values_t* values, long long* queued, long long* limit) {
+    *queued = 0;
+    *limit = 0;
+    for (int worker = 0; worker < MAX_STATS_WORKERS; worker++) {
+        if (!worker_started(worker)) {
+            continue;
+        }
+        long long id = STAT_READ(global_stats->workers[worker].listener_id);
+        int seen = 0;
+        for (int other = 0; other < worker && !seen; other++) {
+            seen = worker_started(other) &&
+                   STAT_READ(global_stats->workers[other].listener_id) == id;
+        }
+        if (!seen) {
+            *queued += values[worker][WORKER_LISTEN_BACKLOG];
+            *limit += values[worker][WORKER_LISTEN_BACKLOG_LIMIT];
+        }
+    }
+}
+
+// Merge every shard's latency histogram (and the shared one)
+static void collect_latency(latency_hist_t* hist) {
+    memset(hist, 0, sizeof(*hist));
+    hist_merge(hist, &global_stats->latency);
+    int shards = claimed_shards();
+    for (int i = 0; i < shards; i++) {
+        hist_merge(hist, &global_stats->shards[i].latency);
+    }
+}
+
+#ifdef PHASE_TIMING
+static void collect_phase(int phase, latency_hist_t* hist) {
+    memset(hist, 0, sizeof(*hist));
+    hist_merge(hist, &global_stats->phases[phase]);
+    int shards = claimed_shards();
+    for (int i = 0; i < shards; i++) {
+        hist_merge(hist, &global_stats->shards[i].phases[phase]);
+    }
+}
+#endif
+
+#ifdef LOCK_STATS
+// Per-site lock counters across shards (and the shared set)
+static void collect_locks(lock_counters_t* locks) {
+    int shards = claimed_shards();
+    for (int site = 0; site < NUM_LOCK_SITES; site++) {
+        locks[site].acquisitions = STAT_READ(global_stats->locks[site].acquisitions);
+        locks[site].contended = STAT_READ(global_stats->locks[site].contended);
+        locks[site].wait_ns = STAT_READ(global_stats->locks[site].wait_ns);
+        for (int i = 0; i < shards; i++) {
+            const lock_counters_t* shard = &global_stats->shards[i].locks[site];
+            locks[site].acquisitions += SHARD_READ(shard->acquisitions);
+            locks[site].contended += SHARD_READ(shard->contended);
+            locks[site].wait_ns += SHARD_READ(shard->wait_ns);
+        }
+    }
+}
+#endif
+
+// Per-class request costs across shards (and the shared set), each shard's
+// classes copied as one consistent set
+#define NUM_PERF_FIELDS (NUM_PERF_CLASSES * sizeof(perf_class_counters_t) / sizeof(long long))
+
+static void collect_perf(perf_class_counters_t* perf) {
+    const long long* shared = (const long long*)global_stats->perf;
+    long long* sum = (long long*)perf;
+    for (size_t i = 0; i < NUM_PERF_FIELDS; i++) {
+        sum[i] = STAT_READ(shared[i]);
+    }
+    
+    for (int shard_id = 0; shard_id < claimed_shards(); shard_id++) {
+        stats_shard_t* shard = &global_stats->shards[shard_id];
+        const long long* src = (const long long*)shard->perf;
+        long long copy[NUM_PERF_FIELDS];
+        for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+            unsigned int seq = seqlock_read_begin(&shard->seq);
+            for (size_t i = 0; i < NUM_PERF_FIELDS; i++) {
+                copy[i] = SHARD_READ(src[i]);
+            }
+            if (!seqlock_read_retry(&shard->seq, seq)) {
+                break;
+            }
+        }
+        for (size_t i = 0; i < NUM_PERF_FIELDS; i++) {
+            sum[i] += copy[i];
+        }
+    }
+}
+
+// Per-type totals across shards
+static void collect_mime(long long* responses, long long* bytes) {
+    for (int type = 0; type < NUM_MIME_TYPES; type++) {
+        responses[type] = STAT_READ(global_stats->mime_responses[type]);
+        bytes[type] = STAT_READ(global_stats->mime_bytes[type]);
+    }
+    
+    int shards = claimed_shards();
+    for (int i = 0; i < shards; i++) {
+        stats_shard_t* shard = &global_stats->shards[i];
+        long long shard_responses[NUM_MIME_TYPES];
+        long long shard_bytes[NUM_MIME_TYPES];
+        for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+            unsigned int seq = seqlock_read_begin(&shard->seq);
+            for (int type = 0; type < NUM_MIME_TYPES; type++) {
+                shard_responses[type] = SHARD_READ(shard->mime_responses[type]);
+                shard_bytes[type] = SHARD_READ(shard->mime_bytes[type]);
+            }
+            if (!seqlock_read_retry(&shard->seq, seq)) {
+                break;
+            }
+        }
+        for (int type = 0; type < NUM_MIME_TYPES; type++) {
+            responses[type] += shard_responses[type];
+            bytes[type] += shard_bytes[type];
+        }
+    }
+}
+
+/**
+ * Merge one tracker across the shared summary and every claimed shard
+ * Returns: malloc'd entries, heaviest first (NULL on allocation failure)
+ */
+static topk_entry_t* collect_top(int tracker, int* count) {
+    int shards = claimed_shards();
+    
+    *count = 0;
+    topk_entry_t* entries = malloc(sizeof(topk_entry_t) * TOPK_SLOTS * (shards + 1));
+    if (!entries) {
+        return NULL;
+    }
+    int used = topk_snapshot(&global_stats->top[tracker], entries);
+    for (int i = 0; i < shards; i++) {
+        used += topk_snapshot(&global_stats->shards[i].top[tracker], entries + used);
+    }
+    *count = topk_combine(entries, used);
+    return entries;
+}
+
+// Copy a request path into a quoted label/JSON string: escape quotes and
+// backslashes, replace control bytes
+static void escape_path(const char* path, char* out, size_t size) {
+    size_t len = 0;
+    for (; *path && len + 2 < size; path++) {
+        unsigned char c = (unsigned char)*path;
+        if (c == '"' || c == '\\') {
+            out[len++] = '\\';
+            out[len++] = c;
+        } else {
+            out[len++] = c < 0x20 || c == 0x7f ? '?' : c;
+        }
+    }
+    out[len] = '\0';
+}
+
+// ============================================================================
+// Named Segment Ownership
+// ============================================================================
+/**
+ * Pid of the running server whose block lives in the named segment
+ * Returns: 0 if there is no such segment or its server is gone
+ */
+static int segment_owner(const char* shm_name) {
+    int fd = shm_open(shm_name, O_RDONLY, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    
+    int owner = 0;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(stats_header_t)) {
+        stats_header_t* header = mmap(NULL, sizeof(*header), PROT_READ, MAP_SHARED, fd, 0);
+        if (header != MAP_FAILED) {
+            int pid = header->master_pid;
+            if (header->magic == STATS_MAGIC && pid > 0 &&
+                (kill(pid, 0) == 0 || errno == EPERM)) {
+                owner = pid;
+            }
+            munmap(header, sizeof(*header));
+        }
+    }
+    close(fd);
+    return owner;
+}
+
 // ============================================================================
 // Initialize Statistics
 // ============================================================================
-int init_stats(void) {
+// With a name the block lives in a POSIX shared memory segment
+// (/dev/shm/<name>) that external tools can map; otherwise it is an
+// anonymous mapping only the server's processes share.
+int init_stats(const char* shm_name) {
+    int fd = -1;
+    if (shm_name && shm_name[0]) {
+        int owner = segment_owner(shm_name);
+        if (owner) {
+            fprintf(stderr, "Stats segment %s is in use by pid %d\n", shm_name, owner);
+            return -1;
+        }
+        // Replace a segment left behind by a server that was killed
+        shm_unlink(shm_name);
+        fd = shm_open(shm_name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            perror("shm_open failed for statistics");
+            return -1;
+        }
+        if (ftruncate(fd, sizeof(server_stats_t)) < 0) {
+            perror("ftruncate failed for statistics");
+            close(fd);
+            shm_unlink(shm_name);
+            return -1;
+        }
+        strncpy(stats_shm_name, shm_name, sizeof(stats_shm_name) - 1);
+    }
+    
     global_stats = mmap(NULL, sizeof(server_stats_t), 
                        PROT_READ | PROT_WRITE, 
-                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+                       fd >= 0 ? MAP_SHARED : MAP_SHARED | MAP_ANONYMOUS, fd, 0);
+    if (fd >= 0) {
+        close(fd);
+    }
     if (global_stats == MAP_FAILED) {
         perror("mmap failed for statistics");
+        global_stats = NULL;
+        cleanup_stats();
         return -1;
     }
-    global_stats->total_requests = 0;
-    global_stats->bytes_sent = 0;
-    global_stats->http_200_count = 0;
-    global_stats->http_404_count = 0;
-    global_stats->http_500_count = 0;
-    global_stats->active_connections = 0;
-    global_stats->total_response_time_ms = 0;
-    global_stats->response_count = 0;
-    global_stats->last_total_response_time_ms = 0;
-    global_stats->last_response_count = 0;
-    sem_init(&global_stats->semaphore, 1, 1);  // 1 = compartilhado entre processos
+    memset(&global_stats->counters, 0, sizeof(global_stats->counters));
+    global_stats->arena_high_water_bytes = 0;
+    global_stats->rate_sample_count = 0;
+    
+    global_stats->header.version = STATS_LAYOUT_VERSION;
+    global_stats->header.size = sizeof(server_stats_t);
+    global_stats->header.master_pid = getpid();
+    global_stats->header.start_time = time(NULL);
+    __atomic_store_n(&global_stats->header.magic, STATS_MAGIC, __ATOMIC_RELEASE);
     return 0;
 }
 
@@ -38,30 +448,36 @@ int init_stats(void) {
 // ============================================================================
 void cleanup_stats(void) {
     if (global_stats) {
-        sem_destroy(&global_stats->semaphore);
         munmap(global_stats, sizeof(server_stats_t));
         global_stats = NULL;
     }
+    if (stats_shm_name[0]) {
+        shm_unlink(stats_shm_name);
+        stats_shm_name[0] = '\0';
+    }
 }
 
 // ============================================================================
 // Update Statistics Function
 // ============================================================================
-void update_stats(int bytes) {
+void update_stats(long long bytes) {
     if (!global_stats) return;  // Verificar se está inicializado
     
-    sem_wait(&global_stats->semaphore);  // Proteger com semáforo
+    if (local_shard) {
+        seqlock_write_begin(&local_shard->seq);
+        SHARD_ADD(local_shard->counters.total_requests, 1);
+        SHARD_ADD(local_shard->counters.bytes_sent, bytes);
+        seqlock_write_end(&local_shard->seq);
+        return;
+    }
     
-    global_stats->total_requests++;
-    global_stats->bytes_sent += bytes;
+    long long requests = STAT_ADD(global_stats->counters.total_requests, 1) + 1;
+    long long bytes_sent = STAT_ADD(global_stats->counters.bytes_sent, bytes) + bytes;
     
     // Mostrar estatísticas a cada 15 pedidos
-    if (global_stats->total_requests % 15 == 0) {
-        log_message("STATS: Requests=%d, Bytes=%d", 
-                   global_stats->total_requests, global_stats->bytes_sent);
+    if (requests % 15 == 0) {
+        log_message("STATS: Requests=%lld, Bytes=%lld", requests, bytes_sent);
     }
-    
-    sem_post(&global_stats->semaphore);  // Liberar semáforo
 }
 
 // ============================================================================
@@ -69,54 +485,155 @@ void update_stats(int bytes) {
 // ============================================================================
 void print_global_stats(void) {
     if (global_stats) {
-        sem_wait(&global_stats->semaphore);
+        stats_counters_t totals;
+        collect_totals(&totals);
         log_message("=== GLOBAL STATISTICS ===");
-        log_message("Total requests: %d", global_stats->total_requests);
-        log_message("Total bytes sent: %d", global_stats->bytes_sent);
-        log_message("HTTP 200 responses: %d", global_stats->http_200_count);
-        log_message("HTTP 404 responses: %d", global_stats->http_404_count);
-        log_message("HTTP 5xx responses: %d", global_stats->http_500_count);
-        log_message("Active connections: %d", global_stats->active_connections);
-        if (global_stats->response_count > 0) {
-            long long avg_time = global_stats->total_response_time_ms / global_stats->response_count;
+        log_message("Total requests: %lld", totals.total_requests);
+        log_message("Total bytes sent: %lld", totals.bytes_sent);
+        log_message("HTTP 200 responses: %lld", totals.http_200_count);
+        log_message("HTTP 404 responses: %lld", totals.http_404_count);
+        log_message("HTTP 5xx responses: %lld", totals.http_500_count);
+        log_message("Active connections: %lld", totals.active_connections);
+        if (totals.response_count > 0) {
+            long long avg_time = totals.total_response_time_us / totals.response_count / 1000;
             log_message("Average response time: %lld ms", avg_time);
         } else {
             log_message("Average response time: N/A");
         }
         log_message("=========================");
-        sem_post(&global_stats->semaphore);
+    }
+}
+
+// ============================================================================
+// Per-Second Rate Ring
+// ============================================================================
+// Only the master writes: it fills the slot after the newest under the
+// slot's seqlock, then publishes it by bumping the count. Two spare slots
+// keep the slot being written away from any a reader wants; one that stalls
+// long enough to see its slot reused notices from the index.
+void record_rate_sample(void) {
+    if (!global_stats) return;
+    
+    stats_counters_t totals;
+    collect_totals(&totals);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    long long count = global_stats->rate_sample_count;
+    rate_sample_t* sample = &global_stats->rate_samples[count % RATE_SLOTS];
+    seqlock_write_begin(&sample->seq);
+    __atomic_store_n(&sample->index, count, __ATOMIC_RELAXED);
+    __atomic_store_n(&sample->time_ms, now.tv_sec * 1000LL + now.tv_nsec / 1000000, __ATOMIC_RELAXED);
+    __atomic_store_n(&sample->requests, totals.total_requests, __ATOMIC_RELAXED);
+    __atomic_store_n(&sample->bytes_sent, totals.bytes_sent, __ATOMIC_RELAXED);
+    __atomic_store_n(&sample->errors, totals.http_404_count + totals.http_500_count, __ATOMIC_RELAXED);
+    __atomic_store_n(&sample->response_count, totals.response_count, __ATOMIC_RELAXED);
+    __atomic_store_n(&sample->response_time_us, totals.total_response_time_us, __ATOMIC_RELAXED);
+    seqlock_write_end(&sample->seq);
+    __atomic_store_n(&global_stats->rate_sample_count, count + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copy sample number index
+ * Returns: 0 on success, -1 if its slot has been reused since
+ */
+static int read_rate_sample(long long index, rate_sample_t* out) {
+    rate_sample_t* sample = &global_stats->rate_samples[index % RATE_SLOTS];
+    for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+        unsigned int seq = seqlock_read_begin(&sample->seq);
+        out->index = __atomic_load_n(&sample->index, __ATOMIC_RELAXED);
+        out->time_ms = __atomic_load_n(&sample->time_ms, __ATOMIC_RELAXED);
+        out->requests = __atomic_load_n(&sample->requests, __ATOMIC_RELAXED);
+        out->bytes_sent = __atomic_load_n(&sample->bytes_sent, __ATOMIC_RELAXED);
+        out->errors = __atomic_load_n(&sample->errors, __ATOMIC_RELAXED);
+        out->response_count = __atomic_load_n(&sample->response_count, __ATOMIC_RELAXED);
+        out->response_time_us = __atomic_load_n(&sample->response_time_us, __ATOMIC_RELAXED);
+        if (!seqlock_read_retry(&sample->seq, seq)) {
+            break;
+        }
+    }
+    return out->index == index ? 0 : -1;
+}
+
+static const struct {
+    int seconds;
+    const char* label;
+} rate_windows[] = {
+    { 1, "1s" }, { 10, "10s" }, { 60, "60s" }, { RATE_WINDOW_SECONDS, "5m" }
+};
+#define NUM_RATE_WINDOWS (int)(sizeof(rate_windows) / sizeof(rate_windows[0]))
+
+/**
+ * Rates over the last `seconds` seconds of samples (or as many as exist)
+ */
+static void compute_rate_window(int seconds, rate_window_t* out) {
+    memset(out, 0, sizeof(*out));
+    long long count = __atomic_load_n(&global_stats->rate_sample_count, __ATOMIC_ACQUIRE);
+    if (count < 2) {
+        return;
+    }
+    
+    long long back = count - 1 < seconds ? count - 1 : seconds;
+    rate_sample_t newest, oldest;
+    if (read_rate_sample(count - 1, &newest) != 0 ||
+        read_rate_sample(count - 1 - back, &oldest) != 0) {
+        return;   // Stalled past a whole ring turn: report no data
+    }
+    
+    out->span_ms = newest.time_ms - oldest.time_ms;
+    if (out->span_ms <= 0) {
+        out->span_ms = 0;
+        return;
+    }
+    out->requests_per_sec = (newest.requests - oldest.requests) * 1000.0 / out->span_ms;
+    out->bytes_per_sec = (newest.bytes_sent - oldest.bytes_sent) * 1000.0 / out->span_ms;
+    out->errors_per_sec = (newest.errors - oldest.errors) * 1000.0 / out->span_ms;
+    long long responses = newest.response_count - oldest.response_count;
+    if (responses > 0) {
+        out->avg_response_time_us = (newest.response_time_us - oldest.response_time_us) / responses;
     }
 }
 
 // ============================================================================
 // Update Statistics with HTTP Code
 // ============================================================================
-void update_stats_with_code(int bytes, int http_code) {
+void update_stats_with_code(long long bytes, int http_code) {
     if (!global_stats) return;
     
-    sem_wait(&global_stats->semaphore);
+    if (local_shard) {
+        seqlock_write_begin(&local_shard->seq);
+        SHARD_ADD(local_shard->counters.total_requests, 1);
+        SHARD_ADD(local_shard->counters.bytes_sent, bytes);
+        if (http_code == 200) {
+            SHARD_ADD(local_shard->counters.http_200_count, 1);
+        } else if (http_code == 404) {
+            SHARD_ADD(local_shard->counters.http_404_count, 1);
+        } else if (http_code >= 500) {
+            SHARD_ADD(local_shard->counters.http_500_count, 1);
+        }
+        seqlock_write_end(&local_shard->seq);
+        return;
+    }
     
-    global_stats->total_requests++;
-    global_stats->bytes_sent += bytes;
+    long long requests = STAT_ADD(global_stats->counters.total_requests, 1) + 1;
+    STAT_ADD(global_stats->counters.bytes_sent, bytes);
     
     // Contagem de códigos HTTP
     if (http_code == 200) {
-        global_stats->http_200_count++;
+        STAT_ADD(global_stats->counters.http_200_count, 1);
     } else if (http_code == 404) {
-        global_stats->http_404_count++;
+        STAT_ADD(global_stats->counters.http_404_count, 1);
     } else if (http_code >= 500) {
-        global_stats->http_500_count++;
+        STAT_ADD(global_stats->counters.http_500_count, 1);
     }
     
     // Mostrar estatísticas a cada 15 pedidos
-    if (global_stats->total_requests % 15 == 0) {
-        log_message("STATS: Requests=%d, Bytes=%d, 200=%d, 404=%d, 5xx=%d, Active=%d", 
-                   global_stats->total_requests, global_stats->bytes_sent,
-                   global_stats->http_200_count, global_stats->http_404_count,
-                   global_stats->http_500_count, global_stats->active_connections);
+    if (requests % 15 == 0) {
+        log_message("STATS: Requests=%lld, Bytes=%lld, 200=%lld, 404=%lld, 5xx=%lld, Active=%lld", 
+                   requests, STAT_READ(global_stats->counters.bytes_sent),
+                   STAT_READ(global_stats->counters.http_200_count), STAT_READ(global_stats->counters.http_404_count),
+                   STAT_READ(global_stats->counters.http_500_count), STAT_READ(global_stats->counters.active_connections));
     }
-    
-    sem_post(&global_stats->semaphore);
 }
 
 // ============================================================================
@@ -125,9 +642,12 @@ void update_stats_with_code(int bytes, int http_code) {
 void increment_active_connections(void) {
     if (!global_stats) return;
     
-    sem_wait(&global_stats->semaphore);
-    global_stats->active_connections++;
-    sem_post(&global_stats->semaphore);
+    if (local_shard) {
+        SHARD_ADD(local_shard->counters.active_connections, 1);
+        return;
+    }
+    
+    STAT_ADD(global_stats->counters.active_connections, 1);
 }
 
 // ============================================================================
@@ -136,23 +656,515 @@ void increment_active_connections(void) {
 void decrement_active_connections(void) {
     if (!global_stats) return;
     
-    sem_wait(&global_stats->semaphore);
-    if (global_stats->active_connections > 0) {
-        global_stats->active_connections--;
+    if (local_shard) {
+        SHARD_ADD(local_shard->counters.active_connections, -1);
+        return;
     }
-    sem_post(&global_stats->semaphore);
+    
+    // Connections may be opened on one thread's shard and closed here,
+    // so only the sum over all shards is meaningful (no clamping at 0)
+    STAT_ADD(global_stats->counters.active_connections, -1);
 }
 
 // ============================================================================
 // Add Response Time
 // ============================================================================
-void add_response_time(long long time_ms) {
+void add_response_time(long long time_us) {
+    if (!global_stats) return;
+    
+    if (local_shard) {
+        seqlock_write_begin(&local_shard->seq);
+        SHARD_ADD(local_shard->counters.total_response_time_us, time_us);
+        SHARD_ADD(local_shard->counters.response_count, 1);
+        seqlock_write_end(&local_shard->seq);
+        hist_record_local(&local_shard->latency, time_us);
+        return;
+    }
+    
+    STAT_ADD(global_stats->counters.total_response_time_us, time_us);
+    STAT_ADD(global_stats->counters.response_count, 1);
+    hist_record_shared(&global_stats->latency, time_us);
+}
+
+// ============================================================================
+// Admission and Cache Counters
+// ============================================================================
+void record_rejected(void) {
+    if (!global_stats) return;
+    
+    if (local_shard) {
+        SHARD_ADD(local_shard->counters.rejected, 1);
+    } else {
+        STAT_ADD(global_stats->counters.rejected, 1);
+    }
+}
+
+void record_cache_lookup(int hit) {
+    if (!global_stats) return;
+    
+    if (local_shard) {
+        if (hit) {
+            SHARD_ADD(local_shard->counters.cache_hits, 1);
+        } else {
+            SHARD_ADD(local_shard->counters.cache_misses, 1);
+        }
+    } else if (hit) {
+        STAT_ADD(global_stats->counters.cache_hits, 1);
+    } else {
+        STAT_ADD(global_stats->counters.cache_misses, 1);
+    }
+}
+
+// ============================================================================
+// Per-Path and Per-Type Statistics
+// ============================================================================
+// A shard's trackers have one writer; the shared set is written by threads
+// without a shard, and a sample that finds another writer inside is skipped
+static void track_path(stats_shard_t* shard, int tracker, const char* path,
+                       long long weight, long long bytes) {
+    if (shard) {
+        topk_add(&shard->top[tracker], path, weight, bytes);
+    } else {
+        topk_try_add(&global_stats->top[tracker], path, weight, bytes);
+    }
+}
+
+void record_path_stats(const char* path, mime_type_t type, long long bytes, int http_code) {
+    if (!global_stats) return;
+    
+    stats_shard_t* shard = local_shard;
+    
+    track_path(shard, TOP_REQUESTS, path, 1, bytes);
+    if (http_code == 200) {
+        track_path(shard, TOP_BYTES, path, bytes, bytes);
+        if (shard) {
+            seqlock_write_begin(&shard->seq);
+            SHARD_ADD(shard->mime_responses[type], 1);
+            SHARD_ADD(shard->mime_bytes[type], bytes);
+            seqlock_write_end(&shard->seq);
+        } else {
+            STAT_ADD(global_stats->mime_responses[type], 1);
+            STAT_ADD(global_stats->mime_bytes[type], bytes);
+        }
+    } else if (http_code == 404) {
+        track_path(shard, TOP_NOT_FOUND, path, 1, bytes);
+    }
+}
+
+// ============================================================================
+// Slow-Request Flight Recorder
+// ============================================================================
+void set_slow_request_threshold(long long threshold_us) {
+    if (!global_stats) return;
+    __atomic_store_n(&global_stats->slow_threshold_us, threshold_us, __ATOMIC_RELAXED);
+}
+
+// Keeps requests slower than the threshold (0 = none) and every 5xx. Any
+// thread in any worker takes the next slot of the ring; the only cost on
+// the fast path is the threshold check.
+void record_request_trace(const request_trace_t* trace, const long long* phase_us) {
     if (!global_stats) return;
     
-    sem_wait(&global_stats->semaphore);
-    global_stats->total_response_time_ms += time_ms;
-    global_stats->response_count++;
-    sem_post(&global_stats->semaphore);
+    long long threshold = STAT_READ(global_stats->slow_threshold_us);
+    if (trace->status < 500 && (threshold <= 0 || trace->total_us < threshold)) {
+        return;
+    }
+    
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    long long ticket = STAT_ADD(global_stats->slow_next, 1);
+    slow_entry_t* entry = &global_stats->slow_log[ticket % SLOW_LOG_SLOTS];
+    if (!seqlock_try_write_begin(&entry->seq)) {
+        // A writer a whole ring turn behind still holds the slot
+        STAT_ADD(global_stats->slow_dropped, 1);
+        return;
+    }
+    __atomic_store_n(&entry->ticket, ticket, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->time_ms, now.tv_sec * 1000LL + now.tv_nsec / 1000000, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->worker, process_worker, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->thread, local_shard ? (int)(local_shard - global_stats->shards) : -1,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->status, trace->status, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->cache, trace->cache, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->bytes, trace->bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->total_us, trace->total_us, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->queue_wait_us, trace->queue_wait_us, __ATOMIC_RELAXED);
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        __atomic_store_n(&entry->phase_us[phase], phase_us[phase], __ATOMIC_RELAXED);
+    }
+    memcpy(entry->path, trace->path, sizeof(entry->path));
+    entry->path[SLOW_PATH_LEN - 1] = '\0';
+    seqlock_write_end(&entry->seq);
+}
+
+/**
+ * Copy record number ticket
+ * Returns: 0 on success, -1 if its slot holds another record (reused, not
+ * written yet, or held by a writer)
+ */
+static int read_slow_entry(long long ticket, slow_entry_t* out) {
+    slow_entry_t* entry = &global_stats->slow_log[ticket % SLOW_LOG_SLOTS];
+    for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+        unsigned int seq = seqlock_read_begin(&entry->seq);
+        memcpy(out, entry, sizeof(*out));
+        if (!seqlock_read_retry(&entry->seq, seq)) {
+            return seq != 0 && out->ticket == ticket ? 0 : -1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Copy up to max recorded requests, newest first
+ * Returns: number of entries copied
+ */
+int stats_read_slow(slow_entry_t* out, int max) {
+    if (!global_stats) return 0;
+    
+    long long next = STAT_READ(global_stats->slow_next);
+    int count = 0;
+    for (long long ticket = next - 1;
+         ticket >= 0 && ticket >= next - SLOW_LOG_SLOTS && count < max; ticket--) {
+        if (read_slow_entry(ticket, &out[count]) == 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+const char* trace_cache_name(int cache) {
+    switch (cache) {
+        case TRACE_CACHE_HIT: return "hit";
+        case TRACE_CACHE_MISS: return "miss";
+        default: return "none";
+    }
+}
+
+// ============================================================================
+// Request Phase Timing
+// ============================================================================
+const char* phase_name(int phase) {
+    static const char* names[NUM_PHASES] = {
+        "recv", "parse", "path", "cache", "file", "header", "send"
+    };
+    return phase >= 0 && phase < NUM_PHASES ? names[phase] : "unknown";
+}
+
+#ifdef PHASE_TIMING
+void record_phase_time(int phase, long long time_us) {
+    if (!global_stats) return;
+    
+    if (local_shard) {
+        hist_record_local(&local_shard->phases[phase], time_us);
+    } else {
+        hist_record_shared(&global_stats->phases[phase], time_us);
+    }
+}
+#endif
+
+// ============================================================================
+// Lock Contention
+// ============================================================================
+const char* lock_site_name(int site) {
+    static const char* names[NUM_LOCK_SITES] = {
+        "queue_mutex", "queue_filled", "queue_empty", "cache_read", "cache_write"
+    };
+    return site >= 0 && site < NUM_LOCK_SITES ? names[site] : "unknown";
+}
+
+#ifdef LOCK_STATS
+void record_lock_acquire(int site, int contended, long long wait_ns) {
+    if (!global_stats) return;
+    
+    if (local_shard) {
+        lock_counters_t* lock = &local_shard->locks[site];
+        SHARD_ADD(lock->acquisitions, 1);
+        if (contended) {
+            SHARD_ADD(lock->contended, 1);
+            SHARD_ADD(lock->wait_ns, wait_ns);
+        }
+    } else {
+        lock_counters_t* lock = &global_stats->locks[site];
+        STAT_ADD(lock->acquisitions, 1);
+        if (contended) {
+            STAT_ADD(lock->contended, 1);
+            STAT_ADD(lock->wait_ns, wait_ns);
+        }
+    }
+}
+#endif
+
+// ============================================================================
+// Hardware Counters per Request Class
+// ============================================================================
+const char* perf_counter_name(int counter) {
+    static const char* names[NUM_PERF_COUNTERS] = {
+        "cycles", "instructions", "cache_misses", "context_switches"
+    };
+    return counter >= 0 && counter < NUM_PERF_COUNTERS ? names[counter] : "unknown";
+}
+
+const char* perf_class_name(int perf_class) {
+    static const char* names[NUM_PERF_CLASSES] = {
+        "cache_hit", "cache_miss", "large_file", "monitoring", "other"
+    };
+    return perf_class >= 0 && perf_class < NUM_PERF_CLASSES ? names[perf_class] : "unknown";
+}
+
+void set_perf_counters_enabled(int enabled) {
+    if (!global_stats) return;
+    __atomic_store_n(&global_stats->perf_enabled, enabled, __ATOMIC_RELAXED);
+}
+
+void record_perf_thread(const int* event_modes) {
+    if (!global_stats) return;
+    
+    for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+        __atomic_store_n(&global_stats->perf_event_mode[counter], event_modes[counter],
+                         __ATOMIC_RELAXED);
+    }
+    STAT_ADD(global_stats->perf_threads, 1);
+}
+
+void record_perf_request(int perf_class, const long long* counts) {
+    if (!global_stats || perf_class < 0 || perf_class >= NUM_PERF_CLASSES) return;
+    
+    if (local_shard) {
+        perf_class_counters_t* perf = &local_shard->perf[perf_class];
+        seqlock_write_begin(&local_shard->seq);
+        SHARD_ADD(perf->requests, 1);
+        for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+            SHARD_ADD(perf->counts[counter], counts[counter]);
+        }
+        seqlock_write_end(&local_shard->seq);
+    } else {
+        perf_class_counters_t* perf = &global_stats->perf[perf_class];
+        STAT_ADD(perf->requests, 1);
+        for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+            STAT_ADD(perf->counts[counter], counts[counter]);
+        }
+    }
+}
+
+void record_perf_unattributed(void) {
+    if (!global_stats) return;
+    STAT_ADD(global_stats->perf_unattributed, 1);
+}
+
+// ============================================================================
+// Update Arena High-Water Mark
+// ============================================================================
+void update_arena_high_water(long long bytes) {
+    if (!global_stats) return;
+    stat_max(&global_stats->arena_high_water_bytes, bytes);
+}
+
+// ============================================================================
+// Disk I/O Pool Metrics
+// ============================================================================
+void update_disk_queue_depth(int delta) {
+    if (!global_stats) return;
+    
+    long long depth = STAT_ADD(global_stats->disk_queue_depth, delta) + delta;
+    stat_max(&global_stats->disk_queue_depth_max, depth);
+}
+
+void record_disk_read(long long read_us, long long wait_us, long long bytes) {
+    if (!global_stats) return;
+    
+    STAT_ADD(global_stats->disk_reads, 1);
+    STAT_ADD(global_stats->disk_read_bytes, bytes);
+    STAT_ADD(global_stats->disk_read_time_us, read_us);
+    STAT_ADD(global_stats->disk_wait_time_us, wait_us);
+    stat_max(&global_stats->disk_read_max_us, read_us);
+}
+
+// ============================================================================
+// Give the Calling Thread its Own Stats Shard
+// ============================================================================
+// Shards are claimed once and never handed back: a thread's counts stay in
+// the totals after it exits.
+void stats_bind_thread(void) {
+    if (!global_stats) return;
+    
+    int shard = __atomic_fetch_add(&global_stats->shards_claimed, 1, __ATOMIC_RELAXED);
+    if (shard >= MAX_STATS_SHARDS) {
+        local_shard = NULL;   // Out of shards: fall back to the shared counters
+        return;
+    }
+    local_shard = &global_stats->shards[shard];
+    __atomic_store_n(&local_shard->worker, process_worker, __ATOMIC_RELAXED);
+}
+
+// ============================================================================
+// Per-Worker Stats Block
+// ============================================================================
+// Call before the worker binds any thread, so its shards carry its id
+void stats_set_worker(int worker_id) {
+    process_worker = worker_id;
+}
+
+void publish_worker_stats(const worker_stats_t* gauges) {
+    if (!global_stats || process_worker < 0 || process_worker >= MAX_STATS_WORKERS) return;
+    
+    worker_stats_t* block = &global_stats->workers[process_worker];
+    seqlock_write_begin(&block->seq);
+    __atomic_store_n(&block->queue_depth, gauges->queue_depth, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->queue_peak, gauges->queue_peak, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->busy_threads, gauges->busy_threads, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->threads, gauges->threads, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->cache_entries, gauges->cache_entries, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->cache_bytes, gauges->cache_bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->listen_backlog, gauges->listen_backlog, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->listen_backlog_limit, gauges->listen_backlog_limit, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->listener_id, gauges->listener_id, __ATOMIC_RELAXED);
+    for (int b = 0; b < WAKEUP_HIST_BUCKETS; b++) {
+        __atomic_store_n(&block->wake_spin[b], gauges->wake_spin[b], __ATOMIC_RELAXED);
+        __atomic_store_n(&block->wake_park[b], gauges->wake_park[b], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&block->pid, (int)getpid(), __ATOMIC_RELAXED);
+    seqlock_write_end(&block->seq);
+}
+
+// ============================================================================
+// Graceful Drain
+// ============================================================================
+void set_draining(void) {
+    if (!global_stats) return;
+    __atomic_store_n(&global_stats->draining, 1, __ATOMIC_RELAXED);
+}
+
+int is_draining(void) {
+    return global_stats ? __atomic_load_n(&global_stats->draining, __ATOMIC_RELAXED) : 0;
+}
+
+void record_drain(long long drained, long long dropped) {
+    if (!global_stats) return;
+    
+    STAT_ADD(global_stats->drained_requests, drained);
+    STAT_ADD(global_stats->dropped_connections, dropped);
+}
+
+// ============================================================================
+// Logger
+// ============================================================================
+void record_log_written(long long lines, long long bytes) {
+    if (!global_stats) return;
+    
+    STAT_ADD(global_stats->log_lines, lines);
+    STAT_ADD(global_stats->log_bytes, bytes);
+}
+
+void record_log_dropped(long long lines) {
+    if (!global_stats) return;
+    
+    STAT_ADD(global_stats->log_dropped, lines);
+}
+
+// ============================================================================
+// Read-Only Access from Another Process
+// ============================================================================
+int stats_attach(const char* shm_name) {
+    int fd = shm_open(shm_name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open stats segment %s: %s\n", shm_name, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(stats_header_t)) {
+        fprintf(stderr, "%s is not a stats segment\n", shm_name);
+        close(fd);
+        return -1;
+    }
+    server_stats_t* stats = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (stats == MAP_FAILED) {
+        fprintf(stderr, "Cannot map stats segment %s: %s\n", shm_name, strerror(errno));
+        return -1;
+    }
+    
+    const char* problem = NULL;
+    if (__atomic_load_n(&stats->header.magic, __ATOMIC_ACQUIRE) != STATS_MAGIC) {
+        problem = "not a stats segment (or the server is still starting)";
+    } else if (stats->header.version != STATS_LAYOUT_VERSION) {
+        problem = "written with a different layout version";
+    } else if (stats->header.size != (long long)sizeof(server_stats_t) ||
+               st.st_size != (off_t)sizeof(server_stats_t)) {
+        problem = "layout size differs (server built with other options?)";
+    }
+    if (problem) {
+        fprintf(stderr, "%s: %s\n", shm_name, problem);
+        munmap(stats, st.st_size);
+        return -1;
+    }
+    global_stats = stats;
+    return 0;
+}
+
+void stats_detach(void) {
+    cleanup_stats();
+}
+
+void stats_read_totals(stats_counters_t* totals) {
+    if (!global_stats) {
+        memset(totals, 0, sizeof(*totals));
+        return;
+    }
+    collect_totals(totals);
+}
+
+void stats_read_latency(latency_hist_t* hist) {
+    if (!global_stats) {
+        memset(hist, 0, sizeof(*hist));
+        return;
+    }
+    collect_latency(hist);
+}
+
+void stats_read_rate(int seconds, rate_window_t* out) {
+    if (!global_stats) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    compute_rate_window(seconds, out);
+}
+
+/**
+ * Fill out with up to max started workers, lowest id first
+ * Returns: number of entries filled
+ */
+int stats_read_workers(worker_view_t* out, int max) {
+    if (!global_stats) return 0;
+    
+    worker_values_t* values = collect_workers();
+    if (!values) {
+        return 0;
+    }
+    int count = 0;
+    for (int worker = 0; worker < MAX_STATS_WORKERS && count < max; worker++) {
+        if (!worker_started(worker)) {
+            continue;
+        }
+        worker_view_t* view = &out[count++];
+        view->worker = worker;
+        view->pid = __atomic_load_n(&global_stats->workers[worker].pid, __ATOMIC_RELAXED);
+        view->requests = values[worker][WORKER_REQUESTS];
+        view->active_connections = values[worker][WORKER_ACTIVE_CONNECTIONS];
+        view->queue_depth = values[worker][WORKER_QUEUE_DEPTH];
+        view->queue_peak = values[worker][WORKER_QUEUE_PEAK];
+        view->rejected = values[worker][WORKER_REJECTED];
+        view->cache_hits = values[worker][WORKER_CACHE_HITS];
+        view->cache_misses = values[worker][WORKER_CACHE_MISSES];
+        view->cache_entries = values[worker][WORKER_CACHE_ENTRIES];
+        view->cache_bytes = values[worker][WORKER_CACHE_BYTES];
+        view->busy_threads = values[worker][WORKER_BUSY_THREADS];
+        view->idle_threads = values[worker][WORKER_IDLE_THREADS];
+        view->threads = values[worker][WORKER_THREADS];
+        view->listen_backlog = values[worker][WORKER_LISTEN_BACKLOG];
+        view->listen_backlog_limit = values[worker][WORKER_LISTEN_BACKLOG_LIMIT];
+    }
+    free(values);
+    return count;
 }
 
 // ============================================================================
@@ -162,130 +1174,747 @@ server_stats_t* get_stats(void) {
     return global_stats;
 }
 
+// ============================================================================
+// Growable Response Buffer
+// ============================================================================
+// /metrics and /stats grow with the number of workers and threads (one
+// worker per CPU in per-core mode), and /stats/top and /debug/slow with
+// path lengths, so they are built in a per-thread buffer that is enlarged
+// as needed instead of a fixed array that would cut the document short.
+typedef struct {
+    char* data;
+    size_t len;
+    size_t size;
+    int failed;                     // Out of memory: the document is incomplete
+} response_buf_t;
+
+#define RESPONSE_BUF_INITIAL 16384
+#define METRICS_FALLBACK "# Statistics could not be formatted (out of memory)\n"
+#define STATS_JSON_FALLBACK "{\"error\":\"Statistics could not be formatted\"}"
+
+static void buf_reset(response_buf_t* out) {
+    out->len = 0;
+    out->failed = 0;
+}
+
+static void buf_printf(response_buf_t* out, const char* format, ...) {
+    while (!out->failed) {
+        size_t room = out->size - out->len;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(out->data ? out->data + out->len : NULL, room, format, args);
+        va_end(args);
+        if (n < 0) {
+            out->failed = 1;
+        } else if ((size_t)n < room) {
+            out->len += n;
+            return;
+        } else {
+            size_t size = out->size ? out->size : RESPONSE_BUF_INITIAL;
+            while (size - out->len <= (size_t)n) {
+                size *= 2;
+            }
+            char* data = realloc(out->data, size);
+            if (!data) {
+                out->failed = 1;
+            } else {
+                out->data = data;
+                out->size = size;
+            }
+        }
+    }
+}
+
+/**
+ * The finished document, or fallback if it could not be built whole
+ */
+static char* buf_finish(response_buf_t* out, size_t* response_len, const char* fallback) {
+    if (out->failed) {
+        *response_len = strlen(fallback);
+        return (char*)fallback;
+    }
+    *response_len = out->len;
+    return out->data;
+}
+
 // ============================================================================
 // Generate Health Endpoint Response
 // ============================================================================
 char* generate_health_response(size_t* response_len) {
-    static char response[256];
+    static __thread char response[256];
+    long long active = 0;
+    if (global_stats) {
+        stats_counters_t totals;
+        collect_totals(&totals);
+        active = totals.active_connections;
+    }
     *response_len = snprintf(response, sizeof(response),
-        "{\"status\":\"healthy\",\"service\":\"http-server\",\"active_connections\":%d}",
-        global_stats ? global_stats->active_connections : 0);
+        "{\"status\":\"%s\",\"service\":\"http-server\",\"active_connections\":%lld}",
+        is_draining() ? "draining" : "healthy", active);
     return response;
 }
 
 // ============================================================================
 // Generate Prometheus Metrics Response
 // ============================================================================
+// Exported latency bucket bounds (us); each is approximated by the
+// log-linear buckets whose upper bound falls at or below it
+static const long long latency_bucket_us[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+static const char* top_metric_names[NUM_TOP_TRACKERS] = {
+    "http_top_path_requests", "http_top_path_bytes", "http_top_path_not_found"
+};
+
+static const char* top_metric_help[NUM_TOP_TRACKERS] = {
+    "Estimated requests for the most requested paths",
+    "Estimated bytes sent for the paths sending the most",
+    "Estimated 404 responses for the most requested missing paths"
+};
+
+static const char* top_json_names[NUM_TOP_TRACKERS] = {
+    "requests", "bytes", "not_found"
+};
+
 char* generate_metrics_response(size_t* response_len) {
-    static char response[4096];
+    static __thread response_buf_t out;
+    buf_reset(&out);
     
     if (!global_stats) {
-        *response_len = snprintf(response, sizeof(response), "# No stats available\n");
-        return response;
+        buf_printf(&out, "# No stats available\n");
+        return buf_finish(&out, response_len, METRICS_FALLBACK);
     }
     
-    sem_wait(&global_stats->semaphore);
+    stats_counters_t totals;
+    collect_totals(&totals);
     
     // Calculate overall average response time
     long long avg_response_time = 0;
-    if (global_stats->response_count > 0) {
-        avg_response_time = global_stats->total_response_time_ms / global_stats->response_count;
+    if (totals.response_count > 0) {
+        avg_response_time = totals.total_response_time_us / totals.response_count / 1000;
     }
     
-    // Calculate response time since last metrics call
-    long long avg_response_time_since_last = 0;
-    int requests_since_last = global_stats->response_count - global_stats->last_response_count;
-    if (requests_since_last > 0) {
-        long long time_since_last = global_stats->total_response_time_ms - global_stats->last_total_response_time_ms;
-        avg_response_time_since_last = time_since_last / requests_since_last;
-    }
-    
-    *response_len = snprintf(response, sizeof(response),
+    buf_printf(&out,
         "# HELP http_requests_total Total number of HTTP requests\n"
         "# TYPE http_requests_total counter\n"
-        "http_requests_total %d\n"
+        "http_requests_total %lld\n"
         "\n"
         "# HELP http_requests_bytes_sent_total Total bytes sent in HTTP responses\n"
         "# TYPE http_requests_bytes_sent_total counter\n"
-        "http_requests_bytes_sent_total %d\n"
+        "http_requests_bytes_sent_total %lld\n"
         "\n"
         "# HELP http_responses_total Total HTTP responses by status code\n"
         "# TYPE http_responses_total counter\n"
-        "http_responses_total{code=\"200\"} %d\n"
-        "http_responses_total{code=\"404\"} %d\n"
-        "http_responses_total{code=\"5xx\"} %d\n"
+        "http_responses_total{code=\"200\"} %lld\n"
+        "http_responses_total{code=\"404\"} %lld\n"
+        "http_responses_total{code=\"5xx\"} %lld\n"
         "\n"
         "# HELP http_connections_active Current number of active connections\n"
         "# TYPE http_connections_active gauge\n"
-        "http_connections_active %d\n"
+        "http_connections_active %lld\n"
         "\n"
         "# HELP http_response_time_milliseconds_avg Average response time in milliseconds (all time)\n"
         "# TYPE http_response_time_milliseconds_avg gauge\n"
         "http_response_time_milliseconds_avg %lld\n"
         "\n"
-        "# HELP http_response_time_milliseconds_since_last Average response time since last /metrics call\n"
-        "# TYPE http_response_time_milliseconds_since_last gauge\n"
-        "http_response_time_milliseconds_since_last %lld\n",
-        global_stats->total_requests,
-        global_stats->bytes_sent,
-        global_stats->http_200_count,
-        global_stats->http_404_count,
-        global_stats->http_500_count,
-        global_stats->active_connections,
+        "# HELP http_request_arena_high_water_bytes Largest per-request arena usage\n"
+        "# TYPE http_request_arena_high_water_bytes gauge\n"
+        "http_request_arena_high_water_bytes %lld\n"
+        "\n"
+        "\n"
+        "# HELP http_disk_queue_depth Cache-miss loads waiting for a disk thread\n"
+        "# TYPE http_disk_queue_depth gauge\n"
+        "http_disk_queue_depth %lld\n"
+        "\n"
+        "# HELP http_disk_queue_depth_max Highest disk queue depth seen\n"
+        "# TYPE http_disk_queue_depth_max gauge\n"
+        "http_disk_queue_depth_max %lld\n"
+        "\n"
+        "# HELP http_disk_reads_total Cache-miss loads completed by the disk pool\n"
+        "# TYPE http_disk_reads_total counter\n"
+        "http_disk_reads_total %lld\n"
+        "\n"
+        "# HELP http_disk_read_bytes_total Bytes read into memory by the disk pool\n"
+        "# TYPE http_disk_read_bytes_total counter\n"
+        "http_disk_read_bytes_total %lld\n"
+        "\n"
+        "# HELP http_disk_read_microseconds Time spent in open/stat/read per load\n"
+        "# TYPE http_disk_read_microseconds summary\n"
+        "http_disk_read_microseconds_sum %lld\n"
+        "http_disk_read_microseconds_count %lld\n"
+        "\n"
+        "# HELP http_disk_wait_microseconds Submit-to-loaded time per load (includes queueing)\n"
+        "# TYPE http_disk_wait_microseconds summary\n"
+        "http_disk_wait_microseconds_sum %lld\n"
+        "http_disk_wait_microseconds_count %lld\n"
+        "\n"
+        "# HELP http_server_draining Whether the server is draining for shutdown\n"
+        "# TYPE http_server_draining gauge\n"
+        "http_server_draining %d\n",
+        totals.total_requests,
+        totals.bytes_sent,
+        totals.http_200_count,
+        totals.http_404_count,
+        totals.http_500_count,
+        totals.active_connections,
         avg_response_time,
-        avg_response_time_since_last);
+        STAT_READ(global_stats->arena_high_water_bytes),
+        STAT_READ(global_stats->disk_queue_depth),
+        STAT_READ(global_stats->disk_queue_depth_max),
+        STAT_READ(global_stats->disk_reads),
+        STAT_READ(global_stats->disk_read_bytes),
+        STAT_READ(global_stats->disk_read_time_us),
+        STAT_READ(global_stats->disk_reads),
+        STAT_READ(global_stats->disk_wait_time_us),
+        STAT_READ(global_stats->disk_reads),
+        is_draining());
     
-    // Update last snapshot for next call
-    global_stats->last_total_response_time_ms = global_stats->total_response_time_ms;
-    global_stats->last_response_count = global_stats->response_count;
+    buf_printf(&out,
+        "\n"
+        "# HELP http_log_lines_total Log lines written by the log writer threads\n"
+        "# TYPE http_log_lines_total counter\n"
+        "http_log_lines_total %lld\n"
+        "\n"
+        "# HELP http_log_bytes_total Bytes written to the log\n"
+        "# TYPE http_log_bytes_total counter\n"
+        "http_log_bytes_total %lld\n"
+        "\n"
+        "# HELP http_log_dropped_total Log lines dropped because the log buffer was full\n"
+        "# TYPE http_log_dropped_total counter\n"
+        "http_log_dropped_total %lld\n",
+        STAT_READ(global_stats->log_lines),
+        STAT_READ(global_stats->log_bytes),
+        STAT_READ(global_stats->log_dropped));
     
-    sem_post(&global_stats->semaphore);
-    return response;
+    // Recent rates from the master's per-second ring
+    rate_window_t rates[NUM_RATE_WINDOWS];
+    for (int w = 0; w < NUM_RATE_WINDOWS; w++) {
+        compute_rate_window(rate_windows[w].seconds, &rates[w]);
+    }
+    buf_printf(&out,
+        "\n"
+        "# HELP http_window_requests_per_second Request rate over a recent window\n"
+        "# TYPE http_window_requests_per_second gauge\n");
+    for (int w = 0; w < NUM_RATE_WINDOWS; w++) {
+        buf_printf(&out,
+            "http_window_requests_per_second{window=\"%s\"} %.3f\n",
+            rate_windows[w].label, rates[w].requests_per_sec);
+    }
+    buf_printf(&out,
+        "\n"
+        "# HELP http_window_bytes_per_second Bytes sent per second over a recent window\n"
+        "# TYPE http_window_bytes_per_second gauge\n");
+    for (int w = 0; w < NUM_RATE_WINDOWS; w++) {
+        buf_printf(&out,
+            "http_window_bytes_per_second{window=\"%s\"} %.1f\n",
+            rate_windows[w].label, rates[w].bytes_per_sec);
+    }
+    buf_printf(&out,
+        "\n"
+        "# HELP http_window_errors_per_second 404 and 5xx responses per second over a recent window\n"
+        "# TYPE http_window_errors_per_second gauge\n");
+    for (int w = 0; w < NUM_RATE_WINDOWS; w++) {
+        buf_printf(&out,
+            "http_window_errors_per_second{window=\"%s\"} %.3f\n",
+            rate_windows[w].label, rates[w].errors_per_sec);
+    }
+    buf_printf(&out,
+        "\n"
+        "# HELP http_window_response_time_microseconds_avg Average response time over a recent window\n"
+        "# TYPE http_window_response_time_microseconds_avg gauge\n");
+    for (int w = 0; w < NUM_RATE_WINDOWS; w++) {
+        buf_printf(&out,
+            "http_window_response_time_microseconds_avg{window=\"%s\"} %lld\n",
+            rate_windows[w].label, rates[w].avg_response_time_us);
+    }
+    
+    // Latency histogram: Prometheus buckets folded from the log-linear ones
+    latency_hist_t latency;
+    collect_latency(&latency);
+    buf_printf(&out,
+        "\n"
+        "# HELP http_request_duration_seconds Request latency\n"
+        "# TYPE http_request_duration_seconds histogram\n");
+    for (size_t i = 0; i < sizeof(latency_bucket_us) / sizeof(latency_bucket_us[0]); i++) {
+        buf_printf(&out,
+            "http_request_duration_seconds_bucket{le=\"%g\"} %lld\n",
+            latency_bucket_us[i] / 1e6, hist_count_at_or_below(&latency, latency_bucket_us[i]));
+    }
+    buf_printf(&out,
+        "http_request_duration_seconds_bucket{le=\"+Inf\"} %lld\n"
+        "http_request_duration_seconds_sum %.6f\n"
+        "http_request_duration_seconds_count %lld\n",
+        latency.total, latency.sum_us / 1e6, latency.total);
+    
+#ifdef PHASE_TIMING
+    buf_printf(&out,
+        "\n"
+        "# HELP http_request_phase_microseconds Time per request phase\n"
+        "# TYPE http_request_phase_microseconds summary\n");
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        latency_hist_t hist;
+        collect_phase(phase, &hist);
+        const char* name = phase_name(phase);
+        buf_printf(&out,
+            "http_request_phase_microseconds{phase=\"%s\",quantile=\"0.5\"} %lld\n"
+            "http_request_phase_microseconds{phase=\"%s\",quantile=\"0.99\"} %lld\n"
+            "http_request_phase_microseconds_sum{phase=\"%s\"} %lld\n"
+            "http_request_phase_microseconds_count{phase=\"%s\"} %lld\n",
+            name, hist_percentile(&hist, 0.50), name, hist_percentile(&hist, 0.99),
+            name, hist.sum_us, name, hist.total);
+    }
+#endif
+    
+#ifdef LOCK_STATS
+    lock_counters_t locks[NUM_LOCK_SITES];
+    collect_locks(locks);
+    buf_printf(&out,
+        "\n"
+        "# HELP http_lock_acquisitions_total Lock acquisitions by site\n"
+        "# TYPE http_lock_acquisitions_total counter\n");
+    for (int site = 0; site < NUM_LOCK_SITES; site++) {
+        buf_printf(&out,
+            "http_lock_acquisitions_total{lock=\"%s\"} %lld\n",
+            lock_site_name(site), locks[site].acquisitions);
+    }
+    buf_printf(&out,
+        "\n"
+        "# HELP http_lock_contended_total Acquisitions that found the lock held and blocked\n"
+        "# TYPE http_lock_contended_total counter\n");
+    for (int site = 0; site < NUM_LOCK_SITES; site++) {
+        buf_printf(&out,
+            "http_lock_contended_total{lock=\"%s\"} %lld\n",
+            lock_site_name(site), locks[site].contended);
+    }
+    buf_printf(&out,
+        "\n"
+        "# HELP http_lock_wait_seconds_total Time spent blocked waiting for the lock\n"
+        "# TYPE http_lock_wait_seconds_total counter\n");
+    for (int site = 0; site < NUM_LOCK_SITES; site++) {
+        buf_printf(&out,
+            "http_lock_wait_seconds_total{lock=\"%s\"} %.6f\n",
+            lock_site_name(site), locks[site].wait_ns / 1e9);
+    }
+#endif
+    
+    // Responses and bytes by Content-Type
+    long long mime_responses[NUM_MIME_TYPES];
+    long long mime_bytes[NUM_MIME_TYPES];
+    collect_mime(mime_responses, mime_bytes);
+    buf_printf(&out,
+        "\n"
+        "# HELP http_responses_by_type_total 200 responses by Content-Type\n"
+        "# TYPE http_responses_by_type_total counter\n");
+    for (int type = 0; type < NUM_MIME_TYPES; type++) {
+        buf_printf(&out,
+            "http_responses_by_type_total{type=\"%s\"} %lld\n",
+            mime_type_name(type), mime_responses[type]);
+    }
+    buf_printf(&out,
+        "\n"
+        "# HELP http_bytes_by_type_total Bytes sent in 200 responses by Content-Type\n"
+        "# TYPE http_bytes_by_type_total counter\n");
+    for (int type = 0; type < NUM_MIME_TYPES; type++) {
+        buf_printf(&out,
+            "http_bytes_by_type_total{type=\"%s\"} %lld\n",
+            mime_type_name(type), mime_bytes[type]);
+    }
+    
+    // Heaviest paths (estimates; a path drops out when it stops being heavy)
+    for (int tracker = 0; tracker < NUM_TOP_TRACKERS; tracker++) {
+        int count;
+        topk_entry_t* top = collect_top(tracker, &count);
+        buf_printf(&out,
+            "\n"
+            "# HELP %s %s\n"
+            "# TYPE %s gauge\n",
+            top_metric_names[tracker], top_metric_help[tracker], top_metric_names[tracker]);
+        for (int i = 0; i < count && i < TOP_PATHS_EXPORTED; i++) {
+            char path[TOPK_KEY_LEN * 2];
+            escape_path(top[i].key, path, sizeof(path));
+            buf_printf(&out,
+                "%s{path=\"%s\"} %lld\n", top_metric_names[tracker], path, top[i].weight);
+        }
+        free(top);
+    }
+    
+    // Per-worker blocks, then per-thread requests (thread = shard number)
+    worker_values_t* workers = collect_workers();
+    for (int value = 0; workers && value < NUM_WORKER_VALUES; value++) {
+        buf_printf(&out,
+            "\n"
+            "# HELP %s %s\n"
+            "# TYPE %s %s\n",
+            worker_fields[value].metric, worker_fields[value].help,
+            worker_fields[value].metric, worker_fields[value].type);
+        for (int worker = 0; worker < MAX_STATS_WORKERS; worker++) {
+            if (worker_started(worker)) {
+                buf_printf(&out, "%s{worker=\"%d\"} %lld\n",
+                    worker_fields[value].metric, worker, workers[worker][value]);
+            }
+        }
+    }
+    buf_printf(&out,
+        "\n"
+        "# HELP http_worker_queue_wakeup_seconds Connection arrival to pool thread pickup, by how the idle thread waited\n"
+        "# TYPE http_worker_queue_wakeup_seconds histogram\n");
+    for (int worker = 0; workers && worker < MAX_STATS_WORKERS; worker++) {
+        if (!worker_started(worker)) {
+            continue;
+        }
+        static const char* const waits[2] = { "spin", "park" };
+        long long hists[2][WAKEUP_HIST_BUCKETS];
+        collect_wakeups(worker, hists[0], hists[1]);
+        for (int w = 0; w < 2; w++) {
+            long long seen = 0;
+            for (int b = 0; b < WAKEUP_HIST_BUCKETS - 1; b++) {
+                seen += hists[w][b];
+                buf_printf(&out,
+                    "http_worker_queue_wakeup_seconds_bucket{worker=\"%d\",wait=\"%s\",le=\"%g\"} %lld\n",
+                    worker, waits[w], (double)(1LL << b) / 1e6, seen);
+            }
+            seen += hists[w][WAKEUP_HIST_BUCKETS - 1];
+            buf_printf(&out,
+                "http_worker_queue_wakeup_seconds_bucket{worker=\"%d\",wait=\"%s\",le=\"+Inf\"} %lld\n"
+                "http_worker_queue_wakeup_seconds_count{worker=\"%d\",wait=\"%s\"} %lld\n",
+                worker, waits[w], seen, worker, waits[w], seen);
+        }
+    }
+    if (workers) {
+        long long backlog, backlog_limit;
+        collect_listen_backlog(workers, &backlog, &backlog_limit);
+        buf_printf(&out,
+            "\n"
+            "# HELP http_listen_backlog Connections waiting for accept() across all listeners\n"
+            "# TYPE http_listen_backlog gauge\n"
+            "http_listen_backlog %lld\n"
+            "\n"
+            "# HELP http_listen_backlog_limit Accept queue limit across all listeners\n"
+            "# TYPE http_listen_backlog_limit gauge\n"
+            "http_listen_backlog_limit %lld\n",
+            backlog, backlog_limit);
+    }
+    free(workers);
+    buf_printf(&out,
+        "\n"
+        "# HELP http_thread_requests_total Requests served by each request-path thread\n"
+        "# TYPE http_thread_requests_total counter\n");
+    int shards = claimed_shards();
+    for (int i = 0; i < shards; i++) {
+        stats_shard_t* shard = &global_stats->shards[i];
+        int worker = SHARD_READ(shard->worker);
+        if (worker >= 0) {
+            buf_printf(&out,
+                "http_thread_requests_total{worker=\"%d\",thread=\"%d\"} %lld\n",
+                worker, i, SHARD_READ(shard->counters.total_requests));
+        }
+    }
+    return buf_finish(&out, response_len, METRICS_FALLBACK);
+}
+
+// total / divisor as a JSON number, or null when not counted or no divisor
+static const char* json_ratio(char* buf, size_t size, long long total, long long divisor, int counted) {
+    if (!counted || divisor <= 0) {
+        return "null";
+    }
+    snprintf(buf, size, "%.3f", (double)total / divisor);
+    return buf;
+}
+
+// The "perf" object of /stats: per-class costs per request and IPC
+static void format_perf_json(response_buf_t* out) {
+    int enabled = __atomic_load_n(&global_stats->perf_enabled, __ATOMIC_RELAXED);
+    buf_printf(out, ",\n  \"perf\": {\"enabled\": %s", enabled ? "true" : "false");
+    if (!enabled) {
+        buf_printf(out, "}");
+        return;
+    }
+    
+    int counted[NUM_PERF_COUNTERS];
+    buf_printf(out, ", \"threads\": %lld, \"unattributed\": %lld,\n    \"events\": {",
+        STAT_READ(global_stats->perf_threads), STAT_READ(global_stats->perf_unattributed));
+    for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+        int mode = __atomic_load_n(&global_stats->perf_event_mode[counter], __ATOMIC_RELAXED);
+        counted[counter] = mode != PERF_EVENT_UNAVAILABLE;
+        buf_printf(out, "%s\"%s\": \"%s\"", counter ? ", " : "",
+            perf_counter_name(counter),
+            mode == PERF_EVENT_ALL ? "user+kernel" : mode == PERF_EVENT_USER ? "user" : "unavailable");
+    }
+    
+    perf_class_counters_t perf[NUM_PERF_CLASSES];
+    collect_perf(perf);
+    buf_printf(out, "},\n    \"classes\": {");
+    for (int cls = 0; cls < NUM_PERF_CLASSES; cls++) {
+        const perf_class_counters_t* c = &perf[cls];
+        char ipc[32], cycles[32], instructions[32], misses[32], switches[32];
+        buf_printf(out,
+            "%s\n      \"%s\": {\"requests\": %lld, \"ipc\": %s, \"cycles_per_request\": %s, "
+            "\"instructions_per_request\": %s, \"cache_misses_per_request\": %s, "
+            "\"context_switches_per_request\": %s}",
+            cls ? "," : "", perf_class_name(cls), c->requests,
+            json_ratio(ipc, sizeof(ipc), c->counts[PERF_INSTRUCTIONS], c->counts[PERF_CYCLES],
+                       counted[PERF_INSTRUCTIONS] && counted[PERF_CYCLES]),
+            json_ratio(cycles, sizeof(cycles), c->counts[PERF_CYCLES], c->requests,
+                       counted[PERF_CYCLES]),
+            json_ratio(instructions, sizeof(instructions), c->counts[PERF_INSTRUCTIONS], c->requests,
+                       counted[PERF_INSTRUCTIONS]),
+            json_ratio(misses, sizeof(misses), c->counts[PERF_CACHE_MISSES], c->requests,
+                       counted[PERF_CACHE_MISSES]),
+            json_ratio(switches, sizeof(switches), c->counts[PERF_CONTEXT_SWITCHES], c->requests,
+                       counted[PERF_CONTEXT_SWITCHES]));
+    }
+    buf_printf(out, "\n    }\n  }");
 }
 
 // ============================================================================
 // Generate JSON Stats Response
 // ============================================================================
 char* generate_stats_json_response(size_t* response_len) {
-    static char response[2048];
+    static __thread response_buf_t out;
+    buf_reset(&out);
     
     if (!global_stats) {
-        *response_len = snprintf(response, sizeof(response), 
-            "{\"error\":\"Statistics not available\"}");
-        return response;
+        buf_printf(&out, "{\"error\":\"Statistics not available\"}");
+        return buf_finish(&out, response_len, STATS_JSON_FALLBACK);
     }
     
-    sem_wait(&global_stats->semaphore);
+    stats_counters_t totals;
+    collect_totals(&totals);
+    latency_hist_t latency;
+    collect_latency(&latency);
+    long long disk_reads = STAT_READ(global_stats->disk_reads);
     
     long long avg_response_time = 0;
-    if (global_stats->response_count > 0) {
-        avg_response_time = global_stats->total_response_time_ms / global_stats->response_count;
+    if (totals.response_count > 0) {
+        avg_response_time = totals.total_response_time_us / totals.response_count / 1000;
     }
     
-    *response_len = snprintf(response, sizeof(response),
+    buf_printf(&out,
         "{\n"
-        "  \"total_requests\": %d,\n"
-        "  \"bytes_sent\": %d,\n"
+        "  \"total_requests\": %lld,\n"
+        "  \"bytes_sent\": %lld,\n"
         "  \"http_status_codes\": {\n"
-        "    \"200\": %d,\n"
-        "    \"404\": %d,\n"
-        "    \"5xx\": %d\n"
+        "    \"200\": %lld,\n"
+        "    \"404\": %lld,\n"
+        "    \"5xx\": %lld\n"
         "  },\n"
-        "  \"active_connections\": %d,\n"
+        "  \"active_connections\": %lld,\n"
         "  \"average_response_time_ms\": %lld,\n"
         "  \"total_response_time_ms\": %lld,\n"
-        "  \"response_count\": %d\n"
-        "}",
-        global_stats->total_requests,
-        global_stats->bytes_sent,
-        global_stats->http_200_count,
-        global_stats->http_404_count,
-        global_stats->http_500_count,
-        global_stats->active_connections,
+        "  \"response_count\": %lld,\n"
+        "  \"latency_us\": {\n"
+        "    \"p50\": %lld,\n"
+        "    \"p90\": %lld,\n"
+        "    \"p99\": %lld,\n"
+        "    \"p999\": %lld,\n"
+        "    \"max\": %lld\n"
+        "  },\n"
+        "  \"arena_high_water_bytes\": %lld,\n"
+        "  \"disk_io\": {\n"
+        "    \"queue_depth\": %lld,\n"
+        "    \"queue_depth_max\": %lld,\n"
+        "    \"reads\": %lld,\n"
+        "    \"avg_read_us\": %lld,\n"
+        "    \"max_read_us\": %lld,\n"
+        "    \"avg_wait_us\": %lld\n"
+        "  }",
+        totals.total_requests,
+        totals.bytes_sent,
+        totals.http_200_count,
+        totals.http_404_count,
+        totals.http_500_count,
+        totals.active_connections,
         avg_response_time,
-        global_stats->total_response_time_ms,
-        global_stats->response_count);
+        totals.total_response_time_us / 1000,
+        totals.response_count,
+        hist_percentile(&latency, 0.50),
+        hist_percentile(&latency, 0.90),
+        hist_percentile(&latency, 0.99),
+        hist_percentile(&latency, 0.999),
+        latency.max_us,
+        STAT_READ(global_stats->arena_high_water_bytes),
+        STAT_READ(global_stats->disk_queue_depth),
+        STAT_READ(global_stats->disk_queue_depth_max),
+        disk_reads,
+        disk_reads ? STAT_READ(global_stats->disk_read_time_us) / disk_reads : 0,
+        STAT_READ(global_stats->disk_read_max_us),
+        disk_reads ? STAT_READ(global_stats->disk_wait_time_us) / disk_reads : 0);
     
-    sem_post(&global_stats->semaphore);
-    return response;
+    buf_printf(&out,
+        ",\n  \"log\": {\"lines\": %lld, \"bytes\": %lld, \"dropped\": %lld}",
+        STAT_READ(global_stats->log_lines),
+        STAT_READ(global_stats->log_bytes),
+        STAT_READ(global_stats->log_dropped));
+    
+    buf_printf(&out, ",\n  \"rates\": {");
+    for (int w = 0; w < NUM_RATE_WINDOWS; w++) {
+        rate_window_t rate;
+        compute_rate_window(rate_windows[w].seconds, &rate);
+        buf_printf(&out,
+            "%s\n    \"%s\": {\"requests_per_sec\": %.3f, \"bytes_per_sec\": %.1f, "
+            "\"errors_per_sec\": %.3f, \"avg_response_time_us\": %lld, \"span_ms\": %lld}",
+            w ? "," : "", rate_windows[w].label, rate.requests_per_sec, rate.bytes_per_sec,
+            rate.errors_per_sec, rate.avg_response_time_us, rate.span_ms);
+    }
+    buf_printf(&out, "\n  }");
+    
+#ifdef PHASE_TIMING
+    buf_printf(&out, ",\n  \"phases_us\": {");
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        latency_hist_t hist;
+        collect_phase(phase, &hist);
+        buf_printf(&out,
+            "%s\n    \"%s\": {\"p50\": %lld, \"p99\": %lld, \"avg\": %lld, \"count\": %lld}",
+            phase ? "," : "", phase_name(phase), hist_percentile(&hist, 0.50),
+            hist_percentile(&hist, 0.99), hist.total ? hist.sum_us / hist.total : 0, hist.total);
+    }
+    buf_printf(&out, "\n  }");
+#endif
+    
+#ifdef LOCK_STATS
+    lock_counters_t locks[NUM_LOCK_SITES];
+    collect_locks(locks);
+    buf_printf(&out, ",\n  \"locks\": {");
+    for (int site = 0; site < NUM_LOCK_SITES; site++) {
+        buf_printf(&out,
+            "%s\n    \"%s\": {\"acquisitions\": %lld, \"contended\": %lld, \"wait_us\": %lld}",
+            site ? "," : "", lock_site_name(site), locks[site].acquisitions,
+            locks[site].contended, locks[site].wait_ns / 1000);
+    }
+    buf_printf(&out, "\n  }");
+#endif
+    
+    format_perf_json(&out);
+    
+    worker_values_t* workers = collect_workers();
+    if (workers) {
+        buf_printf(&out, ",\n  \"workers\": [");
+        int listed = 0;
+        for (int worker = 0; worker < MAX_STATS_WORKERS; worker++) {
+            if (!worker_started(worker)) {
+                continue;
+            }
+            buf_printf(&out,
+                "%s\n    {\"worker\": %d, \"pid\": %d", listed++ ? "," : "", worker,
+                __atomic_load_n(&global_stats->workers[worker].pid, __ATOMIC_RELAXED));
+            for (int value = 0; value < NUM_WORKER_VALUES; value++) {
+                buf_printf(&out, ", \"%s\": %lld",
+                    worker_fields[value].json, workers[worker][value]);
+            }
+            long long spin[WAKEUP_HIST_BUCKETS], park[WAKEUP_HIST_BUCKETS];
+            collect_wakeups(worker, spin, park);
+            buf_printf(&out, ", \"wakeups\": {\"spin\": [");
+            for (int b = 0; b < WAKEUP_HIST_BUCKETS; b++) {
+                buf_printf(&out, "%s%lld", b ? ", " : "", spin[b]);
+            }
+            buf_printf(&out, "], \"park\": [");
+            for (int b = 0; b < WAKEUP_HIST_BUCKETS; b++) {
+                buf_printf(&out, "%s%lld", b ? ", " : "", park[b]);
+            }
+            buf_printf(&out, "]}}");
+        }
+        buf_printf(&out, "%s]", listed ? "\n  " : "");
+        
+        long long backlog, backlog_limit;
+        collect_listen_backlog(workers, &backlog, &backlog_limit);
+        buf_printf(&out,
+            ",\n  \"listen_backlog\": {\"queued\": %lld, \"limit\": %lld}",
+            backlog, backlog_limit);
+    }
+    free(workers);
+    buf_printf(&out, "\n}");
+    
+    return buf_finish(&out, response_len, STATS_JSON_FALLBACK);
+}
+
+// ============================================================================
+// Generate Top Paths JSON Response
+// ============================================================================
+char* generate_top_json_response(size_t* response_len) {
+    static __thread response_buf_t out;
+    buf_reset(&out);
+    
+    if (!global_stats) {
+        buf_printf(&out, "{\"error\":\"Statistics not available\"}");
+        return buf_finish(&out, response_len, STATS_JSON_FALLBACK);
+    }
+    
+    buf_printf(&out, "{");
+    for (int tracker = 0; tracker < NUM_TOP_TRACKERS; tracker++) {
+        int count;
+        topk_entry_t* top = collect_top(tracker, &count);
+        buf_printf(&out, "%s\n  \"%s\": [", tracker ? "," : "", top_json_names[tracker]);
+        for (int i = 0; i < count && i < TOP_PATHS_REPORTED; i++) {
+            char path[TOPK_KEY_LEN * 2];
+            escape_path(top[i].key, path, sizeof(path));
+            buf_printf(&out,
+                "%s\n    {\"path\": \"%s\", \"estimate\": %lld, \"max_error\": %lld, "
+                "\"requests\": %lld, \"bytes\": %lld}",
+                i ? "," : "", path, top[i].weight, top[i].error, top[i].count, top[i].bytes);
+        }
+        buf_printf(&out, "%s]", count ? "\n  " : "");
+        free(top);
+    }
+    
+    long long mime_responses[NUM_MIME_TYPES];
+    long long mime_bytes[NUM_MIME_TYPES];
+    collect_mime(mime_responses, mime_bytes);
+    buf_printf(&out, ",\n  \"by_type\": {");
+    for (int type = 0; type < NUM_MIME_TYPES; type++) {
+        buf_printf(&out,
+            "%s\n    \"%s\": {\"responses\": %lld, \"bytes\": %lld}",
+            type ? "," : "", mime_type_name(type), mime_responses[type], mime_bytes[type]);
+    }
+    buf_printf(&out, "\n  }\n}");
+    
+    return buf_finish(&out, response_len, STATS_JSON_FALLBACK);
+}
+
+// ============================================================================
+// Generate Slow Requests JSON Response
+// ============================================================================
+char* generate_slow_json_response(size_t* response_len) {
+    static __thread response_buf_t out;
+    buf_reset(&out);
+    
+    if (!global_stats) {
+        buf_printf(&out, "{\"error\":\"Statistics not available\"}");
+        return buf_finish(&out, response_len, STATS_JSON_FALLBACK);
+    }
+    
+    buf_printf(&out,
+        "{\n"
+        "  \"threshold_ms\": %lld,\n"
+        "  \"recorded\": %lld,\n"
+        "  \"dropped\": %lld,\n"
+        "  \"requests\": [",
+        STAT_READ(global_stats->slow_threshold_us) / 1000,
+        STAT_READ(global_stats->slow_next),
+        STAT_READ(global_stats->slow_dropped));
+    
+    // Heap copy: this can run on a small coroutine stack
+    slow_entry_t* entries = malloc(sizeof(slow_entry_t) * SLOW_LOG_SLOTS);
+    int count = entries ? stats_read_slow(entries, SLOW_LOG_SLOTS) : 0;
+    for (int i = 0; i < count; i++) {
+        slow_entry_t* entry = &entries[i];
+        char path[SLOW_PATH_LEN * 2];
+        escape_path(entry->path, path, sizeof(path));
+        buf_printf(&out,
+            "%s\n    {\"time_ms\": %lld, \"path\": \"%s\", \"status\": %d, \"worker\": %d, "
+            "\"thread\": %d, \"total_us\": %lld, \"queue_wait_us\": %lld, \"bytes\": %lld, "
+            "\"cache\": \"%s\", \"phases_us\": {",
+            i ? "," : "", entry->time_ms, path, entry->status, entry->worker, entry->thread,
+            entry->total_us, entry->queue_wait_us, entry->bytes, trace_cache_name(entry->cache));
+        for (int phase = 0; phase < NUM_PHASES; phase++) {
+            buf_printf(&out, "%s\"%s\": %lld",
+                phase ? ", " : "", phase_name(phase), entry->phase_us[phase]);
+        }
+        buf_printf(&out, "}}");
+    }
+    free(entries);
+    buf_printf(&out, "%s]\n}", count ? "\n  " : "");
+    
+    return buf_finish(&out, response_len, STATS_JSON_FALLBACK);
 }
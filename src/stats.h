@@ -1,50 +1,313 @@
 #ifndef STATS_H
 #define STATS_H
 
-#include <semaphore.h>
+#include <stddef.h>
+#include "histogram.h"
+#include "phase_timing.h"
+#include "lock_stats.h"
+#include "perf_counters.h"
+#include "mime.h"
+#include "topk.h"
+
+#define MAX_STATS_SHARDS 256        // One per request-path thread, across all workers
+#define MAX_STATS_WORKERS 256       // Worker ids (prefork) or cores (per-core) with a stats block
+#define WORKER_STATS_INTERVAL_MS 1000   // How often workers publish their gauges
+#define WAKEUP_HIST_BUCKETS 16      // log2 microsecond buckets: <1us, <2us, ... >=16ms
+#define RATE_WINDOW_SECONDS 300     // Longest rate window (5m)
+#define RATE_SLOTS (RATE_WINDOW_SECONDS + 2)    // + the newest sample + the one being written
+#define TOP_PATHS_EXPORTED 10       // Paths per tracker in /metrics
+#define TOP_PATHS_REPORTED 20       // Paths per tracker in /stats/top
+#define SLOW_LOG_SLOTS 128          // Slow/failed requests kept by the flight recorder
+#define SLOW_PATH_LEN 96            // Longer paths are truncated
+
+// Named segment layout identification (see stats_header_t)
+#define STATS_MAGIC 0x53505448      // "HTPS"
+#define STATS_LAYOUT_VERSION 9      // Bump on any change to the structures below
+
+// Heavy-hitter trackers kept for request paths
+typedef enum {
+    TOP_REQUESTS,       // Every file request, weighted 1
+    TOP_BYTES,          // 200 responses, weighted by bytes
+    TOP_NOT_FOUND,      // 404 responses, weighted 1
+    NUM_TOP_TRACKERS
+} top_tracker_t;
 
 // ============================================================================
 // Statistics Structure
 // ============================================================================
+
+// Request-path counters: one set per shard plus a shared set for threads
+// without one. Only long longs, so readers can copy them as an array.
 typedef struct {
-    int total_requests;
-    int bytes_sent;
+    long long total_requests;
+    long long bytes_sent;
     
     // HTTP code counts
-    int http_200_count;
-    int http_404_count;
-    int http_500_count;
+    long long http_200_count;
+    long long http_404_count;
+    long long http_500_count;
     
     // Active connections
-    int active_connections;
+    long long active_connections;
     
     // Response time tracking
-    long long total_response_time_ms;  // soma total em milissegundos
-    int response_count;                 // contador para calcular média
+    long long total_response_time_us;  // soma total em microssegundos
+    long long response_count;           // contador para calcular média
     
-    // Last metrics snapshot (for /metrics endpoint)
-    long long last_total_response_time_ms;
-    int last_response_count;
+    long long rejected;             // Connections answered 503 at admission
+    long long cache_hits;
+    long long cache_misses;
+} stats_counters_t;
+
+#define NUM_STATS_COUNTERS (sizeof(stats_counters_t) / sizeof(long long))
+
+// Requests of one class and what they cost in total (perf_counters.h)
+typedef struct {
+    long long requests;
+    long long counts[NUM_PERF_COUNTERS];
+} perf_class_counters_t;
+
+// Counters owned by a single thread: written without atomic RMWs, folded
+// into the totals by readers. Updates touching several counters run under
+// seq (seqlock.h) so readers never see half of one. Cache-line aligned so
+// shards never share a line.
+typedef struct {
+    unsigned int seq;
+    int worker;                     // Owning worker (-1: none), for per-worker labels
+    stats_counters_t counters;
+    latency_hist_t latency;
+#ifdef PHASE_TIMING
+    latency_hist_t phases[NUM_PHASES];
+#endif
+#ifdef LOCK_STATS
+    lock_counters_t locks[NUM_LOCK_SITES];
+#endif
+    perf_class_counters_t perf[NUM_PERF_CLASSES];
+    long long mime_responses[NUM_MIME_TYPES];   // 200 responses by Content-Type
+    long long mime_bytes[NUM_MIME_TYPES];
+    topk_t top[NUM_TOP_TRACKERS];
+} __attribute__((aligned(64))) stats_shard_t;
+
+// Cumulative totals sampled by the master once a second; a rate over any
+// window up to RATE_WINDOW_SECONDS is the difference of two samples
+typedef struct {
+    unsigned int seq;               // Written under seqlock by the master
+    long long index;                // Sample number, to detect a reused slot
+    long long time_ms;              // CLOCK_MONOTONIC when taken
+    long long requests;
+    long long bytes_sent;
+    long long errors;               // 404 + 5xx
+    long long response_count;
+    long long response_time_us;
+} rate_sample_t;
+
+// Gauges a worker samples from its own structures and publishes every
+// WORKER_STATS_INTERVAL_MS (under seq); its counters are summed from its
+// threads' shards
+typedef struct {
+    unsigned int seq;
+    int pid;                        // 0 = no worker with this id has started
+    long long queue_depth;          // Connections waiting for a pool thread
+    long long queue_peak;           // Highest queue depth since the previous publication
+    long long busy_threads;         // Pool threads (per-core: coroutines) on a request
+    long long threads;
+    long long cache_entries;
+    long long cache_bytes;
+    long long listen_backlog;       // Connections waiting for accept() on the worker's listener
+    long long listen_backlog_limit;
+    long long listener_id;          // Listener inode: prefork workers share one
+    long long wake_spin[WAKEUP_HIST_BUCKETS];   // Pool consumer wakeups after spinning (prefork)
+    long long wake_park[WAKEUP_HIST_BUCKETS];   // ... and after parking on the semaphore
+} __attribute__((aligned(64))) worker_stats_t;
+
+// Cache outcome of a request, for the flight recorder
+#define TRACE_CACHE_NONE 0          // Not a file request (or no cache)
+#define TRACE_CACHE_HIT 1
+#define TRACE_CACHE_MISS 2
+
+// What the request path collects about the request it is serving; handed
+// to record_request_trace() with its phase times once the response is sent
+typedef struct {
+    char path[SLOW_PATH_LEN];       // Without the query string
+    int status;
+    int cache;                      // TRACE_CACHE_*
+    long long bytes;
+    long long total_us;
+    long long queue_wait_us;        // Time in the connection queue (prefork)
+} request_trace_t;
+
+// One slow or failed request in the flight recorder ring. Any thread may
+// write a slot, so writers claim it with seqlock_try_write_begin() and
+// skip it (counted in slow_dropped) if another writer holds it.
+typedef struct {
+    unsigned int seq;
+    int worker;
+    int thread;                     // Shard number of the serving thread (-1: none)
+    int status;
+    int cache;
+    long long ticket;               // Record number, to detect a reused slot
+    long long time_ms;              // CLOCK_REALTIME when the response finished
+    long long bytes;
+    long long total_us;
+    long long queue_wait_us;
+    long long phase_us[NUM_PHASES]; // 0 without PHASE_TIMING
+    char path[SLOW_PATH_LEN];
+} slow_entry_t;
+
+// Start of the block, so external readers (httptop) mapping a named
+// segment can tell it was written by a compatible build. magic is stored
+// last, once the rest of the block is initialized.
+typedef struct {
+    unsigned int magic;             // STATS_MAGIC
+    unsigned int version;           // STATS_LAYOUT_VERSION
+    long long size;                 // sizeof(server_stats_t): also differs with PHASE_TIMING/LOCK_STATS
+    int master_pid;
+    long long start_time;           // CLOCK_REALTIME seconds at startup
+} stats_header_t;
+
+// All counters are 64-bit and updated with __atomic builtins; no reader
+// keeps state here or takes a lock, so any number of scrapers can read
+// concurrently without slowing the request path.
+typedef struct {
+    stats_header_t header;
+    stats_counters_t counters;          // Threads without a shard (atomic RMWs)
+    latency_hist_t latency;             // Threads without a shard
+#ifdef PHASE_TIMING
+    latency_hist_t phases[NUM_PHASES];
+#endif
+#ifdef LOCK_STATS
+    lock_counters_t locks[NUM_LOCK_SITES];
+#endif
+    
+    // Per-type and per-path stats for threads without a shard
+    long long mime_responses[NUM_MIME_TYPES];
+    long long mime_bytes[NUM_MIME_TYPES];
+    topk_t top[NUM_TOP_TRACKERS];
+    
+    // Request arena high-water mark (largest single request, any thread)
+    long long arena_high_water_bytes;
+    
+    // Async disk I/O (cache-miss loads)
+    long long disk_queue_depth;       // Loads waiting for a disk thread
+    long long disk_queue_depth_max;
+    long long disk_reads;
+    long long disk_read_bytes;
+    long long disk_read_time_us;      // open/stat/read time
+    long long disk_wait_time_us;      // submit -> loaded (includes queueing)
+    long long disk_read_max_us;
+    
+    // Graceful drain (set by the master on SIGTERM, fails /health)
+    int draining;
+    long long drained_requests;      // Requests served after drain started
+    long long dropped_connections;   // Connections abandoned at the drain deadline
+    
+    // Logger (each process's log writer thread, once per batch)
+    long long log_lines;
+    long long log_bytes;
+    long long log_dropped;           // Lines lost to a full log buffer (LOG_OVERFLOW=drop)
     
-    sem_t semaphore;
+    // Per-second ring of totals (written by the master only)
+    rate_sample_t rate_samples[RATE_SLOTS];
+    long long rate_sample_count;     // Samples taken; the newest is count - 1
+    
+    // Hardware counters per request class (PERF_COUNTERS)
+    int perf_enabled;
+    int perf_event_mode[NUM_PERF_COUNTERS];  // PERF_EVENT_*, as request threads opened them
+    long long perf_threads;                  // Threads counting
+    long long perf_unattributed;             // Measured requests that shared their thread
+    perf_class_counters_t perf[NUM_PERF_CLASSES];   // Threads without a shard
+    
+    // Flight recorder: requests over slow_threshold_us or answered 5xx
+    long long slow_threshold_us;
+    long long slow_next;             // Next record number (atomic)
+    long long slow_dropped;          // Records lost to a slot held by another writer
+    slow_entry_t slow_log[SLOW_LOG_SLOTS];
+    
+    int shards_claimed;              // Next free shard (atomic)
+    stats_shard_t shards[MAX_STATS_SHARDS];
+    worker_stats_t workers[MAX_STATS_WORKERS];
 } server_stats_t;
 
+// Rates between two samples of the per-second ring
+typedef struct {
+    long long span_ms;              // Time actually covered (0 = no data yet)
+    double requests_per_sec;
+    double bytes_per_sec;
+    double errors_per_sec;
+    long long avg_response_time_us;
+} rate_window_t;
+
+// One worker as seen by readers: counters summed over its shards, gauges
+// from its last publication
+typedef struct {
+    int worker;
+    int pid;
+    long long requests;
+    long long active_connections;
+    long long queue_depth;
+    long long queue_peak;
+    long long rejected;
+    long long cache_hits;
+    long long cache_misses;
+    long long cache_entries;
+    long long cache_bytes;
+    long long busy_threads;
+    long long idle_threads;
+    long long threads;
+    long long listen_backlog;
+    long long listen_backlog_limit;
+} worker_view_t;
+
 // ============================================================================
 // Statistics Functions
 // ============================================================================
-int init_stats(void);
+int init_stats(const char* shm_name);
 void cleanup_stats(void);
-void update_stats(int bytes);
-void update_stats_with_code(int bytes, int http_code);
+void update_stats(long long bytes);
+void update_stats_with_code(long long bytes, int http_code);
 void increment_active_connections(void);
 void decrement_active_connections(void);
-void add_response_time(long long time_ms);
+void add_response_time(long long time_us);
+void record_rejected(void);
+void record_cache_lookup(int hit);
+void record_path_stats(const char* path, mime_type_t type, long long bytes, int http_code);
+void set_slow_request_threshold(long long threshold_us);
+void record_request_trace(const request_trace_t* trace, const long long* phase_us);
+const char* trace_cache_name(int cache);
+void set_perf_counters_enabled(int enabled);
+void record_perf_thread(const int* event_modes);
+void record_perf_request(int perf_class, const long long* counts);
+void record_perf_unattributed(void);
+void update_arena_high_water(long long bytes);
+void update_disk_queue_depth(int delta);
+void record_disk_read(long long read_us, long long wait_us, long long bytes);
+void stats_set_worker(int worker_id);
+void stats_bind_thread(void);
+void publish_worker_stats(const worker_stats_t* gauges);
+void set_draining(void);
+int is_draining(void);
+void record_drain(long long drained, long long dropped);
+void record_log_written(long long lines, long long bytes);
+void record_log_dropped(long long lines);
 void print_global_stats(void);
+void record_rate_sample(void);
 server_stats_t* get_stats(void);
 
+// Read-only access to a named segment from another process (httptop):
+// the stats_read_* functions work on whichever block is current
+int stats_attach(const char* shm_name);
+void stats_detach(void);
+void stats_read_totals(stats_counters_t* totals);
+void stats_read_latency(latency_hist_t* hist);
+void stats_read_rate(int seconds, rate_window_t* out);
+int stats_read_workers(worker_view_t* out, int max);
+int stats_read_slow(slow_entry_t* out, int max);
+
 // Monitoring endpoints
 char* generate_health_response(size_t* response_len);
 char* generate_metrics_response(size_t* response_len);
 char* generate_stats_json_response(size_t* response_len);
+char* generate_top_json_response(size_t* response_len);
+char* generate_slow_json_response(size_t* response_len);
 
 #endif // STATS_H
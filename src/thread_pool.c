@@ -9,6 +9,8 @@
 void thread_pool_init(thread_pool_t* pool, connection_queue_t* queue) {
     pool->queue = queue;
     pool->active_threads = 0;
+    pool->busy_threads = 0;
+    pool->completed = 0;
     pthread_mutex_init(&pool->active_mutex, NULL);
 }
 
@@ -34,3 +36,30 @@ void thread_pool_decrement_active(thread_pool_t* pool) {
     pool->active_threads--;
     pthread_mutex_unlock(&pool->active_mutex);
 }
+
+void thread_pool_mark_busy(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->active_mutex);
+    pool->busy_threads++;
+    pthread_mutex_unlock(&pool->active_mutex);
+}
+
+void thread_pool_mark_idle(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->active_mutex);
+    pool->busy_threads--;
+    pool->completed++;
+    pthread_mutex_unlock(&pool->active_mutex);
+}
+
+int thread_pool_get_busy_threads(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->active_mutex);
+    int count = pool->busy_threads;
+    pthread_mutex_unlock(&pool->active_mutex);
+    return count;
+}
+
+unsigned long thread_pool_get_completed(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->active_mutex);
+    unsigned long count = pool->completed;
+    pthread_mutex_unlock(&pool->active_mutex);
+    return count;
+}
@@ -10,7 +10,9 @@
 typedef struct {
     connection_queue_t* queue;  // Connection queue with semaphores
     int active_threads;
-    pthread_mutex_t active_mutex;  // Mutex for active_threads counter
+    int busy_threads;           // Threads currently handling a connection
+    unsigned long completed;    // Connections handled so far
+    pthread_mutex_t active_mutex;  // Mutex for the counters above
 } thread_pool_t;
 
 // ============================================================================
@@ -21,5 +23,9 @@ void thread_pool_destroy(thread_pool_t* pool);
 int thread_pool_get_active_threads(thread_pool_t* pool);
 void thread_pool_increment_active(thread_pool_t* pool);
 void thread_pool_decrement_active(thread_pool_t* pool);
+void thread_pool_mark_busy(thread_pool_t* pool);
+void thread_pool_mark_idle(thread_pool_t* pool);
+int thread_pool_get_busy_threads(thread_pool_t* pool);
+unsigned long thread_pool_get_completed(thread_pool_t* pool);
 
 #endif // THREAD_POOL_H
@@ -0,0 +1,165 @@
+// Hierarchical timer wheel for connection deadlines
+
+#include "timer_wheel.h"
+#include <string.h>
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+static void slot_insert(timer_node_t** slot, timer_node_t* node) {
+    node->slot = slot;
+    node->prev = NULL;
+    node->next = *slot;
+    if (*slot) {
+        (*slot)->prev = node;
+    }
+    *slot = node;
+}
+
+static timer_node_t** slot_for(timer_wheel_t* tw, unsigned long long expires) {
+    unsigned long long delta = expires - tw->now_tick;
+    if (delta < TW_L0_SLOTS) {
+        return &tw->level0[expires & (TW_L0_SLOTS - 1)];
+    }
+    return &tw->level1[(expires >> TW_L0_BITS) & (TW_L1_SLOTS - 1)];
+}
+
+static void place(timer_wheel_t* tw, timer_node_t* node) {
+    // Clamp so a level 1 timer never aliases the slot currently in use
+    unsigned long long max_delta = (unsigned long long)TW_L0_SLOTS * (TW_L1_SLOTS - 1);
+    if (node->expires < tw->now_tick) {
+        node->expires = tw->now_tick + 1;
+    } else if (node->expires - tw->now_tick > max_delta) {
+        node->expires = tw->now_tick + max_delta;
+    }
+    slot_insert(slot_for(tw, node->expires), node);
+}
+
+static void unlink_node(timer_wheel_t* tw, timer_node_t* node) {
+    (void)tw;
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else if (node->slot && *node->slot == node) {
+        *node->slot = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    }
+    node->prev = NULL;
+    node->next = NULL;
+    node->slot = NULL;
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+
+void timer_wheel_init(timer_wheel_t* tw, int tick_ms, long long now_ms) {
+    memset(tw->level0, 0, sizeof(tw->level0));
+    memset(tw->level1, 0, sizeof(tw->level1));
+    tw->now_tick = 0;
+    tw->start_ms = now_ms;
+    tw->tick_ms = tick_ms > 0 ? tick_ms : 1;
+    tw->count = 0;
+}
+
+void timer_wheel_add(timer_wheel_t* tw, timer_node_t* node, long long timeout_ms) {
+    if (node->armed) {
+        timer_wheel_cancel(tw, node);
+    }
+
+    // Round up, plus one tick for the part of the current tick already
+    // elapsed, so a timer never fires early
+    unsigned long long ticks = (timeout_ms + tw->tick_ms - 1) / tw->tick_ms;
+    node->expires = tw->now_tick + ticks + 1;
+    node->armed = 1;
+    place(tw, node);
+    tw->count++;
+}
+
+void timer_wheel_cancel(timer_wheel_t* tw, timer_node_t* node) {
+    if (!node->armed) {
+        return;
+    }
+    unlink_node(tw, node);
+    node->armed = 0;
+    tw->count--;
+}
+
+int timer_wheel_advance(timer_wheel_t* tw, long long now_ms, timer_expire_fn expire, void* ctx) {
+    unsigned long long target = (unsigned long long)((now_ms - tw->start_ms) / tw->tick_ms);
+
+    // Nothing armed: just catch up, so timers added next start from now
+    if (tw->count == 0) {
+        if (target > tw->now_tick) {
+            tw->now_tick = target;
+        }
+        return 0;
+    }
+
+    int expired = 0;
+
+    while (tw->now_tick < target) {
+        tw->now_tick++;
+        unsigned int idx = tw->now_tick & (TW_L0_SLOTS - 1);
+
+        // New level 0 revolution: pull the matching level 1 slot down
+        if (idx == 0) {
+            timer_node_t** l1 = &tw->level1[(tw->now_tick >> TW_L0_BITS) & (TW_L1_SLOTS - 1)];
+            timer_node_t* node = *l1;
+            *l1 = NULL;
+            while (node) {
+                timer_node_t* next = node->next;
+                place(tw, node);
+                node = next;
+            }
+        }
+
+        // Fire everything in this tick's slot
+        timer_node_t* node = tw->level0[idx];
+        tw->level0[idx] = NULL;
+        while (node) {
+            timer_node_t* next = node->next;
+            node->prev = NULL;
+            node->next = NULL;
+            node->armed = 0;
+            tw->count--;
+            expired++;
+            expire(node, ctx);   // may free the node or re-arm it
+            node = next;
+        }
+    }
+
+    return expired;
+}
+
+void timer_wheel_expire_all(timer_wheel_t* tw, timer_expire_fn expire, void* ctx) {
+    timer_node_t** levels[2] = { tw->level0, tw->level1 };
+    int sizes[2] = { TW_L0_SLOTS, TW_L1_SLOTS };
+
+    for (int l = 0; l < 2; l++) {
+        for (int i = 0; i < sizes[l]; i++) {
+            timer_node_t* node = levels[l][i];
+            levels[l][i] = NULL;
+            while (node) {
+                timer_node_t* next = node->next;
+                node->prev = NULL;
+                node->next = NULL;
+                node->armed = 0;
+                tw->count--;
+                expire(node, ctx);
+                node = next;
+            }
+        }
+    }
+}
+
+int timer_wheel_next_timeout_ms(const timer_wheel_t* tw, long long now_ms) {
+    if (tw->count == 0) {
+        return -1;
+    }
+    long long next_tick_ms = tw->start_ms + (long long)(tw->now_tick + 1) * tw->tick_ms;
+    long long wait = next_tick_ms - now_ms;
+    return wait > 0 ? (int)wait : 0;
+}
@@ -0,0 +1,72 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+// ============================================================================
+// Hierarchical Timer Wheel
+// ============================================================================
+// Two levels: level 0 has TW_L0_SLOTS slots of one tick each, level 1 has
+// TW_L1_SLOTS slots of TW_L0_SLOTS ticks each. Timers further out than
+// level 1 can hold are clamped. Insert, cancel and per-tick expiry are O(1);
+// level 1 slots cascade into level 0 once per level-0 revolution.
+// Not thread-safe: owned by a single event loop thread.
+
+#define TW_L0_BITS 8
+#define TW_L0_SLOTS (1 << TW_L0_BITS)   // 256 ticks
+#define TW_L1_SLOTS 64                  // 64 x 256 ticks
+
+typedef struct timer_node {
+    struct timer_node* prev;
+    struct timer_node* next;
+    struct timer_node** slot;           // List head this node is linked into
+    unsigned long long expires;         // Absolute tick
+    int armed;
+} timer_node_t;
+
+typedef struct {
+    timer_node_t* level0[TW_L0_SLOTS];
+    timer_node_t* level1[TW_L1_SLOTS];
+    unsigned long long now_tick;
+    long long start_ms;                 // Monotonic time of tick 0
+    int tick_ms;
+    int count;                          // Armed timers
+} timer_wheel_t;
+
+typedef void (*timer_expire_fn)(timer_node_t* node, void* ctx);
+
+// ============================================================================
+// Timer Wheel Functions
+// ============================================================================
+
+/**
+ * Initialize an empty wheel starting at now_ms
+ */
+void timer_wheel_init(timer_wheel_t* tw, int tick_ms, long long now_ms);
+
+/**
+ * Arm node to expire timeout_ms from the wheel's current time
+ * (re-arms if already armed)
+ */
+void timer_wheel_add(timer_wheel_t* tw, timer_node_t* node, long long timeout_ms);
+
+/**
+ * Cancel an armed timer (no-op if not armed)
+ */
+void timer_wheel_cancel(timer_wheel_t* tw, timer_node_t* node);
+
+/**
+ * Advance to now_ms and call expire() for every timer that is due
+ * Returns: number of timers expired
+ */
+int timer_wheel_advance(timer_wheel_t* tw, long long now_ms, timer_expire_fn expire, void* ctx);
+
+/**
+ * Expire every armed timer immediately (used on shutdown)
+ */
+void timer_wheel_expire_all(timer_wheel_t* tw, timer_expire_fn expire, void* ctx);
+
+/**
+ * Milliseconds until the next tick boundary, or -1 if no timers are armed
+ */
+int timer_wheel_next_timeout_ms(const timer_wheel_t* tw, long long now_ms);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,117 @@
+// Space-Saving heavy-hitter tracking
+
+#include "topk.h"
+#include "seqlock.h"
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// Internal Helpers
+// ============================================================================
+
+/**
+ * Apply one sample; the caller is inside the tracker's write section
+ */
+static void topk_update(topk_t* top, const char* key, long long weight, long long bytes) {
+    topk_entry_t* min = NULL;
+    for (int i = 0; i < top->used; i++) {
+        topk_entry_t* entry = &top->entries[i];
+        if (strncmp(entry->key, key, TOPK_KEY_LEN - 1) == 0) {
+            entry->weight += weight;
+            entry->count++;
+            entry->bytes += bytes;
+            return;
+        }
+        if (!min || entry->weight < min->weight) {
+            min = entry;
+        }
+    }
+
+    topk_entry_t* slot;
+    long long inherited = 0;
+    if (top->used < TOPK_SLOTS) {
+        slot = &top->entries[top->used];
+        __atomic_store_n(&top->used, top->used + 1, __ATOMIC_RELAXED);
+    } else {
+        // Evict the lightest key; the newcomer may have been it all along
+        slot = min;
+        inherited = min->weight;
+    }
+    strncpy(slot->key, key, TOPK_KEY_LEN - 1);
+    slot->key[TOPK_KEY_LEN - 1] = '\0';
+    slot->weight = inherited + weight;
+    slot->error = inherited;
+    slot->count = 1;
+    slot->bytes = bytes;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    return strcmp(((const topk_entry_t*)a)->key, ((const topk_entry_t*)b)->key);
+}
+
+static int compare_weight_desc(const void* a, const void* b) {
+    long long wa = ((const topk_entry_t*)a)->weight;
+    long long wb = ((const topk_entry_t*)b)->weight;
+    return (wa < wb) - (wa > wb);
+}
+
+// ============================================================================
+// Public API Implementation
+// ============================================================================
+void topk_add(topk_t* top, const char* key, long long weight, long long bytes) {
+    seqlock_write_begin(&top->seq);
+    topk_update(top, key, weight, bytes);
+    seqlock_write_end(&top->seq);
+}
+
+int topk_try_add(topk_t* top, const char* key, long long weight, long long bytes) {
+    if (!seqlock_try_write_begin(&top->seq)) {
+        return -1;
+    }
+    topk_update(top, key, weight, bytes);
+    seqlock_write_end(&top->seq);
+    return 0;
+}
+
+int topk_snapshot(const topk_t* top, topk_entry_t* out) {
+    int used = 0;
+    for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+        unsigned int seq = seqlock_read_begin(&top->seq);
+        used = __atomic_load_n(&top->used, __ATOMIC_RELAXED);
+        if (used < 0 || used > TOPK_SLOTS) {
+            used = 0;
+        }
+        memcpy(out, top->entries, sizeof(topk_entry_t) * used);
+        if (!seqlock_read_retry(&top->seq, seq)) {
+            break;
+        }
+    }
+    // A writer that died mid-update leaves a mixed copy: keep keys terminated
+    for (int i = 0; i < used; i++) {
+        out[i].key[TOPK_KEY_LEN - 1] = '\0';
+    }
+    return used;
+}
+
+int topk_combine(topk_entry_t* entries, int count) {
+    if (count == 0) {
+        return 0;
+    }
+
+    qsort(entries, count, sizeof(topk_entry_t), compare_keys);
+    int out = 0;
+    for (int i = 1; i < count; i++) {
+        if (strcmp(entries[out].key, entries[i].key) == 0) {
+            entries[out].weight += entries[i].weight;
+            entries[out].error += entries[i].error;
+            entries[out].count += entries[i].count;
+            entries[out].bytes += entries[i].bytes;
+        } else {
+            entries[++out] = entries[i];
+        }
+    }
+    count = out + 1;
+
+    qsort(entries, count, sizeof(topk_entry_t), compare_weight_desc);
+    return count;
+}
@@ -0,0 +1,62 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+// ============================================================================
+// Heavy Hitters (Space-Saving)
+// ============================================================================
+// Tracks the most frequent keys in TOPK_SLOTS fixed slots, however many
+// distinct keys are seen. A key not being tracked takes over the slot with
+// the smallest weight and inherits that weight as its error bound, so any
+// key heavier than total/TOPK_SLOTS is guaranteed to be present and its
+// weight is overestimated by at most `error`. Fixed size, so it can live in
+// shared memory; a sequence counter (seqlock.h) makes copies consistent for
+// readers without ever holding up the writer.
+
+#define TOPK_SLOTS 32
+#define TOPK_KEY_LEN 80             // Longer keys are truncated
+
+typedef struct {
+    char key[TOPK_KEY_LEN];
+    long long weight;               // Estimated total weight (>= true weight)
+    long long error;                // Maximum overestimation of weight
+    long long count;                // Requests since this key took the slot
+    long long bytes;                // Bytes since this key took the slot
+} topk_entry_t;
+
+typedef struct {
+    unsigned int seq;
+    int used;
+    topk_entry_t entries[TOPK_SLOTS];
+} topk_t;
+
+// ============================================================================
+// Top-K Functions
+// ============================================================================
+
+/**
+ * Add weight for key (one request of `bytes` bytes); top has one writer
+ */
+void topk_add(topk_t* top, const char* key, long long weight, long long bytes);
+
+/**
+ * topk_add() for a tracker any thread may write; skips the sample rather
+ * than wait while another writer is inside
+ * Returns: 0 if added, -1 if skipped
+ */
+int topk_try_add(topk_t* top, const char* key, long long weight, long long bytes);
+
+/**
+ * Copy the tracked entries into out (TOPK_SLOTS capacity), retrying a copy
+ * torn by the writer up to SEQLOCK_READ_ATTEMPTS times
+ * Returns: number of entries copied
+ */
+int topk_snapshot(const topk_t* top, topk_entry_t* out);
+
+/**
+ * Fold entries with the same key together (summing their fields) and sort
+ * by weight, heaviest first
+ * Returns: the new number of entries
+ */
+int topk_combine(topk_entry_t* entries, int count);
+
+#endif // TOPK_H